@@ -35,6 +35,8 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/types.h>
 #include <time.h>
@@ -44,6 +46,242 @@
 
 llist_ts_t alist_p;
 
+/*
+ * Appointments without a duration still occupy the second they start at, so
+ * that they are found when querying the day they belong to.
+ */
+#define APOINT_END(apt) ((apt)->start + ((apt)->dur > 0 ? (apt)->dur : 1))
+
+/* Number of entries summarized by each element of blkend. */
+#define APOINT_STORE_BLOCK 64
+
+/* End time of deleted entries, which never matches a query. */
+#define APOINT_STORE_DELETED LONG_MIN
+
+/*
+ * Columnar copy of the start and end times of the appointments in alist_p,
+ * used to quickly find the appointments overlapping a given period. Entries
+ * are sorted by start time and item address, except for an unsorted tail of
+ * recently added entries that is merged on the next query. Deleted entries
+ * are marked and compacted once they make up half of the store. blkend[b]
+ * holds the largest end time of the b-th block of APOINT_STORE_BLOCK
+ * entries, which allows for skipping whole blocks during queries.
+ * Protected by the alist_p mutex.
+ */
+struct apoint_store {
+	unsigned count;		/* number of entries, including the tail */
+	unsigned sorted;	/* number of entries in sorted order */
+	unsigned deleted;	/* number of deleted entries */
+	unsigned size;
+	long *start;
+	long *end;
+	struct apoint **apt;
+	long *blkend;
+};
+
+static struct apoint_store apoint_index;
+
+static void apoint_store_init(struct apoint_store *st)
+{
+	st->count = st->sorted = st->deleted = 0;
+	st->size = 0;
+	st->start = st->end = st->blkend = NULL;
+	st->apt = NULL;
+}
+
+static void apoint_store_free(struct apoint_store *st)
+{
+	if (st->size > 0) {
+		mem_free(st->start);
+		mem_free(st->end);
+		mem_free(st->apt);
+		mem_free(st->blkend);
+	}
+	apoint_store_init(st);
+}
+
+static void apoint_store_alloc(struct apoint_store *st, unsigned size)
+{
+	st->size = size;
+	st->start = mem_malloc(size * sizeof(long));
+	st->end = mem_malloc(size * sizeof(long));
+	st->apt = mem_malloc(size * sizeof(struct apoint *));
+	st->blkend = mem_malloc((size / APOINT_STORE_BLOCK + 1) *
+				sizeof(long));
+}
+
+static int apoint_store_cmp(long start_a, struct apoint *a, long start_b,
+			    struct apoint *b)
+{
+	if (start_a != start_b)
+		return start_a < start_b ? -1 : 1;
+	if (a != b)
+		return (uintptr_t)a < (uintptr_t)b ? -1 : 1;
+	return 0;
+}
+
+static int apoint_store_tail_cmp(const void *pa, const void *pb)
+{
+	struct apoint *a = *(struct apoint **)pa;
+	struct apoint *b = *(struct apoint **)pb;
+
+	return apoint_store_cmp(a->start, a, b->start, b);
+}
+
+/*
+ * Merge the unsorted tail into the sorted entries, drop deleted entries and
+ * update the block summaries.
+ */
+static void apoint_store_sync(struct apoint_store *st)
+{
+	struct apoint_store out;
+	struct apoint **tail;
+	unsigned ntail, i, j, k;
+
+	if (st->sorted == st->count && st->deleted <= st->count / 2)
+		return;
+
+	ntail = st->count - st->sorted;
+	tail = ntail > 0 ? mem_malloc(ntail * sizeof(struct apoint *)) : NULL;
+	for (i = 0; i < ntail; i++)
+		tail[i] = st->apt[st->sorted + i];
+	if (ntail > 1)
+		qsort(tail, ntail, sizeof(struct apoint *),
+		      apoint_store_tail_cmp);
+
+	apoint_store_init(&out);
+	if (st->count - st->deleted > 0)
+		apoint_store_alloc(&out, st->size);
+	for (i = j = k = 0; i < st->sorted || j < ntail;) {
+		if (i < st->sorted && st->end[i] == APOINT_STORE_DELETED) {
+			i++;
+			continue;
+		}
+		if (j == ntail || (i < st->sorted &&
+		    apoint_store_cmp(st->start[i], st->apt[i], tail[j]->start,
+				     tail[j]) < 0)) {
+			out.start[k] = st->start[i];
+			out.end[k] = st->end[i];
+			out.apt[k] = st->apt[i];
+			i++;
+		} else {
+			out.start[k] = tail[j]->start;
+			out.end[k] = APOINT_END(tail[j]);
+			out.apt[k] = tail[j];
+			j++;
+		}
+		if (k % APOINT_STORE_BLOCK == 0 ||
+		    out.end[k] > out.blkend[k / APOINT_STORE_BLOCK])
+			out.blkend[k / APOINT_STORE_BLOCK] = out.end[k];
+		k++;
+	}
+	out.count = out.sorted = k;
+
+	if (tail)
+		mem_free(tail);
+	apoint_store_free(st);
+	*st = out;
+}
+
+static void apoint_store_add(struct apoint_store *st, struct apoint *apt)
+{
+	if (st->size == 0) {
+		apoint_store_alloc(st, 64);
+	} else if (st->count == st->size) {
+		st->size *= 2;
+		st->start = mem_realloc(st->start, st->size, sizeof(long));
+		st->end = mem_realloc(st->end, st->size, sizeof(long));
+		st->apt = mem_realloc(st->apt, st->size,
+				      sizeof(struct apoint *));
+		st->blkend = mem_realloc(st->blkend,
+					 st->size / APOINT_STORE_BLOCK + 1,
+					 sizeof(long));
+	}
+
+	/* Only the pointer is needed until the tail is merged. */
+	st->apt[st->count++] = apt;
+}
+
+/* Delete the entry of an appointment that was stored with the given start. */
+static void apoint_store_remove(struct apoint_store *st, long start,
+				struct apoint *apt)
+{
+	unsigned lo = 0, hi = st->sorted, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (apoint_store_cmp(st->start[mid], st->apt[mid], start,
+				     apt) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Skip entries of earlier deletions of the same item. */
+	for (; lo < st->sorted && st->apt[lo] == apt &&
+	     st->start[lo] == start; lo++) {
+		if (st->end[lo] != APOINT_STORE_DELETED) {
+			st->end[lo] = APOINT_STORE_DELETED;
+			st->deleted++;
+			return;
+		}
+	}
+
+	for (lo = st->sorted; lo < st->count; lo++) {
+		if (st->apt[lo] == apt)
+			break;
+	}
+	EXIT_IF(lo == st->count, _("no such appointment"));
+	/* Unsorted entries can be dropped right away. */
+	st->apt[lo] = st->apt[--st->count];
+}
+
+/*
+ * Call fn_visit on every stored appointment overlapping [from, to), in
+ * ascending order of start times.
+ */
+static int apoint_store_query(struct apoint_store *st, long from, long to,
+			      apoint_fn_visit_t fn_visit, void *arg)
+{
+	unsigned match[APOINT_STORE_BLOCK];
+	unsigned lo, hi, mid, first, last, n, i;
+	int ret;
+
+	apoint_store_sync(st);
+
+	/* Entries starting at or after the end of the period never match. */
+	lo = 0;
+	hi = st->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (st->start[mid] < to)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (first = 0; first < hi; first += APOINT_STORE_BLOCK) {
+		if (st->blkend[first / APOINT_STORE_BLOCK] <= from)
+			continue;
+		last = first + APOINT_STORE_BLOCK < hi ?
+		       first + APOINT_STORE_BLOCK : hi;
+
+		/* Branch-free filter over the end times of the block. */
+		for (i = first, n = 0; i < last; i++) {
+			match[n] = i;
+			n += st->end[i] > from;
+		}
+
+		for (i = 0; i < n; i++) {
+			ret = fn_visit(st->apt[match[i]], arg);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
 void apoint_free(struct apoint *apt)
 {
 	mem_free(apt->mesg);
@@ -71,6 +309,7 @@ struct apoint *apoint_dup(struct apoint *in)
 void apoint_llist_init(void)
 {
 	LLIST_TS_INIT(&alist_p);
+	apoint_store_init(&apoint_index);
 }
 
 /*
@@ -82,9 +321,10 @@ void apoint_llist_free(void)
 {
 	LLIST_TS_FREE_INNER(&alist_p, apoint_free);
 	LLIST_TS_FREE(&alist_p);
+	apoint_store_free(&apoint_index);
 }
 
-static int apoint_cmp(struct apoint *a, struct apoint *b)
+int apoint_cmp(struct apoint *a, struct apoint *b)
 {
 	if (a->start < b->start)
 		return -1;
@@ -98,25 +338,119 @@ static int apoint_cmp(struct apoint *a, struct apoint *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-struct apoint *apoint_new(char *mesg, char *note, long start, long dur,
-			  char state)
+static struct apoint *apoint_alloc(char *mesg, char *note, long start,
+				   long dur, char state)
 {
 	struct apoint *apt;
 
-	apt = mem_malloc(sizeof(struct apoint));
-	apt->mesg = mem_strdup(mesg);
-	apt->note = (note != NULL) ? mem_strdup(note) : NULL;
+	apt = mem_arena_malloc(sizeof(struct apoint));
+	apt->mesg = mem_arena_strdup(mesg);
+	apt->note = (note != NULL) ? mem_arena_strdup(note) : NULL;
 	apt->state = state;
 	apt->start = start;
 	apt->dur = dur;
 
+	return apt;
+}
+
+struct apoint *apoint_new(char *mesg, char *note, long start, long dur,
+			  char state)
+{
+	struct apoint *apt;
+
+	apt = apoint_alloc(mesg, note, start, dur, state);
+
 	LLIST_TS_LOCK(&alist_p);
 	LLIST_TS_ADD_SORTED(&alist_p, apt, apoint_cmp);
+	apoint_store_add(&apoint_index, apt);
 	LLIST_TS_UNLOCK(&alist_p);
 
 	return apt;
 }
 
+/*
+ * Add the appointments of a list filled in bulk mode, such as the ones
+ * returned by apoint_scan(), to the list of appointments. The list of
+ * appointments must be in bulk mode as well.
+ */
+void apoint_llist_splice(llist_t *batch)
+{
+	llist_item_t *i;
+
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_FOREACH(batch, i)
+		apoint_store_add(&apoint_index, LLIST_GET_DATA(i));
+	LLIST_TS_BULK_SPLICE(&alist_p, batch);
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/*
+ * Remove and free the appointments for which fn_match returns a non-zero
+ * value when passed their representation in the data files.
+ */
+void apoint_llist_drop(item_fn_match_t fn_match, void *arg)
+{
+	llist_item_t *i, *next;
+	struct apoint *apt;
+	char *str;
+	int match;
+
+	LLIST_TS_LOCK(&alist_p);
+	for (i = LLIST_TS_FIRST(&alist_p); i; i = next) {
+		next = LLIST_TS_NEXT(i);
+		apt = LLIST_TS_GET_DATA(i);
+		str = apoint_tostr(apt);
+		match = fn_match(str, arg);
+		mem_free(str);
+		if (!match)
+			continue;
+		LLIST_TS_REMOVE(&alist_p, i);
+		apoint_store_remove(&apoint_index, apt->start, apt);
+		apoint_free(apt);
+	}
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/*
+ * Update the position of an appointment whose start time or duration was
+ * modified in place. The start time the appointment was indexed with must be
+ * passed as second argument.
+ */
+void apoint_reindex(struct apoint *apt, long old_start)
+{
+	llist_item_t *i;
+
+	LLIST_TS_LOCK(&alist_p);
+
+	i = LLIST_TS_FIND_FIRST(&alist_p, apt, NULL);
+	if (!i)
+		EXIT(_("no such appointment"));
+	LLIST_TS_REMOVE(&alist_p, i);
+	LLIST_TS_ADD_SORTED(&alist_p, apt, apoint_cmp);
+
+	apoint_store_remove(&apoint_index, old_start, apt);
+	apoint_store_add(&apoint_index, apt);
+
+	LLIST_TS_UNLOCK(&alist_p);
+}
+
+/*
+ * Call fn_visit on every appointment overlapping the period [from, to), in
+ * ascending order of start times. Stops as soon as fn_visit returns a non-zero
+ * value, and returns that value.
+ */
+int apoint_foreach_overlap(long from, long to, apoint_fn_visit_t fn_visit,
+			   void *arg)
+{
+	int ret;
+
+	LLIST_TS_LOCK(&alist_p);
+	ret = apoint_store_query(&apoint_index, from, to, fn_visit, arg);
+	LLIST_TS_UNLOCK(&alist_p);
+
+	return ret;
+}
+
 unsigned apoint_inday(struct apoint *i, long *start)
 {
 	return (date_cmp_day(i->start, *start) == 0 ||
@@ -124,6 +458,12 @@ unsigned apoint_inday(struct apoint *i, long *start)
 		 date_cmp_day(i->start + i->dur - 1, *start) >= 0));
 }
 
+/* Check if an appointment overlaps the interval [from, to). */
+unsigned apoint_overlap(struct apoint *apt, long from, long to)
+{
+	return apt->start < to && APOINT_END(apt) > from;
+}
+
 void apoint_sec2str(struct apoint *o, long day, char *start, char *end)
 {
 	struct tm lt;
@@ -147,33 +487,47 @@ void apoint_sec2str(struct apoint *o, long day, char *start, char *end)
 	}
 }
 
-char *apoint_tostr(struct apoint *o)
+/* Append a date and time in the format of the data files. */
+void apoint_cat_datetime(struct string *s, long date)
 {
-	struct string s;
 	struct tm lt;
-	time_t t;
-
-	string_init(&s);
-
-	t = o->start;
-	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
+	time_t t = date;
 
-	t = o->start + o->dur;
 	localtime_r(&t, &lt);
-	string_catf(&s, " -> %02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
+	string_catdate(s, 1900 + lt.tm_year, lt.tm_mon + 1, lt.tm_mday);
+	string_cat(s, " @ ");
+	string_catint(s, lt.tm_hour, 2);
+	string_catc(s, ':');
+	string_catint(s, lt.tm_min, 2);
+}
 
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
+/* Append an appointment in the format of the data file. */
+void apoint_catstr(struct string *s, struct apoint *o)
+{
+	apoint_cat_datetime(s, o->start);
+	string_cat(s, " -> ");
+	apoint_cat_datetime(s, o->start + o->dur);
+
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
 
 	if (o->state & APOINT_NOTIFY)
-		string_catf(&s, "%c", '!');
+		string_catc(s, '!');
 	else
-		string_catf(&s, "%c", '|');
+		string_catc(s, '|');
 
-	string_catf(&s, "%s", o->mesg);
+	string_cat(s, o->mesg);
+}
+
+char *apoint_tostr(struct apoint *o)
+{
+	struct string s;
+
+	string_init(&s);
+	apoint_catstr(&s, o);
 
 	return string_buf(&s);
 }
@@ -195,26 +549,29 @@ void apoint_write(struct apoint *o, FILE * f)
 	mem_free(str);
 }
 
-struct apoint *apoint_scan(FILE * f, struct tm start, struct tm end,
-			   char state, char *note, struct item_filter *filter)
+/*
+ * Create an appointment read from the data file. The description is NULL if
+ * the end of the file was reached before it. The appointment is not added to
+ * the list of appointments. If the item is invalid, NULL is returned and *err
+ * is set to an error message.
+ */
+struct apoint *apoint_scan(char *buf, struct tm start, struct tm end,
+			   char state, char *note, struct item_filter *filter,
+			   const char **err)
 {
-	char buf[BUFSIZ], *newline;
 	time_t tstart, tend;
 	struct apoint *apt;
 
-	EXIT_IF(!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
-		!check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
-		!check_time(start.tm_hour, start.tm_min) ||
-		!check_time(end.tm_hour, end.tm_min),
-		_("date error in appointment"));
-
-	/* Read the appointment description */
-	if (!fgets(buf, sizeof buf, f))
+	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
+	    !check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
+	    !check_time(start.tm_hour, start.tm_min) ||
+	    !check_time(end.tm_hour, end.tm_min)) {
+		*err = _("date error in appointment");
 		return NULL;
+	}
 
-	newline = strchr(buf, '\n');
-	if (newline)
-		*newline = '\0';
+	if (!buf)
+		return NULL;
 
 	start.tm_sec = end.tm_sec = 0;
 	start.tm_isdst = end.tm_isdst = -1;
@@ -225,8 +582,10 @@ struct apoint *apoint_scan(FILE * f, struct tm start, struct tm end,
 
 	tstart = mktime(&start);
 	tend = mktime(&end);
-	EXIT_IF(tstart == -1 || tend == -1 || tstart > tend,
-		_("date error in appointment"));
+	if (tstart == -1 || tend == -1 || tstart > tend) {
+		*err = _("date error in appointment");
+		return NULL;
+	}
 
 	/* Filter item. */
 	if (filter) {
@@ -244,13 +603,13 @@ struct apoint *apoint_scan(FILE * f, struct tm start, struct tm end,
 			return NULL;
 	}
 
-	apt = apoint_new(buf, note, tstart, tend - tstart, state);
+	apt = apoint_alloc(buf, note, tstart, tend - tstart, state);
 
 	/* Filter by hash. */
 	if (filter && filter->hash) {
 		char *hash = apoint_hash(apt);
 		if (!hash_matches(filter->hash, hash)) {
-			apoint_delete(apt);
+			apoint_free(apt);
 			apt = NULL;
 		}
 		mem_free(hash);
@@ -263,7 +622,7 @@ void apoint_delete(struct apoint *apt)
 {
 	LLIST_TS_LOCK(&alist_p);
 
-	llist_item_t *i = LLIST_TS_FIND_FIRST(&alist_p, apt, NULL);
+	llist_item_t *i = LLIST_TS_FIND_SORTED(&alist_p, apt, apoint_cmp);
 	int need_check_notify = 0;
 
 	if (!i)
@@ -272,6 +631,7 @@ void apoint_delete(struct apoint *apt)
 	if (notify_bar())
 		need_check_notify = notify_same_item(apt->start);
 	LLIST_TS_REMOVE(&alist_p, i);
+	apoint_store_remove(&apoint_index, apt->start, apt);
 	if (need_check_notify)
 		notify_check_next_app(0);
 
@@ -330,6 +690,7 @@ void apoint_paste_item(struct apoint *apt, long date)
 
 	LLIST_TS_LOCK(&alist_p);
 	LLIST_TS_ADD_SORTED(&alist_p, apt, apoint_cmp);
+	apoint_store_add(&apoint_index, apt);
 	LLIST_TS_UNLOCK(&alist_p);
 
 	if (notify_bar())
@@ -41,6 +41,7 @@
 #include <limits.h>
 #include <getopt.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "calcurse.h"
 
@@ -65,6 +66,7 @@ enum {
 	OPT_FROM,
 	OPT_TO,
 	OPT_DAYS,
+	OPT_JOBS,
 	OPT_FMT_APT,
 	OPT_FMT_RAPT,
 	OPT_FMT_EV,
@@ -84,7 +86,7 @@ static void usage(void)
 {
 	printf("%s\n", _("usage: calcurse [--daemon|-F|-G|-g|-i<file>|-Q|--status|-x[<format>]]\n"
 			 "                [-c<file>] [-C<path>] [-D<path>] [-h] [-q] [--read-only] [-v]\n"
-			 "                [--filter-*] [--format-*]"));
+			 "                [--filter-*] [--format-*] [--jobs <num>]"));
 }
 
 static void usage_try(void)
@@ -126,6 +128,7 @@ static void help_arg(void)
 	printf("%s\n", _("  -g, --gc                Run the garbage collector and exit"));
 	printf("%s\n", _("  -h, --help              Show this help text and exit"));
 	printf("%s\n", _("  -i, --import <file>     Import iCal data from a file"));
+	printf("%s\n", _("  --jobs <num>            Use <num> threads to print query ranges"));
 	printf("%s\n", _("  -q, --quiet             Do not show system dialogs"));
 	printf("%s\n", _("  --read-only             Do not save configuration or data files"));
 	printf("%s\n", _("  --status                Display the status of running instances"));
@@ -189,7 +192,7 @@ static int todo_arg(const char *format, int *limit, struct item_filter *filter)
 			fputs(titlestr, stdout);
 			title = 0;
 		}
-		print_todo(format, todo);
+		print_todo(stdout, format, todo);
 		n++;
 		(*limit)--;
 	}
@@ -208,8 +211,7 @@ static void next_arg(void)
 	next_app.got_app = 0;
 	next_app.txt = NULL;
 
-	next_app = *recur_apoint_check_next(&next_app, current_time,
-					    get_today());
+	next_app = *recur_apoint_check_next(&next_app, current_time);
 	next_app = *apoint_check_next(&next_app, current_time);
 
 	if (next_app.got_app) {
@@ -237,29 +239,249 @@ static void arg_print_date(long date)
 	fputs(":\n", stdout);
 }
 
+/* Output settings shared by the days of a query range. */
+struct date_arg_day {
+	int add_line;
+	const char *fmt_apt;
+	const char *fmt_rapt;
+	const char *fmt_ev;
+	const char *fmt_rev;
+	int *limit;
+};
+
+static int date_arg_day(long date, struct date_arg_day *arg)
+{
+	if (arg->add_line)
+		fputs("\n", stdout);
+	arg_print_date(date);
+	day_write_stdout(date, arg->fmt_apt, arg->fmt_rapt, arg->fmt_ev,
+			 arg->fmt_rev, arg->limit);
+	arg->add_line = 1;
+
+	return 0;
+}
+
+/* Number of chunks given to each worker of a parallel range query. */
+#define DATE_ARG_CHUNKS_PER_JOB 8
+
+/* Days of a query range formatted by one worker. */
+struct date_arg_chunk {
+	unsigned first;		/* first day of the chunk */
+	unsigned last;		/* day following the last day of the chunk */
+	char *buf;		/* formatted items */
+	size_t len;
+	size_t *end;		/* end of each item in buf */
+	int done;
+};
+
+/* Work shared by the workers of a parallel range query. */
+struct date_arg_pool {
+	struct date_arg_day *arg;
+	struct day_range_items items;
+	struct date_arg_chunk *chunk;
+	unsigned nchunks;
+	unsigned next;		/* next chunk to be formatted */
+	int limit_reached;	/* no need to format further items */
+	pthread_mutex_t mutex;
+	pthread_cond_t done;
+};
+
+/* Format the items of a chunk into a memory buffer. */
+static void date_arg_format_chunk(struct date_arg_pool *pool,
+				  struct date_arg_chunk *c)
+{
+	struct date_arg_day *arg = pool->arg;
+	struct day_range_items *items = &pool->items;
+	unsigned base, i, j;
+	FILE *out;
+
+	out = open_memstream(&c->buf, &c->len);
+	EXIT_IF(out == NULL, _("cannot allocate output buffer"));
+
+	base = j = c->first > 0 ? items->end[c->first - 1] : 0;
+	for (i = c->first; i < c->last; i++) {
+		for (; j < items->end[i]; j++) {
+			day_item_write(out, &items->item[j], items->date[i],
+				       arg->fmt_apt, arg->fmt_rapt,
+				       arg->fmt_ev, arg->fmt_rev);
+			c->end[j - base] = ftell(out);
+		}
+	}
+
+	fclose(out);
+}
+
+static void *date_arg_worker(void *arg)
+{
+	struct date_arg_pool *pool = arg;
+	struct date_arg_chunk *c;
+	int skip;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->mutex);
+		if (pool->next == pool->nchunks) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+		c = &pool->chunk[pool->next++];
+		skip = pool->limit_reached;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (!skip)
+			date_arg_format_chunk(pool, c);
+
+		pthread_mutex_lock(&pool->mutex);
+		c->done = 1;
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * Write a formatted chunk to stdout, with the same output and limit handling
+ * as date_arg_day() called on each of its days.
+ */
+static void date_arg_emit_chunk(struct date_arg_pool *pool,
+				struct date_arg_chunk *c)
+{
+	struct date_arg_day *arg = pool->arg;
+	struct day_range_items *items = &pool->items;
+	unsigned base, i, j, n;
+	size_t from, to;
+
+	base = j = c->first > 0 ? items->end[c->first - 1] : 0;
+	for (i = c->first; i < c->last; i++) {
+		n = items->end[i] - j;
+		if (n == 0)
+			continue;
+
+		if (arg->add_line)
+			fputs("\n", stdout);
+		arg_print_date(items->date[i]);
+		if (*arg->limit >= 0 && (unsigned)*arg->limit < n)
+			n = *arg->limit;
+		if (n > 0) {
+			from = j > base ? c->end[j - base - 1] : 0;
+			to = c->end[j + n - base - 1];
+			fwrite(c->buf + from, 1, to - from, stdout);
+			*arg->limit -= n;
+		}
+		arg->add_line = 1;
+		j = items->end[i];
+	}
+}
+
+/*
+ * Print the items of a query range using the given number of worker threads.
+ * The items of each day are collected in a single pass, workers then format
+ * chunks of consecutive days into separate buffers which are written to
+ * stdout in order.
+ */
+static void date_arg_parallel(long from, long to, struct date_arg_day *arg,
+			      int jobs)
+{
+	struct date_arg_pool pool;
+	struct date_arg_chunk *c;
+	pthread_t *worker;
+	unsigned per_chunk, base, i;
+	int nworkers;
+
+	pool.arg = arg;
+	day_range_collect(from, to, &pool.items);
+	if (pool.items.ndays == 0) {
+		day_range_free(&pool.items);
+		return;
+	}
+
+	pool.nchunks = pool.items.ndays;
+	if ((unsigned)jobs < pool.nchunks / DATE_ARG_CHUNKS_PER_JOB)
+		pool.nchunks = jobs * DATE_ARG_CHUNKS_PER_JOB;
+	per_chunk = (pool.items.ndays + pool.nchunks - 1) / pool.nchunks;
+	pool.nchunks = (pool.items.ndays + per_chunk - 1) / per_chunk;
+	pool.chunk = mem_calloc(pool.nchunks, sizeof(struct date_arg_chunk));
+	for (i = 0; i < pool.nchunks; i++) {
+		c = &pool.chunk[i];
+		c->first = i * per_chunk;
+		c->last = c->first + per_chunk;
+		if (c->last > pool.items.ndays)
+			c->last = pool.items.ndays;
+		base = c->first > 0 ? pool.items.end[c->first - 1] : 0;
+		if (pool.items.end[c->last - 1] > base)
+			c->end = mem_malloc((pool.items.end[c->last - 1] -
+					     base) * sizeof(size_t));
+	}
+	pool.next = 0;
+	pool.limit_reached = (*arg->limit == 0);
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	nworkers = jobs < (int)pool.nchunks ? jobs : (int)pool.nchunks;
+	worker = mem_malloc(nworkers * sizeof(pthread_t));
+	for (i = 0; i < (unsigned)nworkers; i++)
+		pthread_create(&worker[i], NULL, date_arg_worker, &pool);
+
+	for (i = 0; i < pool.nchunks; i++) {
+		c = &pool.chunk[i];
+
+		pthread_mutex_lock(&pool.mutex);
+		while (!c->done)
+			pthread_cond_wait(&pool.done, &pool.mutex);
+		pthread_mutex_unlock(&pool.mutex);
+
+		date_arg_emit_chunk(&pool, c);
+		/* Buffers are allocated by open_memstream(). */
+		free(c->buf);
+		if (c->end)
+			mem_free(c->end);
+
+		if (*arg->limit == 0) {
+			pthread_mutex_lock(&pool.mutex);
+			pool.limit_reached = 1;
+			pthread_mutex_unlock(&pool.mutex);
+		}
+	}
+
+	for (i = 0; i < (unsigned)nworkers; i++)
+		pthread_join(worker[i], NULL);
+	mem_free(worker);
+
+	pthread_cond_destroy(&pool.done);
+	pthread_mutex_destroy(&pool.mutex);
+	mem_free(pool.chunk);
+	day_range_free(&pool.items);
+}
+
 /*
  * Print appointments inside the given query range.
  * If no start day is given (-1), today is considered.
  * If no end date is given (-1), a range of 1 day is considered.
+ * Days are formatted by the given number of worker threads.
  */
 static void
 date_arg_from_to(long from, long to, int add_line, const char *fmt_apt,
 		 const char *fmt_rapt, const char *fmt_ev, const char *fmt_rev,
-		 int *limit)
+		 int *limit, int jobs)
 {
-	long date;
+	struct date_arg_day arg;
 
-	for (date = from; date < to; date = date_sec_change(date, 0, 1)) {
-		day_store_items(date, 0);
-		if (day_item_count(0) == 0)
-			continue;
-		if (add_line)
-			fputs("\n", stdout);
-		arg_print_date(date);
-		day_write_stdout(date, fmt_apt, fmt_rapt, fmt_ev,
-				 fmt_rev, limit);
-		add_line = 1;
-	}
+	arg.add_line = add_line;
+	arg.fmt_apt = fmt_apt;
+	arg.fmt_rapt = fmt_rapt;
+	arg.fmt_ev = fmt_ev;
+	arg.fmt_rev = fmt_rev;
+	arg.limit = limit;
+
+#ifdef CALCURSE_MEMORY_DEBUG
+	/* Allocation statistics are not thread-safe. */
+	jobs = 1;
+#endif
+	if (jobs > 1)
+		date_arg_parallel(from, to, &arg, jobs);
+	else
+		day_foreach_range(from, to, (day_fn_visit_t)date_arg_day,
+				  &arg);
 }
 
 static time_t parse_datearg(const char *str)
@@ -393,6 +615,7 @@ int parse_args(int argc, char **argv)
 	time_t from = -1, to = -1;
 	int range = 0;
 	int limit = INT_MAX;
+	int jobs = 1;
 	/* Filters */
 	struct item_filter filter = { 0, NULL, NULL, -1, -1, -1, -1, 0, 0, 0 };
 	/* Format strings */
@@ -456,6 +679,7 @@ int parse_args(int argc, char **argv)
 		{"from", required_argument, NULL, OPT_FROM},
 		{"to", required_argument, NULL, OPT_TO},
 		{"days", required_argument, NULL, OPT_DAYS},
+		{"jobs", required_argument, NULL, OPT_JOBS},
 		{"format-apt", required_argument, NULL, OPT_FMT_APT},
 		{"format-recur-apt", required_argument, NULL, OPT_FMT_RAPT},
 		{"format-event", required_argument, NULL, OPT_FMT_EV},
@@ -665,6 +889,11 @@ int parse_args(int argc, char **argv)
 			range = atoi(optarg);
 			EXIT_IF(range == 0, _("invalid range: %s"), optarg);
 			break;
+		case OPT_JOBS:
+			jobs = atoi(optarg);
+			EXIT_IF(jobs <= 0, _("invalid number of jobs: %s"),
+				optarg);
+			break;
 		case OPT_FMT_APT:
 			fmt_apt = optarg;
 			break;
@@ -740,8 +969,8 @@ int parse_args(int argc, char **argv)
 		config_load();	/* To get output date format. */
 		io_load_data(&filter);
 		if (grep_filter) {
-			io_save_todo(path_todo);
-			io_save_apts(path_apts);
+			io_save_todo(path_todo, NULL);
+			io_save_apts(path_apts, NULL);
 		} else {
 			/*
 			 * Use default values for non-specified format strings.
@@ -771,7 +1000,7 @@ int parse_args(int argc, char **argv)
 
 		int add_line = todo_arg(fmt_todo, &limit, &filter);
 		date_arg_from_to(from, to, add_line, fmt_apt, fmt_rapt, fmt_ev,
-				 fmt_rev, &limit);
+				 fmt_rev, &limit, jobs);
 	} else if (next) {
 		io_check_file(path_apts);
 		io_load_app(&filter);
@@ -804,8 +1033,11 @@ int parse_args(int argc, char **argv)
 		}
 		io_import_data(IO_IMPORT_ICAL, ifile, fmt_ev, fmt_rev, fmt_apt,
 			       fmt_rapt, fmt_todo);
-		io_save_apts(path_apts);
-		io_save_todo(path_todo);
+		/* Do not overwrite changes made while importing. */
+		EXIT_IF(io_check_data_files_modified(),
+			_("data files changed since reading, import aborted"));
+		io_save_apts(path_apts, NULL);
+		io_save_todo(path_todo, NULL);
 	} else if (export) {
 		io_check_file(path_apts);
 		io_check_file(path_todo);
@@ -162,7 +162,6 @@ static inline void key_del_item(void)
 {
 	if (wins_slctd() == APP) {
 		ui_day_item_delete(reg);
-		do_storage(0);
 		wins_update(FLAG_CAL | FLAG_APP | FLAG_STA);
 	} else if (wins_slctd() == TOD) {
 		ui_todo_delete();
@@ -174,7 +173,6 @@ static inline void key_generic_copy(void)
 {
 	if (wins_slctd() == APP) {
 		ui_day_item_copy(reg);
-		do_storage(0);
 		wins_update(FLAG_CAL | FLAG_APP);
 	}
 }
@@ -183,7 +181,6 @@ static inline void key_generic_paste(void)
 {
 	if (wins_slctd() == APP) {
 		ui_day_item_paste(reg);
-		do_storage(0);
 		wins_update(FLAG_CAL | FLAG_APP);
 	}
 }
@@ -192,7 +189,6 @@ static inline void key_repeat_item(void)
 {
 	if (wins_slctd() == APP)
 		ui_day_item_repeat();
-	do_storage(0);
 	wins_update(FLAG_CAL | FLAG_APP | FLAG_STA);
 }
 
@@ -200,7 +196,6 @@ static inline void key_flag_item(void)
 {
 	if (wins_slctd() == APP) {
 		ui_day_flag();
-		do_storage(0);
 		wins_update(FLAG_APP);
 	} else if (wins_slctd() == TOD) {
 		ui_todo_flag();
@@ -239,7 +234,6 @@ static inline void key_edit_note(void)
 {
 	if (wins_slctd() == APP) {
 		ui_day_edit_note();
-		do_storage(0);
 	} else if (wins_slctd() == TOD) {
 		ui_todo_edit_note();
 	}
@@ -280,7 +274,7 @@ static inline void key_generic_reload(void)
 	if (io_reload_data()) {
 		do_storage(0);
 		notify_check_next_app(1);
-		ui_calendar_monthly_view_cache_set_invalid();
+		ui_calendar_day_cache_set_invalid();
 		wins_update(FLAG_ALL);
 	}
 }
@@ -289,7 +283,7 @@ static inline void key_generic_import(void)
 {
 	wins_erase_status_bar();
 	io_import_data(IO_IMPORT_ICAL, NULL, NULL, NULL, NULL, NULL, NULL);
-	ui_calendar_monthly_view_cache_set_invalid();
+	ui_calendar_day_cache_set_invalid();
 	do_storage(0);
 	wins_update(FLAG_ALL);
 }
@@ -434,9 +428,11 @@ static inline void key_generic_scroll_up(void)
 {
 	if (wins_slctd() == CAL) {
 		ui_calendar_view_prev();
+		io_set_modified(IO_MODIFIED_CONF);
 		wins_update(FLAG_CAL | FLAG_APP);
 	} else if (wins_slctd() == TOD) {
 		ui_todo_view_prev();
+		io_set_modified(IO_MODIFIED_CONF);
 		wins_update(FLAG_TOD | FLAG_APP);
 	}
 }
@@ -445,9 +441,11 @@ static inline void key_generic_scroll_down(void)
 {
 	if (wins_slctd() == CAL) {
 		ui_calendar_view_next();
+		io_set_modified(IO_MODIFIED_CONF);
 		wins_update(FLAG_CAL | FLAG_APP);
 	} else if (wins_slctd() == TOD) {
 		ui_todo_view_next();
+		io_set_modified(IO_MODIFIED_CONF);
 		wins_update(FLAG_TOD | FLAG_APP);
 	}
 }
@@ -624,7 +622,10 @@ int main(int argc, char **argv)
 	io_load_data(NULL);
 	run_hook("post-load");
 
-	io_unset_modified();
+	/* Write the files that had to be created in full on the next save. */
+	io_unset_modified(IO_MODIFIED_ALL);
+	if (no_data_file)
+		io_set_modified(IO_MODIFIED_ALL);
 	wins_slctd_set(conf.default_panel);
 	wins_resize();
 	/*
@@ -636,7 +637,7 @@ int main(int argc, char **argv)
 		wins_update(FLAG_ALL);
 		io_startup_screen(no_data_file);
 	}
-	ui_calendar_monthly_view_cache_set_invalid();
+	ui_calendar_day_cache_set_invalid();
 	do_storage(1);
 	ui_todo_load_items();
 	ui_todo_sel_reset();
@@ -648,6 +649,8 @@ int main(int argc, char **argv)
 	ui_calendar_start_date_thread();
 	if (conf.periodic_save > 0)
 		io_start_psave_thread();
+	if (conf.auto_reload)
+		io_start_watch_thread();
 
 	/* User input */
 	for (;;) {
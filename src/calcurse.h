@@ -53,11 +53,12 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <regex.h>
 
 #include "llist.h"
 #include "vector.h"
-#include "htable.h"
+#include "hashmap.h"
 #include "llist_ts.h"
 
 /* Internationalization. */
@@ -167,9 +168,6 @@
 /* Register definitions. */
 #define REG_BLACK_HOLE 37
 
-/* Size of the hash table the note garbage collector uses. */
-#define NOTE_GC_HSIZE 1024
-
 /* Mnemonics */
 #define NOHILT		0 	/* 'No highlight' argument */
 
@@ -260,7 +258,9 @@ enum pos {
 struct conf {
 	unsigned auto_save;
 	unsigned auto_gc;
+	unsigned auto_reload;
 	unsigned periodic_save;
+	unsigned trust_file_stat;
 	unsigned confirm_quit;
 	unsigned confirm_delete;
 	enum win default_panel;
@@ -331,6 +331,8 @@ struct apoint {
 	char *note;
 };
 
+typedef int (*apoint_fn_visit_t) (struct apoint *, void *);
+
 /* Event definition. */
 struct event {
 	int id;			/* event identifier */
@@ -347,8 +349,11 @@ struct todo {
 	char *note;
 };
 
-struct excp {
-	long st;		/* beggining of the considered day, in seconds */
+/* Days on which a recurrent item is not repeated. */
+struct exc_days {
+	unsigned count;		/* number of exceptions */
+	unsigned size;		/* number of allocated entries */
+	long *day;		/* sorted day numbers (days since 1 jan 1970) */
 };
 
 enum recur_type {
@@ -370,7 +375,7 @@ struct rpt {
 /* Recurrent appointment definition. */
 struct recur_apoint {
 	struct rpt *rpt;	/* information about repetition */
-	llist_t exc;		/* days when the item should not be repeated */
+	struct exc_days exc;	/* days when the item should not be repeated */
 	long start;		/* beggining of the appointment */
 	long dur;		/* duration of the appointment */
 	char state;		/* 8 bits to store item state */
@@ -381,13 +386,28 @@ struct recur_apoint {
 /* Reccurent event definition. */
 struct recur_event {
 	struct rpt *rpt;	/* information about repetition */
-	llist_t exc;		/* days when the item should not be repeated */
+	struct exc_days exc;	/* days when the item should not be repeated */
 	int id;			/* event type */
 	long day;		/* day at which event occurs */
 	char *mesg;		/* event description */
 	char *note;		/* note attached to event */
 };
 
+/* Iterator over the occurrences of a recurrent item. */
+struct recur_occurrence_iter {
+	long dur;		/* duration of an occurrence */
+	struct exc_days *exc;	/* days without occurrence */
+	enum recur_type type;	/* repetition type */
+	int freq;		/* repetition frequency */
+	long until;		/* day number of the last possible occurrence */
+	long first;		/* day number of the first occurrence */
+	int yyyy, mm, dd;	/* date of the first occurrence */
+	unsigned hour, min;	/* time of day of every occurrence */
+	long span;		/* number of days the last occurrence spills over */
+	long n;			/* index of the next candidate occurrence */
+	long day;		/* day number of the last occurrence returned */
+};
+
 /* Generic pointer data type for appointments and events. */
 union aptev_ptr {
 	struct apoint *apt;
@@ -439,6 +459,9 @@ struct item_filter {
 	int uncompleted;
 };
 
+/* Match an item by its representation in the data files. */
+typedef int (*item_fn_match_t) (const char *, void *);
+
 /* Generic item description (to hold appointments, events...). */
 struct day_item {
 	enum day_item_type type;
@@ -446,6 +469,30 @@ struct day_item {
 	union aptev_ptr item;
 };
 
+/*
+ * Items of a range of days. The items of day i are item[end[i - 1]] to
+ * item[end[i] - 1], with end[-1] taken as 0.
+ */
+struct day_range_items {
+	unsigned ndays;
+	long *date;
+	unsigned *end;
+	struct day_item *item;
+};
+
+/* Called for each day of a range with the items of that day stored. */
+typedef int (*day_fn_visit_t) (long, void *);
+
+/* Occurrence of a recurrent item on a given day. */
+struct recur_occ {
+	long day;		/* day number the occurrence is shown on */
+	long start;		/* start time of the occurrence */
+	enum day_item_type type;
+	union aptev_ptr item;
+};
+
+typedef int (*recur_fn_visit_t) (struct recur_occ *, void *);
+
 /* Available views for the calendar panel. */
 enum {
 	CAL_MONTH_VIEW,
@@ -714,6 +761,15 @@ enum save_display {
 	IO_SAVE_DISPLAY_NONE
 };
 
+/* Files with unsaved modifications, see io_set_modified(). */
+#define IO_MODIFIED_APTS (1 << 0)
+#define IO_MODIFIED_TODO (1 << 1)
+#define IO_MODIFIED_CONF (1 << 2)
+#define IO_MODIFIED_KEYS (1 << 3)
+#define IO_MODIFIED_DATA (IO_MODIFIED_APTS | IO_MODIFIED_TODO)
+#define IO_MODIFIED_ALL  (IO_MODIFIED_DATA | IO_MODIFIED_CONF | \
+			  IO_MODIFIED_KEYS)
+
 /* apoint.c */
 extern llist_ts_t alist_p;
 void apoint_free_bkp(void);
@@ -721,14 +777,22 @@ struct apoint *apoint_dup(struct apoint *);
 void apoint_free(struct apoint *);
 void apoint_llist_init(void);
 void apoint_llist_free(void);
+void apoint_llist_splice(llist_t *);
+void apoint_llist_drop(item_fn_match_t, void *);
+int apoint_cmp(struct apoint *, struct apoint *);
 struct apoint *apoint_new(char *, char *, long, long, char);
+void apoint_reindex(struct apoint *, long);
+int apoint_foreach_overlap(long, long, apoint_fn_visit_t, void *);
 unsigned apoint_inday(struct apoint *, long *);
+unsigned apoint_overlap(struct apoint *, long, long);
 void apoint_sec2str(struct apoint *, long, char *, char *);
+void apoint_cat_datetime(struct string *, long);
+void apoint_catstr(struct string *, struct apoint *);
 char *apoint_tostr(struct apoint *);
 char *apoint_hash(struct apoint *);
 void apoint_write(struct apoint *, FILE *);
-struct apoint *apoint_scan(FILE *, struct tm, struct tm, char, char *,
-			   struct item_filter *);
+struct apoint *apoint_scan(char *, struct tm, struct tm, char, char *,
+			   struct item_filter *, const char **);
 void apoint_delete(struct apoint *);
 struct notify_app *apoint_check_next(struct notify_app *, long);
 void apoint_switch_notify(struct apoint *);
@@ -752,7 +816,9 @@ void ui_calendar_store_current_date(struct date *);
 void ui_calendar_init_slctd_day(void);
 struct date *ui_calendar_get_slctd_day(void);
 time_t ui_calendar_get_slctd_day_sec(void);
-void ui_calendar_monthly_view_cache_set_invalid(void);
+void ui_calendar_day_cache_set_invalid(void);
+void ui_calendar_day_cache_update(long, long);
+void ui_calendar_day_cache_free(void);
 void ui_calendar_update_panel(void);
 void ui_calendar_goto_today(void);
 void ui_calendar_change_day(int);
@@ -760,6 +826,14 @@ void ui_calendar_move(enum move, int);
 long ui_calendar_start_of_year(void);
 long ui_calendar_end_of_year(void);
 
+/* civil.c */
+long civil_days(int, int, int);
+void civil_date(long, int *, int *, int *);
+void civil_localtime(long, struct tm *);
+long civil_day(long);
+long civil_mktime(struct tm *);
+void civil_free(void);
+
 /* config.c */
 void config_load(void);
 unsigned config_save(void);
@@ -785,14 +859,23 @@ int day_item_get_state(struct day_item *);
 void day_item_add_exc(struct day_item *, long);
 void day_item_fork(struct day_item *, struct day_item *);
 void day_store_items(long, int);
+void day_insert_item(int, union aptev_ptr);
+void day_remove_item(union aptev_ptr);
+void day_update_item(int, union aptev_ptr);
+void day_range_collect(long, long, struct day_range_items *);
+void day_range_free(struct day_range_items *);
+void day_foreach_range(long, long, day_fn_visit_t, void *);
 void day_process_storage(struct date *, unsigned);
 void day_display_item_date(struct day_item *, WINDOW *, int, long, int, int);
 void day_display_item(struct day_item *, WINDOW *, int, int, int, int);
+void day_item_write(FILE *, struct day_item *, long, const char *,
+		    const char *, const char *, const char *);
 void day_write_stdout(long, const char *, const char *, const char *,
 		      const char *, int *);
 void day_popup_item(struct day_item *);
 int day_check_if_item(struct date);
-unsigned day_chk_busy_slices(struct date, int, int *);
+void day_check_range(long, unsigned, unsigned char *);
+void day_chk_busy_slices(struct date, int, int, int *, unsigned *);
 struct day_item *day_cut_item(long, int);
 int day_paste_item(struct day_item *, long);
 int day_get_position_by_aptev_ptr(union aptev_ptr);
@@ -814,12 +897,17 @@ struct event *event_dup(struct event *);
 void event_free(struct event *);
 void event_llist_init(void);
 void event_llist_free(void);
+void event_llist_splice(llist_t *);
+void event_llist_drop(item_fn_match_t, void *);
+int event_cmp(struct event *, struct event *);
 struct event *event_new(char *, char *, long, int);
 unsigned event_inday(struct event *, long *);
+void event_catstr(struct string *, struct event *);
 char *event_tostr(struct event *);
 char *event_hash(struct event *);
 void event_write(struct event *, FILE *);
-struct event *event_scan(FILE *, struct tm, int, char *, struct item_filter *);
+struct event *event_scan(char *, struct tm, int, char *, struct item_filter *,
+			 const char **);
 void event_delete(struct event *);
 void event_paste_item(struct event *, long);
 
@@ -844,15 +932,16 @@ unsigned io_fprintln(const char *, const char *, ...);
 void io_init(const char *, const char *, const char *);
 void io_extract_data(char *, const char *, int);
 void io_dump_apts(const char *, const char *, const char *, const char *);
-unsigned io_save_apts(const char *);
+unsigned io_save_apts(const char *, char *);
 void io_dump_todo(const char *);
-unsigned io_save_todo(const char *);
+unsigned io_save_todo(const char *, char *);
 unsigned io_save_keys(void);
 void io_save_cal(enum save_display);
 void io_load_app(struct item_filter *);
 void io_load_todo(struct item_filter *);
 void io_load_data(struct item_filter *);
 int io_reload_data(void);
+int io_check_data_files_modified(void);
 void io_load_keys(const char *);
 int io_check_dir(const char *);
 unsigned io_dir_exists(const char *);
@@ -869,14 +958,19 @@ void io_log_display(struct io_file *, const char *, const char *);
 void io_log_free(struct io_file *);
 void io_start_psave_thread(void);
 void io_stop_psave_thread(void);
+int io_watch_init(void);
+void io_watch_free(void);
+int io_watch_wait(int);
+void io_start_watch_thread(void);
+void io_stop_watch_thread(void);
 void io_set_lock(void);
 unsigned io_dump_pid(char *);
 unsigned io_get_pid(char *);
 int io_files_equal(const char *, const char *);
 int io_file_is_empty(char *);
 int io_file_cp(const char *, const char *);
-void io_unset_modified(void);
-void io_set_modified(void);
+void io_unset_modified(int);
+void io_set_modified(int);
 int io_get_modified(void);
 
 /* keys.c */
@@ -922,6 +1016,11 @@ void *xcalloc(size_t, size_t);
 void *xrealloc(void *, size_t, size_t);
 char *xstrdup(const char *);
 void xfree(void *);
+void mem_arena_begin(void);
+void mem_arena_end(void);
+void mem_arena_drop(void);
+void *mem_arena_malloc(size_t);
+char *mem_arena_strdup(const char *);
 
 #ifdef CALCURSE_MEMORY_DEBUG
 
@@ -996,39 +1095,64 @@ void recur_apoint_llist_init(void);
 void recur_event_llist_init(void);
 void recur_apoint_llist_free(void);
 void recur_event_llist_free(void);
+void recur_apoint_llist_splice(llist_t *);
+void recur_event_llist_splice(llist_t *);
+void recur_apoint_llist_drop(item_fn_match_t, void *);
+void recur_event_llist_drop(item_fn_match_t, void *);
+int recur_apoint_cmp(struct recur_apoint *, struct recur_apoint *);
+int recur_event_cmp(struct recur_event *, struct recur_event *);
+void recur_exc_init(struct exc_days *);
+void recur_exc_free(struct exc_days *);
+void recur_exc_add(struct exc_days *, long);
+void recur_exc_add_day(struct exc_days *, int, int, int);
+long recur_exc_nth(struct exc_days *, unsigned);
 struct recur_apoint *recur_apoint_new(char *, char *, long, long, char,
-				      int, int, long, llist_t *);
+				      int, int, long, struct exc_days *);
 struct recur_event *recur_event_new(char *, char *, long, int, int, int,
-				    long, llist_t *);
+				    long, struct exc_days *);
 char recur_def2char(enum recur_type);
 int recur_char2def(char);
-struct recur_apoint *recur_apoint_scan(FILE *, struct tm, struct tm,
+struct recur_apoint *recur_apoint_scan(char *, struct tm, struct tm,
 				       char, int, struct tm, char *,
-				       llist_t *, char, struct item_filter *);
-struct recur_event *recur_event_scan(FILE *, struct tm, int, char,
-				     int, struct tm, char *, llist_t *,
-				     struct item_filter *);
+				       struct exc_days *, char,
+				       struct item_filter *, const char **);
+struct recur_event *recur_event_scan(char *, struct tm, int, char,
+				     int, struct tm, char *,
+				     struct exc_days *, struct item_filter *,
+				     const char **);
+void recur_apoint_catstr(struct string *, struct recur_apoint *);
 char *recur_apoint_tostr(struct recur_apoint *);
 char *recur_apoint_hash(struct recur_apoint *);
 void recur_apoint_write(struct recur_apoint *, FILE *);
+void recur_event_catstr(struct string *, struct recur_event *);
 char *recur_event_tostr(struct recur_event *);
 char *recur_event_hash(struct recur_event *);
 void recur_event_write(struct recur_event *, FILE *);
-void recur_save_data(FILE *);
-unsigned recur_item_find_occurrence(long, long, llist_t *, int,
+unsigned recur_item_find_occurrence(long, long, struct exc_days *, int,
 				    int, long, long, time_t *);
 unsigned recur_apoint_find_occurrence(struct recur_apoint *, long, time_t *);
 unsigned recur_event_find_occurrence(struct recur_event *, long, time_t *);
-unsigned recur_item_inday(long, long, llist_t *, int, int, long, long);
+unsigned recur_item_inday(long, long, struct exc_days *, int, int, long,
+			  long);
 unsigned recur_apoint_inday(struct recur_apoint *, long *);
 unsigned recur_event_inday(struct recur_event *, long *);
+void recur_occurrence_iter_init(struct recur_occurrence_iter *, long, long,
+				struct exc_days *, struct rpt *, long);
+void recur_apoint_iter_init(struct recur_occurrence_iter *,
+			    struct recur_apoint *, long);
+void recur_event_iter_init(struct recur_occurrence_iter *,
+			   struct recur_event *, long);
+int recur_occurrence_iter_next(struct recur_occurrence_iter *, time_t *);
+void recur_cache_flush(void);
+void recur_apoint_update(struct recur_apoint *);
+void recur_event_update(struct recur_event *);
+int recur_foreach_occurrence(long, recur_fn_visit_t, void *);
+int recur_foreach_occurrence_range(long, long, recur_fn_visit_t, void *);
 void recur_event_add_exc(struct recur_event *, long);
 void recur_apoint_add_exc(struct recur_apoint *, long);
 void recur_event_erase(struct recur_event *);
 void recur_apoint_erase(struct recur_apoint *);
-void recur_exc_scan(llist_t *, FILE *);
-struct notify_app *recur_apoint_check_next(struct notify_app *, long,
-					   long);
+struct notify_app *recur_apoint_check_next(struct notify_app *, long);
 void recur_apoint_switch_notify(struct recur_apoint *);
 void recur_event_paste_item(struct recur_event *, long);
 void recur_apoint_paste_item(struct recur_apoint *, long);
@@ -1046,6 +1170,11 @@ int string_grow(struct string *, int);
 char *string_buf(struct string *);
 int string_catf(struct string *, const char *, ...);
 int string_vcatf(struct string *, const char *, va_list);
+int string_catn(struct string *, const char *, int);
+int string_cat(struct string *, const char *);
+int string_catc(struct string *, char);
+int string_catint(struct string *, int, int);
+int string_catdate(struct string *, int, int, int);
 int string_printf(struct string *, const char *, ...);
 int string_catftime(struct string *, const char *, const struct tm *);
 int string_strftime(struct string *, const char *, const struct tm *);
@@ -1054,6 +1183,7 @@ int string_strftime(struct string *, const char *, const struct tm *);
 extern llist_t todolist;
 struct todo *todo_get_item(int, int);
 struct todo *todo_add(char *, int, int, char *);
+void todo_catstr(struct string *, struct todo *);
 char *todo_tostr(struct todo *);
 char *todo_hash(struct todo *);
 void todo_write(struct todo *, FILE *);
@@ -1067,6 +1197,7 @@ void todo_view_note(struct todo *, const char *);
 void todo_free(struct todo *);
 void todo_init_list(void);
 void todo_free_list(void);
+void todo_llist_drop(item_fn_match_t, void *);
 
 /* ui-day.c */
 struct day_item *ui_day_selitem(void);
@@ -1078,6 +1209,7 @@ void ui_day_item_edit(void);
 void ui_day_item_pipe(void);
 void ui_day_item_repeat(void);
 void ui_day_item_cut_free(unsigned);
+void ui_day_item_cut_migrate(void);
 void ui_day_item_copy(unsigned);
 void ui_day_item_paste(unsigned);
 void ui_day_load_items(void);
@@ -1141,6 +1273,7 @@ struct tm date2tm(struct date, unsigned, unsigned);
 time_t date2sec(struct date, unsigned, unsigned);
 time_t utcdate2sec(struct date, unsigned, unsigned);
 int date_cmp_day(time_t, time_t);
+void date_day_bounds(long, long *, long *);
 char *date_sec2date_str(long, const char *);
 void date_sec2date_fmt(long, const char *, char *);
 int date_change(struct tm *, int, int);
@@ -1171,11 +1304,12 @@ int fork_exec(int *, int *, const char *, const char *const *);
 int shell_exec(int *, int *, const char *, const char *const *);
 int child_wait(int *, int *, int);
 void press_any_key(void);
-void print_apoint(const char *, long, struct apoint *);
-void print_event(const char *, long, struct event *);
-void print_recur_apoint(const char *, long, time_t, struct recur_apoint *);
-void print_recur_event(const char *, long, struct recur_event *);
-void print_todo(const char *, struct todo *);
+void print_apoint(FILE *, const char *, long, struct apoint *);
+void print_event(FILE *, const char *, long, struct event *);
+void print_recur_apoint(FILE *, const char *, long, time_t,
+			struct recur_apoint *);
+void print_recur_event(FILE *, const char *, long, struct recur_event *);
+void print_todo(FILE *, const char *, struct todo *);
 int vasprintf(char **, const char *, va_list);
 int asprintf(char **, const char *, ...);
 int starts_with(const char *, const char *);
@@ -1211,7 +1345,7 @@ extern struct pad apad;
 extern struct nbar nbar;
 extern struct dmon_conf dmon;
 void vars_init(void);
-extern pthread_t notify_t_main, io_t_psave, ui_calendar_t_date;
+extern pthread_t notify_t_main, io_t_psave, io_t_watch, ui_calendar_t_date;
 
 /* wins.c */
 extern struct window win[NBWINS];
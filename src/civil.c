@@ -0,0 +1,432 @@
+/*
+ * Calcurse - text-based organizer
+ *
+ * Copyright (c) 2004-2017 calcurse Development Team <misc@calcurse.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer in the documentation and/or other
+ *        materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Send your feedback or comments to : misc@calcurse.org
+ * Calcurse home page : http://calcurse.org
+ *
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "calcurse.h"
+
+/*
+ * Conversion between seconds since the epoch and local civil dates without
+ * going through localtime() and mktime() on every call.
+ *
+ * The offsets of the local time zone are kept in a table of periods during
+ * which both the offset from UTC and the daylight saving time flag do not
+ * change. The table covers a window of time that grows on demand, in blocks
+ * of CIVIL_BLOCK seconds. It is built by probing localtime() every
+ * CIVIL_STRIDE seconds and locating each transition to the second.
+ */
+
+#define CIVIL_BLOCK (1L << 24)
+#define CIVIL_STRIDE (6 * HOURINSEC)
+
+/*
+ * Times outside of this range are handed over to the C library. It spans
+ * about 500 years on either side of the epoch, or as much of it as a long can
+ * hold while leaving room to extend the table by a block.
+ */
+#if LONG_MAX / 2 > 0x400000000L
+#define CIVIL_MAX 0x400000000L
+#else
+#define CIVIL_MAX (LONG_MAX - 2 * CIVIL_BLOCK)
+#endif
+#define CIVIL_MIN (-CIVIL_MAX)
+
+struct civil_period {
+	long start;		/* first second of the period */
+	long off;		/* offset from UTC, in seconds */
+	int isdst;		/* daylight saving time flag */
+};
+
+static struct civil_period *civil_tab;
+static unsigned civil_count, civil_size;
+static long civil_from, civil_to;
+static pthread_rwlock_t civil_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static long floor_div(long a, long b)
+{
+	return a / b - (a % b < 0);
+}
+
+/*
+ * Convert a civil date to the number of days since 1970-01-01, and back. These
+ * are exact for the proleptic Gregorian calendar and do not depend on the time
+ * zone.
+ */
+long civil_days(int y, int m, int d)
+{
+	long era, yoe, doy, doe;
+
+	y -= m <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+void civil_date(long z, int *y, int *m, int *d)
+{
+	long era, doe, yoe, doy, mp;
+
+	z += 719468;
+	era = (z >= 0 ? z : z - 146096) / 146097;
+	doe = z - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	*d = doy - (153 * mp + 2) / 5 + 1;
+	*m = mp + (mp < 10 ? 3 : -9);
+	*y = yoe + era * 400 + (*m <= 2);
+}
+
+/* Ask the C library for the offset and DST flag in effect at a given time. */
+static int civil_probe(long t, struct civil_period *p)
+{
+	struct tm lt;
+	time_t tt = t;
+
+	if (!localtime_r(&tt, &lt))
+		return 0;
+
+	p->start = t;
+	p->off = civil_days(lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday) *
+		 DAYINSEC + lt.tm_hour * HOURINSEC + lt.tm_min * MININSEC +
+		 lt.tm_sec - t;
+	p->isdst = lt.tm_isdst > 0;
+
+	return 1;
+}
+
+static int civil_same(struct civil_period *a, struct civil_period *b)
+{
+	return a->off == b->off && a->isdst == b->isdst;
+}
+
+static void civil_push(struct civil_period **tab, unsigned *count,
+		       unsigned *size, struct civil_period *p)
+{
+	if (!*tab) {
+		*size = 16;
+		*tab = mem_malloc(*size * sizeof(struct civil_period));
+	} else if (*count >= *size) {
+		*size *= 2;
+		*tab = mem_realloc(*tab, *size, sizeof(struct civil_period));
+	}
+	(*tab)[(*count)++] = *p;
+}
+
+/*
+ * Collect the periods of the time interval [from, to) into a new table.
+ * Returns the number of periods, or 0 if the C library failed.
+ */
+static unsigned civil_scan(long from, long to, struct civil_period **tab)
+{
+	struct civil_period cur, p;
+	unsigned count = 0, size = 0;
+	long lo, hi, mid, t;
+
+	*tab = NULL;
+	if (!civil_probe(from, &cur))
+		return 0;
+	civil_push(tab, &count, &size, &cur);
+
+	lo = from;
+	while (lo < to - 1) {
+		t = lo + CIVIL_STRIDE < to - 1 ? lo + CIVIL_STRIDE : to - 1;
+		if (!civil_probe(t, &p))
+			goto fail;
+		if (civil_same(&cur, &p)) {
+			lo = t;
+			continue;
+		}
+
+		/* Find the first second that belongs to the new period. */
+		hi = t;
+		while (hi - lo > 1) {
+			mid = lo + (hi - lo) / 2;
+			if (!civil_probe(mid, &p))
+				goto fail;
+			if (civil_same(&cur, &p))
+				lo = mid;
+			else
+				hi = mid;
+		}
+		if (!civil_probe(hi, &cur))
+			goto fail;
+		civil_push(tab, &count, &size, &cur);
+		lo = hi;
+	}
+
+	return count;
+
+fail:
+	mem_free(*tab);
+	*tab = NULL;
+	return 0;
+}
+
+/* Extend the table to cover [from, to). Must be called with the write lock. */
+static int civil_extend(long from, long to)
+{
+	struct civil_period *tab;
+	unsigned count, n, i;
+	long start, end;
+
+	if (civil_count == 0) {
+		start = floor_div(from, CIVIL_BLOCK) * CIVIL_BLOCK;
+		count = civil_scan(start, start + CIVIL_BLOCK, &tab);
+		if (count == 0)
+			return 0;
+		civil_tab = tab;
+		civil_count = civil_size = count;
+		civil_from = start;
+		civil_to = start + CIVIL_BLOCK;
+	}
+
+	while (civil_from > from) {
+		start = civil_from - CIVIL_BLOCK;
+		count = civil_scan(start, civil_from, &tab);
+		if (count == 0)
+			return 0;
+
+		/* The last new period may continue into the window. */
+		n = civil_same(&tab[count - 1], &civil_tab[0]) ? 1 : 0;
+		if (civil_count - n + count > civil_size) {
+			civil_size = civil_count - n + count;
+			civil_tab = mem_realloc(civil_tab, civil_size,
+						sizeof(struct civil_period));
+		}
+		memmove(civil_tab + count, civil_tab + n,
+			(civil_count - n) * sizeof(struct civil_period));
+		memcpy(civil_tab, tab, count * sizeof(struct civil_period));
+		civil_count = civil_count - n + count;
+		civil_from = start;
+		mem_free(tab);
+	}
+
+	while (civil_to < to) {
+		end = civil_to + CIVIL_BLOCK;
+		count = civil_scan(civil_to, end, &tab);
+		if (count == 0)
+			return 0;
+
+		n = civil_same(&tab[0], &civil_tab[civil_count - 1]) ? 1 : 0;
+		for (i = n; i < count; i++)
+			civil_push(&civil_tab, &civil_count, &civil_size,
+				   &tab[i]);
+		civil_to = end;
+		mem_free(tab);
+	}
+
+	return 1;
+}
+
+/*
+ * Make sure the table covers [from, to). On success, returns with the read
+ * lock held.
+ */
+static int civil_lock_range(long from, long to)
+{
+	int ret;
+
+	if (from < CIVIL_MIN || to > CIVIL_MAX)
+		return 0;
+
+	pthread_rwlock_rdlock(&civil_lock);
+	if (civil_count > 0 && from >= civil_from && to <= civil_to)
+		return 1;
+	pthread_rwlock_unlock(&civil_lock);
+
+	pthread_rwlock_wrlock(&civil_lock);
+	ret = civil_extend(from, to);
+	pthread_rwlock_unlock(&civil_lock);
+	if (!ret)
+		return 0;
+
+	pthread_rwlock_rdlock(&civil_lock);
+	return 1;
+}
+
+/* Index of the period a time belongs to. Must be called with the lock held. */
+static unsigned civil_find(long t)
+{
+	unsigned lo = 0, hi = civil_count, mid;
+
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (civil_tab[mid].start <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Fill a broken-down time from a local time expressed in seconds. */
+static void civil_fill(long local, int isdst, struct tm *lt)
+{
+	long day = floor_div(local, DAYINSEC), sec = local - day * DAYINSEC;
+	int y, m, d;
+
+	civil_date(day, &y, &m, &d);
+	lt->tm_year = y - 1900;
+	lt->tm_mon = m - 1;
+	lt->tm_mday = d;
+	lt->tm_hour = sec / HOURINSEC;
+	lt->tm_min = sec / MININSEC % HOURINMIN;
+	lt->tm_sec = sec % MININSEC;
+	/* 1 jan 1970 was a Thursday. */
+	lt->tm_wday = day + 4 - floor_div(day + 4, WEEKINDAYS) * WEEKINDAYS;
+	lt->tm_yday = day - civil_days(y, 1, 1);
+	lt->tm_isdst = isdst;
+}
+
+/* Replacement for localtime_r(). */
+void civil_localtime(long t, struct tm *lt)
+{
+	struct civil_period *p;
+	time_t tt;
+
+	if (!civil_lock_range(t, t + 1)) {
+		tt = t;
+		localtime_r(&tt, lt);
+		return;
+	}
+	p = &civil_tab[civil_find(t)];
+	civil_fill(t + p->off, p->isdst, lt);
+	pthread_rwlock_unlock(&civil_lock);
+}
+
+/* Number of the local day a time belongs to. */
+long civil_day(long t)
+{
+	struct civil_period *p;
+	struct tm lt;
+	time_t tt;
+	long day;
+
+	if (!civil_lock_range(t, t + 1)) {
+		tt = t;
+		localtime_r(&tt, &lt);
+		return civil_days(lt.tm_year + 1900, lt.tm_mon + 1,
+				  lt.tm_mday);
+	}
+	p = &civil_tab[civil_find(t)];
+	day = floor_div(t + p->off, DAYINSEC);
+	pthread_rwlock_unlock(&civil_lock);
+
+	return day;
+}
+
+/*
+ * Find the offset to use for a local time. Returns 0 if the local time falls
+ * into a transition, where it does not exist or is ambiguous, or if it does not
+ * have the requested DST flag. Must be called with the lock held.
+ */
+static int civil_resolve(long local, int isdst, long *off)
+{
+	unsigned i, lo, hi, found = 0, n = 0;
+	long t, end;
+
+	i = civil_find(local - civil_tab[civil_find(local)].off);
+	lo = i > 1 ? i - 2 : 0;
+	hi = i + 2 < civil_count ? i + 2 : civil_count - 1;
+	for (; lo <= hi; lo++) {
+		t = local - civil_tab[lo].off;
+		end = lo + 1 < civil_count ? civil_tab[lo + 1].start : civil_to;
+		if (t >= civil_tab[lo].start && t < end) {
+			found = lo;
+			n++;
+		}
+	}
+
+	if (n != 1 || (isdst >= 0 && civil_tab[found].isdst != isdst))
+		return 0;
+	*off = civil_tab[found].off;
+
+	return 1;
+}
+
+/*
+ * Replacement for mktime(). Out-of-range fields are normalized and the
+ * broken-down time is updated to match the returned time. Local times that do
+ * not exist, are ambiguous or do not match the requested DST flag are left to
+ * mktime() itself, since the C library resolves them in its own way.
+ */
+long civil_mktime(struct tm *lt)
+{
+	long months, local, off, t;
+	int isdst;
+
+	months = lt->tm_year + 1900L;
+	months = months * YEARINMONTHS + lt->tm_mon;
+	local = civil_days(floor_div(months, YEARINMONTHS),
+			   months - floor_div(months, YEARINMONTHS) *
+			   YEARINMONTHS + 1, 1) + lt->tm_mday - 1;
+	local = local * DAYINSEC + lt->tm_hour * (long)HOURINSEC +
+		lt->tm_min * (long)MININSEC + lt->tm_sec;
+	isdst = lt->tm_isdst < 0 ? -1 : lt->tm_isdst > 0;
+
+	if (!civil_lock_range(local - DAYINSEC, local + DAYINSEC))
+		return mktime(lt);
+	if (!civil_resolve(local, isdst, &off)) {
+		pthread_rwlock_unlock(&civil_lock);
+		return mktime(lt);
+	}
+	t = local - off;
+	isdst = civil_tab[civil_find(t)].isdst;
+	pthread_rwlock_unlock(&civil_lock);
+
+	civil_fill(local, isdst, lt);
+
+	return t;
+}
+
+/* Drop the table, e.g. after the time zone was changed. */
+void civil_free(void)
+{
+	pthread_rwlock_wrlock(&civil_lock);
+	if (civil_tab)
+		mem_free(civil_tab);
+	civil_tab = NULL;
+	civil_count = civil_size = 0;
+	pthread_rwlock_unlock(&civil_lock);
+}
@@ -107,6 +107,7 @@ static const struct confvar confmap[] = {
 	{"format.outputdate", config_parse_output_datefmt, config_serialize_output_datefmt, NULL},
 	{"format.dayheading", CONFIG_HANDLER_STR(conf.day_heading)},
 	{"general.autogc", CONFIG_HANDLER_BOOL(conf.auto_gc)},
+	{"general.autoreload", CONFIG_HANDLER_BOOL(conf.auto_reload)},
 	{"general.autosave", CONFIG_HANDLER_BOOL(conf.auto_save)},
 	{"general.confirmdelete", CONFIG_HANDLER_BOOL(conf.confirm_delete)},
 	{"general.confirmquit", CONFIG_HANDLER_BOOL(conf.confirm_quit)},
@@ -114,6 +115,7 @@ static const struct confvar confmap[] = {
 	{"general.periodicsave", CONFIG_HANDLER_UNSIGNED(conf.periodic_save)},
 	{"general.progressbar", CONFIG_HANDLER_BOOL(conf.progress_bar)},
 	{"general.systemdialogs", CONFIG_HANDLER_BOOL(conf.system_dialogs)},
+	{"general.trustfilestat", CONFIG_HANDLER_BOOL(conf.trust_file_stat)},
 	{"notification.command", CONFIG_HANDLER_STR(nbar.cmd)},
 	{"notification.notifyall", config_parse_notifyall, config_serialize_notifyall, NULL},
 	{"notification.warning", CONFIG_HANDLER_INT(nbar.cntdwn)}
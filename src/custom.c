@@ -528,7 +528,9 @@ enum {
 	DEFAULT_PANEL,
 	AUTO_SAVE,
 	AUTO_GC,
+	AUTO_RELOAD,
 	PERIODIC_SAVE,
+	TRUST_FILE_STAT,
 	CONFIRM_QUIT,
 	CONFIRM_DELETE,
 	SYSTEM_DIAGS,
@@ -550,7 +552,9 @@ static void print_general_option(int i, WINDOW *win, int y, int hilt, void *cb_d
 		"appearance.defaultpanel = ",
 		"general.autosave = ",
 		"general.autogc = ",
+		"general.autoreload = ",
 		"general.periodicsave = ",
+		"general.trustfilestat = ",
 		"general.confirmquit = ",
 		"general.confirmdelete = ",
 		"general.systemdialogs = ",
@@ -600,6 +604,13 @@ static void print_general_option(int i, WINDOW *win, int y, int hilt, void *cb_d
 		mvwaddstr(win, y + 1, XPOS,
 			  _("(run the garbage collector when quitting)"));
 		break;
+	case AUTO_RELOAD:
+		print_bool_option_incolor(win, conf.auto_reload, y,
+					  XPOS + strlen(opt[AUTO_RELOAD]));
+		mvwaddstr(win, y + 1, XPOS,
+			  _("(reload data files when they are changed by "
+			    "another program)"));
+		break;
 	case PERIODIC_SAVE:
 		custom_apply_attr(win, ATTR_HIGHEST);
 		mvwprintw(win, y, XPOS + strlen(opt[PERIODIC_SAVE]), "%d",
@@ -609,6 +620,13 @@ static void print_general_option(int i, WINDOW *win, int y, int hilt, void *cb_d
 			  _("(if not null, automatically save data every 'periodic_save' "
 			   "minutes)"));
 		break;
+	case TRUST_FILE_STAT:
+		print_bool_option_incolor(win, conf.trust_file_stat, y,
+					  XPOS + strlen(opt[TRUST_FILE_STAT]));
+		mvwaddstr(win, y + 1, XPOS,
+			  _("(if set to YES, data files are only checked for "
+			    "changes by their size and modification time)"));
+		break;
 	case CONFIRM_QUIT:
 		print_bool_option_incolor(win, conf.confirm_quit, y,
 					  XPOS + strlen(opt[CONFIRM_QUIT]));
@@ -740,6 +758,12 @@ static void general_option_edit(int i)
 	case AUTO_GC:
 		conf.auto_gc = !conf.auto_gc;
 		break;
+	case AUTO_RELOAD:
+		conf.auto_reload = !conf.auto_reload;
+		io_stop_watch_thread();
+		if (conf.auto_reload)
+			io_start_watch_thread();
+		break;
 	case PERIODIC_SAVE:
 		status_mesg(periodic_save_str, "");
 		if (updatestring(win[STA].p, &buf, 0, 1) == 0) {
@@ -752,6 +776,9 @@ static void general_option_edit(int i)
 			}
 		}
 		break;
+	case TRUST_FILE_STAT:
+		conf.trust_file_stat = !conf.trust_file_stat;
+		break;
 	case CONFIRM_QUIT:
 		conf.confirm_quit = !conf.confirm_quit;
 		break;
@@ -1104,6 +1131,7 @@ void custom_config_main(void)
 		switch (ch) {
 		case 'C':
 		case 'c':
+			io_set_modified(IO_MODIFIED_CONF);
 			if (has_colors()) {
 				custom_color_config();
 			} else {
@@ -1115,6 +1143,7 @@ void custom_config_main(void)
 			break;
 		case 'L':
 		case 'l':
+			io_set_modified(IO_MODIFIED_CONF);
 			old_layout = wins_layout();
 			custom_layout_config();
 			if (wins_layout() != old_layout)
@@ -1122,18 +1151,22 @@ void custom_config_main(void)
 			break;
 		case 'G':
 		case 'g':
+			io_set_modified(IO_MODIFIED_CONF);
 			custom_general_config();
 			break;
 		case 'N':
 		case 'n':
+			io_set_modified(IO_MODIFIED_CONF);
 			notify_config_bar();
 			break;
 		case 'K':
 		case 'k':
+			io_set_modified(IO_MODIFIED_KEYS);
 			custom_keys_config();
 			break;
 		case 's':
 		case 'S':
+			io_set_modified(IO_MODIFIED_CONF);
 			custom_sidebar_config();
 			break;
 		default:
@@ -42,28 +42,46 @@
 
 #include "calcurse.h"
 
-static vector_t day_items;
+/*
+ * Items of the selected day. They are stored by value, and the array keeps
+ * its capacity from one day to the next so that switching days does not
+ * allocate anything.
+ */
+static struct day_item *day_items;
+static unsigned day_items_count = 0;
+static unsigned day_items_size = 0;
 static unsigned day_items_nb = 0;
 
-static void day_free(struct day_item *day)
-{
-	mem_free(day);
-}
+/*
+ * Date the items were stored for, whether the captions are included and how
+ * many of the items are events, so that single items can be added to or
+ * removed from the selected day without storing all of its items again.
+ */
+static long day_items_date;
+static int day_items_stored = 0;
+static int day_items_captions;
+static unsigned day_items_events;
 
-static void day_init_vector(void)
+/* Empty the current day array, keeping its capacity. */
+static void day_reset_items(void)
 {
-	VECTOR_INIT(&day_items, 16);
+	day_items_count = 0;
+	day_items_stored = 0;
 }
 
 /*
- * Free the current day vector containing the events and appointments.
+ * Free the current day array containing the events and appointments.
  * Must not free associated message and note, because their are not dynamically
  * allocated (only pointers to real objects are stored in this structure).
  */
 void day_free_vector(void)
 {
-	VECTOR_FREE_INNER(&day_items, day_free);
-	VECTOR_FREE(&day_items);
+	if (day_items)
+		mem_free(day_items);
+	day_items = NULL;
+	day_items_count = day_items_size = 0;
+	day_items_nb = 0;
+	day_items_stored = 0;
 }
 
 static int day_cmp(struct day_item **pa, struct day_item **pb)
@@ -95,15 +113,41 @@ static int day_cmp(struct day_item **pa, struct day_item **pb)
 	return a->type - b->type;
 }
 
+static int day_item_cmp(const void *pa, const void *pb)
+{
+	struct day_item *a = (struct day_item *)pa;
+	struct day_item *b = (struct day_item *)pb;
+
+	return day_cmp(&a, &b);
+}
+
+/* Sort the items of the current day. */
+static void day_sort_items(void)
+{
+	if (day_items_count > 1)
+		qsort(day_items, day_items_count, sizeof(struct day_item),
+		      day_item_cmp);
+}
+
 /* Add an item to the current day list. */
 static void day_add_item(int type, long start, union aptev_ptr item)
 {
-	struct day_item *day = mem_malloc(sizeof(struct day_item));
+	struct day_item *day;
+
+	if (!day_items) {
+		day_items_size = 16;
+		day_items = mem_malloc(day_items_size *
+				       sizeof(struct day_item));
+	} else if (day_items_count == day_items_size) {
+		day_items_size *= 2;
+		day_items = mem_realloc(day_items, day_items_size,
+					sizeof(struct day_item));
+	}
+
+	day = &day_items[day_items_count++];
 	day->type = type;
 	day->start = start;
 	day->item = item;
-
-	VECTOR_ADD(&day_items, day);
 }
 
 /* Get the message of an item. */
@@ -258,19 +302,23 @@ static int day_store_events(long date)
  * dedicated to the selected day.
  * Returns the number of recurrent events for the selected day.
  */
+static int day_add_recur_event(struct recur_occ *occ, int *e_nb)
+{
+	if (occ->type != RECUR_EVNT)
+		return 0;
+
+	day_add_item(RECUR_EVNT, occ->item.rev->day, occ->item);
+	(*e_nb)++;
+
+	return 0;
+}
+
 static int day_store_recur_events(long date)
 {
-	llist_item_t *i;
-	union aptev_ptr p;
 	int e_nb = 0;
 
-	LLIST_FIND_FOREACH(&recur_elist, &date, recur_event_inday, i) {
-		struct recur_event *rev = LLIST_TS_GET_DATA(i);
-
-		p.rev = rev;
-		day_add_item(RECUR_EVNT, rev->day, p);
-		e_nb++;
-	}
+	recur_foreach_occurrence(date, (recur_fn_visit_t)day_add_recur_event,
+				 &e_nb);
 
 	return e_nb;
 }
@@ -282,25 +330,25 @@ static int day_store_recur_events(long date)
  * structure dedicated to the selected day.
  * Returns the number of appointments for the selected day.
  */
-static int day_store_apoints(long date)
+static int day_add_apoint(struct apoint *apt, int *a_nb)
 {
-	llist_item_t *i;
 	union aptev_ptr p;
-	int a_nb = 0;
 
-	LLIST_TS_LOCK(&alist_p);
-	LLIST_TS_FIND_FOREACH(&alist_p, &date, apoint_inday, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
+	p.apt = apt;
+	day_add_item(APPT, apt->start, p);
+	(*a_nb)++;
 
-		p.apt = apt;
+	return 0;
+}
 
-		if (apt->start >= date + DAYINSEC)
-			break;
+static int day_store_apoints(long date)
+{
+	long from, to;
+	int a_nb = 0;
 
-		day_add_item(APPT, apt->start, p);
-		a_nb++;
-	}
-	LLIST_TS_UNLOCK(&alist_p);
+	date_day_bounds(date, &from, &to);
+	apoint_foreach_overlap(from, to, (apoint_fn_visit_t)day_add_apoint,
+			       &a_nb);
 
 	return a_nb;
 }
@@ -312,25 +360,23 @@ static int day_store_apoints(long date)
  * structure dedicated to the selected day.
  * Returns the number of recurrent appointments for the selected day.
  */
-static int day_store_recur_apoints(long date)
+static int day_add_recur_apoint(struct recur_occ *occ, int *a_nb)
 {
-	llist_item_t *i;
-	union aptev_ptr p;
-	int a_nb = 0;
+	if (occ->type != RECUR_APPT)
+		return 0;
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FIND_FOREACH(&recur_alist_p, &date, recur_apoint_inday, i) {
-		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
+	day_add_item(RECUR_APPT, occ->start, occ->item);
+	(*a_nb)++;
 
-		p.rapt = rapt;
+	return 0;
+}
 
-		time_t real_start;
-		if (recur_apoint_find_occurrence(rapt, date, &real_start)) {
-			day_add_item(RECUR_APPT, real_start, p);
-			a_nb++;
-		}
-	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
+static int day_store_recur_apoints(long date)
+{
+	int a_nb = 0;
+
+	recur_foreach_occurrence(date, (recur_fn_visit_t)day_add_recur_apoint,
+				 &a_nb);
 
 	return a_nb;
 }
@@ -339,7 +385,7 @@ static int day_store_recur_apoints(long date)
  * Store all of the items to be displayed for the selected day.
  * Items are of four types: recursive events, normal events,
  * recursive appointments and normal appointments.
- * The items are stored in the linked list pointed by day_items
+ * The items are stored in the array pointed by day_items
  * and the length of the new pad to write is returned.
  * The number of events and appointments in the current day are also updated.
  */
@@ -349,8 +395,7 @@ day_store_items(long date, int include_captions)
 	unsigned apts, events;
 	union aptev_ptr p = { NULL };
 
-	day_free_vector();
-	day_init_vector();
+	day_reset_items();
 
 	if (include_captions)
 		day_add_item(DAY_HEADING, 0, p);
@@ -363,8 +408,373 @@ day_store_items(long date, int include_captions)
 	if (include_captions && events > 0 && apts > 0)
 		day_add_item(DAY_SEPARATOR, 0, p);
 
-	VECTOR_SORT(&day_items, day_cmp);
+	day_sort_items();
 	day_items_nb = events + apts;
+
+	day_items_date = date;
+	day_items_stored = 1;
+	day_items_captions = include_captions;
+	day_items_events = events;
+}
+
+/*
+ * Insert an item into the items of the selected day, after the items that
+ * compare equal to it so that the order of day_store_items() is preserved.
+ */
+static void day_insert_sorted(int type, long start, union aptev_ptr item)
+{
+	struct day_item day, *p, *pday = &day;
+	unsigned lo = 0, hi = day_items_count, mid;
+
+	day.type = type;
+	day.start = start;
+	day.item = item;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		p = &day_items[mid];
+		if (day_cmp(&p, &pday) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	day_add_item(type, start, item);
+	memmove(&day_items[lo + 1], &day_items[lo],
+		(day_items_count - 1 - lo) * sizeof(struct day_item));
+	day_items[lo] = day;
+
+	if (type == DAY_HEADING || type == DAY_SEPARATOR)
+		return;
+	if (type == EVNT || type == RECUR_EVNT)
+		day_items_events++;
+	day_items_nb++;
+}
+
+/*
+ * Add or remove the separator between events and appointments, depending on
+ * whether the selected day has both.
+ */
+static void day_update_separator(void)
+{
+	union aptev_ptr p = { NULL };
+	unsigned pos = 1 + day_items_events;
+	int has_separator, needs_separator;
+
+	if (!day_items_captions)
+		return;
+
+	has_separator = (day_items_count == day_items_nb + 2);
+	needs_separator = (day_items_events > 0 &&
+			   day_items_nb > day_items_events);
+
+	if (needs_separator && !has_separator) {
+		day_insert_sorted(DAY_SEPARATOR, 0, p);
+	} else if (!needs_separator && has_separator) {
+		day_items_count--;
+		memmove(&day_items[pos], &day_items[pos + 1],
+			(day_items_count - pos) * sizeof(struct day_item));
+	}
+}
+
+static int day_insert_recur(struct recur_occ *occ, union aptev_ptr *item)
+{
+	if (occ->item.rev != item->rev)
+		return 0;
+
+	if (occ->type == RECUR_EVNT)
+		day_insert_sorted(RECUR_EVNT, occ->item.rev->day, occ->item);
+	else
+		day_insert_sorted(RECUR_APPT, occ->start, occ->item);
+
+	return 0;
+}
+
+/*
+ * Add an item that was just added to the lists to the items of the selected
+ * day, if it occurs on that day.
+ */
+void day_insert_item(int type, union aptev_ptr item)
+{
+	long from, to;
+
+	if (!day_items_stored)
+		return;
+
+	switch (type) {
+	case EVNT:
+		if (event_inday(item.ev, &day_items_date))
+			day_insert_sorted(EVNT, item.ev->day, item);
+		break;
+	case APPT:
+		date_day_bounds(day_items_date, &from, &to);
+		if (apoint_overlap(item.apt, from, to))
+			day_insert_sorted(APPT, item.apt->start, item);
+		break;
+	case RECUR_EVNT:
+	case RECUR_APPT:
+		recur_foreach_occurrence(day_items_date,
+					 (recur_fn_visit_t)day_insert_recur,
+					 &item);
+		break;
+	default:
+		EXIT(_("unknown item type"));
+		/* NOTREACHED */
+	}
+
+	day_update_separator();
+}
+
+/* Remove an item from the items of the selected day. */
+void day_remove_item(union aptev_ptr item)
+{
+	unsigned i, j;
+
+	if (!day_items_stored)
+		return;
+
+	for (i = j = 0; i < day_items_count; i++) {
+		struct day_item *day = &day_items[i];
+
+		if (day->type == DAY_HEADING || day->type == DAY_SEPARATOR ||
+		    day->item.ev != item.ev) {
+			day_items[j++] = *day;
+			continue;
+		}
+
+		if (day->type == EVNT || day->type == RECUR_EVNT)
+			day_items_events--;
+		day_items_nb--;
+	}
+	day_items_count = j;
+
+	day_update_separator();
+}
+
+/*
+ * Move an item to its new place among the items of the selected day after it
+ * was modified.
+ */
+void day_update_item(int type, union aptev_ptr item)
+{
+	day_remove_item(item);
+	day_insert_item(type, item);
+}
+
+/*
+ * Items collected for a range of days. Each entry is keyed by the index of
+ * its day and the order in which day_store_items() adds the item types, so
+ * that a stable sort on the key reproduces the per-day item order.
+ */
+struct day_range {
+	long first;		/* day number of the first day */
+	long last;		/* day number of the last day */
+	unsigned count;
+	unsigned size;
+	struct day_range_entry {
+		unsigned key;
+		struct day_item item;
+	} *entry;
+};
+
+enum {
+	DAY_RANGE_RECUR_EVNT,
+	DAY_RANGE_EVNT,
+	DAY_RANGE_RECUR_APPT,
+	DAY_RANGE_APPT,
+	DAY_RANGE_KEYS
+};
+
+static void day_range_add(struct day_range *r, long day, int rank,
+			  int type, long start, union aptev_ptr item)
+{
+	struct day_range_entry *e;
+
+	if (!r->entry) {
+		r->size = 64;
+		r->entry = mem_malloc(r->size * sizeof(struct day_range_entry));
+	} else if (r->count >= r->size) {
+		r->size *= 2;
+		r->entry = mem_realloc(r->entry, r->size,
+				       sizeof(struct day_range_entry));
+	}
+
+	e = &r->entry[r->count++];
+	e->key = (day - r->first) * DAY_RANGE_KEYS + rank;
+	e->item.type = type;
+	e->item.start = start;
+	e->item.item = item;
+}
+
+static int day_range_add_recur(struct recur_occ *occ, struct day_range *r)
+{
+	if (occ->type == RECUR_EVNT)
+		day_range_add(r, occ->day, DAY_RANGE_RECUR_EVNT, RECUR_EVNT,
+			      occ->item.rev->day, occ->item);
+	else
+		day_range_add(r, occ->day, DAY_RANGE_RECUR_APPT, RECUR_APPT,
+			      occ->start, occ->item);
+
+	return 0;
+}
+
+static int day_range_add_apoint(struct apoint *apt, struct day_range *r)
+{
+	union aptev_ptr p;
+	long day, last;
+
+	p.apt = apt;
+	day = civil_day(apt->start);
+	last = civil_day(apt->start + (apt->dur > 0 ? apt->dur : 1) - 1);
+	if (day < r->first)
+		day = r->first;
+	if (last > r->last)
+		last = r->last;
+	for (; day <= last; day++)
+		day_range_add(r, day, DAY_RANGE_APPT, APPT, apt->start, p);
+
+	return 0;
+}
+
+/*
+ * Collect the items of each day in [from, to) into a snapshot. Days are taken
+ * in steps of one day starting at from, like day_store_items() would be called
+ * in a loop, and the items of each day are stored in display order. All items
+ * are collected with a single pass over the item lists. The snapshot only
+ * refers to the items, it stays valid as long as the item lists are unchanged.
+ */
+void day_range_collect(long from, long to, struct day_range_items *items)
+{
+	struct day_range r = { 0 };
+	unsigned *pos, size, i, j, k;
+	long start, end, last;
+	llist_item_t *it;
+
+	items->ndays = 0;
+	items->date = NULL;
+	items->end = NULL;
+	items->item = NULL;
+
+	size = 64;
+	items->date = mem_malloc(size * sizeof(long));
+	for (start = from; start < to; start = date_sec_change(start, 0, 1)) {
+		if (items->ndays >= size) {
+			size *= 2;
+			items->date = mem_realloc(items->date, size,
+						  sizeof(long));
+		}
+		items->date[items->ndays++] = start;
+	}
+	if (items->ndays == 0)
+		return;
+	items->end = mem_malloc(items->ndays * sizeof(unsigned));
+
+	r.first = civil_day(items->date[0]);
+	r.last = civil_day(items->date[items->ndays - 1]);
+	if (r.last - r.first != items->ndays - 1) {
+		/* Not a sequence of consecutive days, fall back. */
+		for (i = j = 0; i < items->ndays; i++) {
+			day_store_items(items->date[i], 0);
+			if (day_items_nb > 0) {
+				items->item = items->item ?
+					mem_realloc(items->item,
+						    j + day_items_nb,
+						    sizeof(struct day_item)) :
+					mem_malloc(day_items_nb *
+						   sizeof(struct day_item));
+			}
+			for (k = 0; k < day_items_count; k++)
+				items->item[j++] = day_items[k];
+			items->end[i] = j;
+		}
+		return;
+	}
+
+	recur_foreach_occurrence_range(items->date[0],
+				       items->date[items->ndays - 1] + 1,
+				       (recur_fn_visit_t)day_range_add_recur,
+				       &r);
+
+	LLIST_FOREACH(&eventlist, it) {
+		struct event *ev = LLIST_GET_DATA(it);
+		long day = civil_day(ev->day);
+		union aptev_ptr p;
+
+		if (day > r.last)
+			break;
+		if (day < r.first)
+			continue;
+		p.ev = ev;
+		day_range_add(&r, day, DAY_RANGE_EVNT, EVNT, ev->day, p);
+	}
+
+	date_day_bounds(items->date[0], &start, &end);
+	date_day_bounds(items->date[items->ndays - 1], &last, &end);
+	apoint_foreach_overlap(start, end,
+			       (apoint_fn_visit_t)day_range_add_apoint, &r);
+
+	/* Counting sort by key, keeping the order of equal keys. */
+	pos = mem_calloc(items->ndays * DAY_RANGE_KEYS + 1, sizeof(unsigned));
+	for (i = 0; i < r.count; i++)
+		pos[r.entry[i].key + 1]++;
+	for (i = 1; i <= items->ndays * DAY_RANGE_KEYS; i++)
+		pos[i] += pos[i - 1];
+	if (r.count > 0)
+		items->item = mem_malloc(r.count * sizeof(struct day_item));
+	for (i = 0; i < r.count; i++)
+		items->item[pos[r.entry[i].key]++] = r.entry[i].item;
+
+	/* pos[k] now holds the end of the entries with key k. */
+	for (i = j = 0; i < items->ndays; i++) {
+		items->end[i] = pos[(i + 1) * DAY_RANGE_KEYS - 1];
+		if (items->end[i] - j > 1)
+			qsort(items->item + j, items->end[i] - j,
+			      sizeof(struct day_item), day_item_cmp);
+		j = items->end[i];
+	}
+
+	mem_free(pos);
+	if (r.entry)
+		mem_free(r.entry);
+}
+
+/* Free a snapshot filled by day_range_collect(). */
+void day_range_free(struct day_range_items *items)
+{
+	if (items->date)
+		mem_free(items->date);
+	if (items->end)
+		mem_free(items->end);
+	if (items->item)
+		mem_free(items->item);
+}
+
+/*
+ * Store the items of each day in [from, to) in turn, and call fn_visit with
+ * the date of each day that has at least one item. Stops as soon as fn_visit
+ * returns a non-zero value.
+ */
+void day_foreach_range(long from, long to, day_fn_visit_t fn_visit,
+		       void *arg)
+{
+	struct day_range_items items;
+	unsigned i, j;
+
+	day_range_collect(from, to, &items);
+	for (i = j = 0; i < items.ndays; i++) {
+		if (j == items.end[i])
+			continue;
+
+		day_reset_items();
+		for (; j < items.end[i]; j++)
+			day_add_item(items.item[j].type, items.item[j].start,
+				     items.item[j].item);
+		day_items_nb = day_items_count;
+
+		if (fn_visit(items.date[i], arg))
+			break;
+	}
+	day_range_free(&items);
 }
 
 /*
@@ -447,35 +857,42 @@ day_display_item(struct day_item *day, WINDOW *win, int incolor, int width,
 		custom_remove_attr(win, ATTR_HIGHEST);
 }
 
+/* Write an item of the given day to a stream. */
+void day_item_write(FILE *out, struct day_item *day, long date,
+		    const char *fmt_apt, const char *fmt_rapt,
+		    const char *fmt_ev, const char *fmt_rev)
+{
+	switch (day->type) {
+	case APPT:
+		print_apoint(out, fmt_apt, date, day->item.apt);
+		break;
+	case EVNT:
+		print_event(out, fmt_ev, date, day->item.ev);
+		break;
+	case RECUR_APPT:
+		print_recur_apoint(out, fmt_rapt, date, day->start,
+				   day->item.rapt);
+		break;
+	case RECUR_EVNT:
+		print_recur_event(out, fmt_rev, date, day->item.rev);
+		break;
+	default:
+		EXIT(_("unknown item type"));
+		/* NOTREACHED */
+	}
+}
+
 /* Write the appointments and events for the selected day to stdout. */
 void day_write_stdout(long date, const char *fmt_apt, const char *fmt_rapt,
 		      const char *fmt_ev, const char *fmt_rev, int *limit)
 {
-	int i;
+	unsigned i;
 
-	VECTOR_FOREACH(&day_items, i) {
+	for (i = 0; i < day_items_count; i++) {
 		if (*limit == 0)
 			break;
-		struct day_item *day = VECTOR_NTH(&day_items, i);
-
-		switch (day->type) {
-		case APPT:
-			print_apoint(fmt_apt, date, day->item.apt);
-			break;
-		case EVNT:
-			print_event(fmt_ev, date, day->item.ev);
-			break;
-		case RECUR_APPT:
-			print_recur_apoint(fmt_rapt, date, day->start,
-					   day->item.rapt);
-			break;
-		case RECUR_EVNT:
-			print_recur_event(fmt_rev, date, day->item.rev);
-			break;
-		default:
-			EXIT(_("unknown item type"));
-			/* NOTREACHED */
-		}
+		day_item_write(stdout, &day_items[i], date,
+			       fmt_apt, fmt_rapt, fmt_ev, fmt_rev);
 		(*limit)--;
 	}
 }
@@ -512,34 +929,108 @@ void day_popup_item(struct day_item *day)
  * Returns 1 if the selected day does not contain a regular event or
  * appointment but an occurrence of a recurrent item. Returns 0 otherwise.
  */
+static int day_found_apoint(struct apoint *apt, void *arg)
+{
+	return 1;
+}
+
+static int day_found_recur(struct recur_occ *occ, void *arg)
+{
+	return 1;
+}
+
 int day_check_if_item(struct date day)
 {
 	const time_t t = date2sec(day, 0, 0);
+	long from, to;
 
 	if (LLIST_FIND_FIRST(&eventlist, (time_t *)&t, event_inday))
 		return 2;
 
-	LLIST_TS_LOCK(&alist_p);
-	if (LLIST_TS_FIND_FIRST(&alist_p, (time_t *)&t, apoint_inday)) {
-		LLIST_TS_UNLOCK(&alist_p);
+	date_day_bounds(t, &from, &to);
+	if (apoint_foreach_overlap(from, to, day_found_apoint, NULL))
 		return 2;
-	}
-	LLIST_TS_UNLOCK(&alist_p);
 
-	if (LLIST_FIND_FIRST(&recur_elist, (time_t *)&t, recur_event_inday))
+	if (recur_foreach_occurrence(t, day_found_recur, NULL))
 		return 1;
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	if (LLIST_TS_FIND_FIRST(&recur_alist_p, (time_t *)&t,
-				recur_apoint_inday)) {
-		LLIST_TS_UNLOCK(&recur_alist_p);
-		return 1;
-	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
+	return 0;
+}
+
+/*
+ * Occupancy of a range of consecutive days, as computed by day_check_if_item()
+ * for each day.
+ */
+struct day_check {
+	long first;		/* day number of the first day */
+	long last;		/* day number of the last day */
+	unsigned char *occ;
+};
+
+static int day_check_recur(struct recur_occ *occ, struct day_check *c)
+{
+	if (occ->day >= c->first && occ->day <= c->last &&
+	    !c->occ[occ->day - c->first])
+		c->occ[occ->day - c->first] = 1;
 
 	return 0;
 }
 
+static int day_check_apoint(struct apoint *apt, struct day_check *c)
+{
+	long day, last;
+
+	day = civil_day(apt->start);
+	last = civil_day(apt->start + (apt->dur > 0 ? apt->dur : 1) - 1);
+	if (day < c->first)
+		day = c->first;
+	if (last > c->last)
+		last = c->last;
+	for (; day <= last; day++)
+		c->occ[day - c->first] = 2;
+
+	return 0;
+}
+
+/*
+ * Store in occ what day_check_if_item() returns for each of the ndays days
+ * starting with the day containing the given date, with a single pass over the
+ * item lists.
+ */
+void day_check_range(long date, unsigned ndays, unsigned char *occ)
+{
+	struct day_check c;
+	long from, to, last;
+	llist_item_t *i;
+
+	if (ndays == 0)
+		return;
+
+	memset(occ, 0, ndays);
+	c.first = civil_day(date);
+	c.last = c.first + ndays - 1;
+	c.occ = occ;
+
+	date_day_bounds(date, &from, &to);
+	date_day_bounds(date_sec_change(date, 0, ndays - 1), &last, &to);
+
+	recur_foreach_occurrence_range(from, to,
+				       (recur_fn_visit_t)day_check_recur, &c);
+
+	LLIST_FOREACH(&eventlist, i) {
+		struct event *ev = LLIST_GET_DATA(i);
+		long day = civil_day(ev->day);
+
+		if (day > c.last)
+			break;
+		if (day >= c.first)
+			occ[day - c.first] = 2;
+	}
+
+	apoint_foreach_overlap(from, to, (apoint_fn_visit_t)day_check_apoint,
+			       &c);
+}
+
 static unsigned fill_slices(int *slices, int slicesno, int first, int last)
 {
 	int i;
@@ -556,86 +1047,111 @@ static unsigned fill_slices(int *slices, int slicesno, int first, int last)
 	return 1;
 }
 
-/*
- * Fill in the 'slices' vector given as an argument with 1 if there is an
- * appointment in the corresponding time slice, 0 otherwise.
- * A 24 hours day is divided into 'slicesno' number of time slices.
- */
-unsigned day_chk_busy_slices(struct date day, int slicesno, int *slices)
+struct busy_slices {
+	long first;		/* day number of the first day */
+	int ndays;
+	long *bound;		/* first second of each day and the next one */
+	int slicesno;
+	int *slices;
+	unsigned *valid;
+};
+
+static void day_fill_slices(struct busy_slices *bs, long day,
+			    long item_start, long item_dur)
 {
-	const time_t t = date2sec(day, 0, 0);
-	llist_item_t *i;
-	int slicelen;
+	int k = day - bs->first;
+	int slicelen = DAYINSEC / bs->slicesno;
+	long start = get_item_time(item_start);
+	long end = get_item_time(item_start + item_dur);
 
-	slicelen = DAYINSEC / slicesno;
+	if (!bs->valid[k])
+		return;
 
-#define  SLICENUM(tsec)  ((tsec) / slicelen % slicesno)
+	if (item_start < bs->bound[k])
+		start = 0;
+	if (item_start + item_dur >= bs->bound[k + 1])
+		end = DAYINSEC - 1;
+
+	/*
+	 * If an item ends on 12:00, we do not want the 12:00 slot to
+	 * be marked busy.
+	 */
+	if (end > start)
+		end--;
+
+	if (!fill_slices(bs->slices + k * bs->slicesno, bs->slicesno,
+			 start / slicelen % bs->slicesno,
+			 end / slicelen % bs->slicesno))
+		bs->valid[k] = 0;
+}
 
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FIND_FOREACH(&recur_alist_p, (time_t *)&t,
-			      recur_apoint_inday, i) {
-		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
-		time_t occurrence;
-		long start, end;
+static int day_fill_apoint_slices(struct apoint *apt, struct busy_slices *bs)
+{
+	long day, last;
 
-		if (!recur_apoint_find_occurrence(rapt, t, &occurrence))
-			continue;
+	day = civil_day(apt->start);
+	last = civil_day(apt->start + (apt->dur > 0 ? apt->dur : 1) - 1);
+	if (day < bs->first)
+		day = bs->first;
+	if (last > bs->first + bs->ndays - 1)
+		last = bs->first + bs->ndays - 1;
+	for (; day <= last; day++)
+		day_fill_slices(bs, day, apt->start, apt->dur);
 
-		if (occurrence >= t)
-			start = get_item_time(occurrence);
-		else
-			start = 0;
+	return 0;
+}
 
-		if (occurrence + rapt->dur < t + DAYINSEC)
-			end = get_item_time(occurrence + rapt->dur);
-		else
-			end = DAYINSEC - 1;
-
-		/*
-		 * If an item ends on 12:00, we do not want the 12:00 slot to
-		 * be marked busy.
-		 */
-		if (end > start)
-			end--;
-
-		if (!fill_slices(slices, slicesno, SLICENUM(start),
-					SLICENUM(end))) {
-			LLIST_TS_UNLOCK(&recur_alist_p);
-			return 0;
-		}
-	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
+static int day_fill_recur_slices(struct recur_occ *occ, struct busy_slices *bs)
+{
+	if (occ->type != RECUR_APPT)
+		return 0;
+	if (occ->day < bs->first || occ->day >= bs->first + bs->ndays)
+		return 0;
 
-	LLIST_TS_LOCK(&alist_p);
-	LLIST_TS_FIND_FOREACH(&alist_p, (time_t *)&t, apoint_inday, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
-		long start = get_item_time(apt->start);
-		long end = get_item_time(apt->start + apt->dur);
+	day_fill_slices(bs, occ->day, occ->start, occ->item.rapt->dur);
 
-		if (apt->start >= t + DAYINSEC)
-			break;
-		if (apt->start < t)
-			start = 0;
-		if (apt->start + apt->dur >= t + DAYINSEC)
-			end = DAYINSEC - 1;
-
-		/*
-		 * If an item ends on 12:00, we do not want the 12:00 slot to
-		 * be marked busy.
-		 */
-		if (end > start)
-			end--;
-
-		if (!fill_slices(slices, slicesno, SLICENUM(start),
-					SLICENUM(end))) {
-			LLIST_TS_UNLOCK(&alist_p);
-			return 0;
-		}
+	return 0;
+}
+
+/*
+ * Fill in the 'slices' vector given as an argument with 1 if there is an
+ * appointment in the corresponding time slice, 0 otherwise, for the 'ndays'
+ * days starting with the given one. A 24 hours day is divided into 'slicesno'
+ * number of time slices, the slices of the i-th day start at
+ * slices[i * slicesno] and valid[i] is set to 0 if they could not be computed.
+ * All days are filled in with a single pass over the appointment lists.
+ */
+void day_chk_busy_slices(struct date day, int ndays, int slicesno,
+			 int *slices, unsigned *valid)
+{
+	struct busy_slices bs;
+	long date;
+	int k;
+
+	if (ndays <= 0)
+		return;
+
+	bs.ndays = ndays;
+	bs.bound = mem_malloc((ndays + 1) * sizeof(long));
+	bs.slicesno = slicesno;
+	bs.slices = slices;
+	bs.valid = valid;
+
+	date = date2sec(day, 0, 0);
+	bs.first = civil_day(date);
+	for (k = 0; k < ndays; k++) {
+		date_day_bounds(date, &bs.bound[k], &bs.bound[k + 1]);
+		date = bs.bound[k + 1];
+		valid[k] = 1;
 	}
-	LLIST_TS_UNLOCK(&alist_p);
 
-#undef SLICENUM
-	return 1;
+	recur_foreach_occurrence_range(bs.bound[0], bs.bound[ndays],
+				       (recur_fn_visit_t)day_fill_recur_slices,
+				       &bs);
+	apoint_foreach_overlap(bs.bound[0], bs.bound[ndays],
+			       (apoint_fn_visit_t)day_fill_apoint_slices, &bs);
+
+	mem_free(bs.bound);
 }
 
 /* Cut an item so it can be pasted somewhere else later. */
@@ -696,12 +1212,11 @@ int day_paste_item(struct day_item *p, long date)
 /* Returns the position corresponding to a given item. */
 int day_get_position_by_aptev_ptr(union aptev_ptr aptevp)
 {
-	int n = 0;
+	unsigned n;
 
-	VECTOR_FOREACH(&day_items, n) {
-		struct day_item *p = VECTOR_NTH(&day_items, n);
+	for (n = 0; n < day_items_count; n++) {
 		/* Compare pointers. */
-		if (p->item.ev == aptevp.ev)
+		if (day_items[n].item.ev == aptevp.ev)
 			return n;
 	}
 
@@ -716,12 +1231,12 @@ int day_get_position(struct day_item *needle)
 /* Returns a structure containing the selected item. */
 struct day_item *day_get_item(int item_number)
 {
-	return VECTOR_NTH(&day_items, item_number);
+	return &day_items[item_number];
 }
 
 unsigned day_item_count(int include_captions)
 {
-	return (include_captions ? VECTOR_COUNT(&day_items) : day_items_nb);
+	return (include_captions ? day_items_count : day_items_nb);
 }
 
 /* Attach a note to an appointment or event. */
@@ -174,6 +174,10 @@ void dmon_start(int parent_exit_status)
 	io_load_app(NULL);
 	data_loaded = 1;
 
+	if (conf.auto_reload && !io_watch_init())
+		DMON_LOG(_("Could not watch the data files: %s\n"),
+			 strerror(errno));
+
 	DMON_LOG(_("started at %s\n"), nowstr());
 	for (;;) {
 		int left;
@@ -181,7 +185,6 @@ void dmon_start(int parent_exit_status)
 		if (want_reload) {
 			want_reload = 0;
 			io_reload_data();
-			notify_check_next_app(1);
 		}
 
 		if (!notify_get_next_bkgd())
@@ -200,7 +203,10 @@ void dmon_start(int parent_exit_status)
 				  "sleeping at %s for %d seconds\n",
 				  DMON_SLEEP_TIME), nowstr(),
 			 DMON_SLEEP_TIME);
-		psleep(DMON_SLEEP_TIME);
+		if (io_watch_wait(DMON_SLEEP_TIME)) {
+			DMON_LOG(_("data files changed at %s\n"), nowstr());
+			want_reload = 1;
+		}
 		DMON_LOG(_("awakened at %s\n"), nowstr());
 	}
 }
@@ -78,7 +78,7 @@ void event_llist_free(void)
 	LLIST_FREE(&eventlist);
 }
 
-static int event_cmp(struct event *a, struct event *b)
+int event_cmp(struct event *a, struct event *b)
 {
 	if (a->day < b->day)
 		return -1;
@@ -88,43 +88,96 @@ static int event_cmp(struct event *a, struct event *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-/* Create a new event */
-struct event *event_new(char *mesg, char *note, long day, int id)
+static struct event *event_alloc(char *mesg, char *note, long day, int id)
 {
 	struct event *ev;
 
-	ev = mem_malloc(sizeof(struct event));
-	ev->mesg = mem_strdup(mesg);
+	ev = mem_arena_malloc(sizeof(struct event));
+	ev->mesg = mem_arena_strdup(mesg);
 	ev->day = day;
 	ev->id = id;
-	ev->note = (note != NULL) ? mem_strdup(note) : NULL;
+	ev->note = (note != NULL) ? mem_arena_strdup(note) : NULL;
+
+	return ev;
+}
 
+/* Create a new event */
+struct event *event_new(char *mesg, char *note, long day, int id)
+{
+	struct event *ev;
+
+	ev = event_alloc(mesg, note, day, id);
 	LLIST_ADD_SORTED(&eventlist, ev, event_cmp);
 
 	return ev;
 }
 
+/*
+ * Add the events of a list filled in bulk mode, such as the ones returned by
+ * event_scan(), to the list of events. The list of events must be in bulk mode
+ * as well.
+ */
+void event_llist_splice(llist_t *batch)
+{
+	LLIST_BULK_SPLICE(&eventlist, batch);
+}
+
+/*
+ * Remove and free the events for which fn_match returns a non-zero value when
+ * passed their representation in the data files.
+ */
+void event_llist_drop(item_fn_match_t fn_match, void *arg)
+{
+	llist_item_t *i, *next;
+	struct event *ev;
+	char *str;
+	int match;
+
+	for (i = LLIST_FIRST(&eventlist); i; i = next) {
+		next = LLIST_NEXT(i);
+		ev = LLIST_GET_DATA(i);
+		str = event_tostr(ev);
+		match = fn_match(str, arg);
+		mem_free(str);
+		if (!match)
+			continue;
+		LLIST_REMOVE(&eventlist, i);
+		event_free(ev);
+	}
+}
+
 /* Check if the event belongs to the selected day */
 unsigned event_inday(struct event *i, long *start)
 {
 	return (date_cmp_day(i->day, *start) == 0);
 }
 
-char *event_tostr(struct event *o)
+/* Append an event in the format of the data file. */
+void event_catstr(struct string *s, struct event *o)
 {
-	struct string s;
 	struct tm lt;
 	time_t t;
 
-	string_init(&s);
-
 	t = o->day;
 	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u [%d] ", lt.tm_mon + 1, lt.tm_mday,
-		1900 + lt.tm_year, o->id);
-	if (o->note != NULL)
-		string_catf(&s, ">%s ", o->note);
-	string_catf(&s, "%s", o->mesg);
+	string_catdate(s, 1900 + lt.tm_year, lt.tm_mon + 1, lt.tm_mday);
+	string_cat(s, " [");
+	string_catint(s, o->id, 0);
+	string_cat(s, "] ");
+	if (o->note != NULL) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
+	string_cat(s, o->mesg);
+}
+
+char *event_tostr(struct event *o)
+{
+	struct string s;
+
+	string_init(&s);
+	event_catstr(&s, o);
 
 	return string_buf(&s);
 }
@@ -146,26 +199,27 @@ void event_write(struct event *o, FILE * f)
 	mem_free(str);
 }
 
-/* Load the events from file */
-struct event *event_scan(FILE * f, struct tm start, int id, char *note,
-			 struct item_filter *filter)
+/*
+ * Create an event read from the data file. The description is NULL if the end
+ * of the file was reached before it. The event is not added to the list of
+ * events. If the item is invalid, NULL is returned and *err is set to an error
+ * message.
+ */
+struct event *event_scan(char *buf, struct tm start, int id, char *note,
+			 struct item_filter *filter, const char **err)
 {
-	char buf[BUFSIZ], *nl;
 	time_t tstart, tend;
 	struct event *ev;
 
-	EXIT_IF(!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
-		!check_time(start.tm_hour, start.tm_min),
-		_("date error in event"));
+	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
+	    !check_time(start.tm_hour, start.tm_min)) {
+		*err = _("date error in event");
+		return NULL;
+	}
 
-	/* Read the event description */
-	if (!fgets(buf, sizeof buf, f))
+	if (!buf)
 		return NULL;
 
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
-	}
 	start.tm_hour = 0;
 	start.tm_min = 0;
 	start.tm_sec = 0;
@@ -174,7 +228,10 @@ struct event *event_scan(FILE * f, struct tm start, int id, char *note,
 	start.tm_mon--;
 
 	tstart = mktime(&start);
-	EXIT_IF(tstart == -1, _("date error in the event\n"));
+	if (tstart == -1) {
+		*err = _("date error in the event\n");
+		return NULL;
+	}
 	tend = tstart + DAYINSEC - 1;
 
 	/* Filter item. */
@@ -193,13 +250,13 @@ struct event *event_scan(FILE * f, struct tm start, int id, char *note,
 			return NULL;
 	}
 
-	ev = event_new(buf, note, tstart, id);
+	ev = event_alloc(buf, note, tstart, id);
 
 	/* Filter by hash. */
 	if (filter && filter->hash) {
 		char *hash = event_hash(ev);
 		if (!hash_matches(filter->hash, hash)) {
-			event_delete(ev);
+			event_free(ev);
 			ev = NULL;
 		}
 		mem_free(hash);
@@ -211,7 +268,7 @@ struct event *event_scan(FILE * f, struct tm start, int id, char *note,
 /* Delete an event from the list. */
 void event_delete(struct event *ev)
 {
-	llist_item_t *i = LLIST_FIND_FIRST(&eventlist, ev, NULL);
+	llist_item_t *i = LLIST_FIND_SORTED(&eventlist, ev, event_cmp);
 
 	if (!i)
 		EXIT(_("no such appointment"));
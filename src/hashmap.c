@@ -0,0 +1,220 @@
+/*
+ * Calcurse - text-based organizer
+ *
+ * Copyright (c) 2004-2017 calcurse Development Team <misc@calcurse.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer in the documentation and/or other
+ *        materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Send your feedback or comments to : misc@calcurse.org
+ * Calcurse home page : http://calcurse.org
+ *
+ */
+
+#include <string.h>
+
+#include "calcurse.h"
+
+/*
+ * Hash maps use open addressing with linear probing: an item lives in the
+ * first free slot at or after the one its hash points to. The number of slots
+ * is a power of two and is doubled when the map is three quarters full, which
+ * keeps probe sequences short and contiguous in memory.
+ */
+
+#define HASHMAP_MIN_SIZE 8
+
+/* FNV-1a hash of a string. */
+static unsigned hashmap_hash(const char *key)
+{
+	unsigned hash = 2166136261u;
+
+	for (; *key; key++) {
+		hash ^= (unsigned char)*key;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Get the distance of a slot from the one its hash points to.
+ */
+static unsigned hashmap_probe_len(hashmap_t *h, unsigned n)
+{
+	return (n - h->slot[n].hash) & (h->size - 1);
+}
+
+/*
+ * Find the slot of a key. Return the slot it would go into if the key is not
+ * in the hash map.
+ */
+static unsigned hashmap_find(hashmap_t *h, const char *key, unsigned hash)
+{
+	unsigned mask = h->size - 1;
+	unsigned n = hash & mask;
+
+	while (h->slot[n].data) {
+		if (h->slot[n].hash == hash &&
+		    !strcmp(h->fn_key(h->slot[n].data), key))
+			break;
+		n = (n + 1) & mask;
+	}
+
+	return n;
+}
+
+/*
+ * Change the number of slots of a hash map and reinsert its items.
+ */
+static void hashmap_resize(hashmap_t *h, unsigned size)
+{
+	struct hashmap_slot *old = h->slot;
+	unsigned old_size = h->size;
+	unsigned i, n;
+
+	h->size = size;
+	h->slot = mem_calloc(size, sizeof(struct hashmap_slot));
+
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].data)
+			continue;
+		n = old[i].hash & (size - 1);
+		while (h->slot[n].data)
+			n = (n + 1) & (size - 1);
+		h->slot[n] = old[i];
+	}
+
+	mem_free(old);
+}
+
+/*
+ * Initialize a hash map that is meant to hold about n items. The key of an
+ * item is the string returned by fn_key.
+ */
+void hashmap_init(hashmap_t *h, unsigned n, hashmap_fn_key_t fn_key)
+{
+	unsigned size = HASHMAP_MIN_SIZE;
+
+	while (size / 4 * 3 < n)
+		size *= 2;
+
+	h->count = 0;
+	h->size = size;
+	h->slot = mem_calloc(size, sizeof(struct hashmap_slot));
+	h->fn_key = fn_key;
+}
+
+/*
+ * Free a hash map, but not the contained data.
+ */
+void hashmap_free(hashmap_t *h)
+{
+	h->count = 0;
+	h->size = 0;
+	mem_free(h->slot);
+	h->slot = NULL;
+}
+
+/*
+ * Get the item with the given key, or NULL if there is none.
+ */
+void *hashmap_get(hashmap_t *h, const char *key)
+{
+	return h->slot[hashmap_find(h, key, hashmap_hash(key))].data;
+}
+
+/*
+ * Get the first item stored at or after slot *n and advance *n past it.
+ * Return NULL when there are no more items.
+ */
+void *hashmap_next(hashmap_t *h, unsigned *n)
+{
+	for (; *n < h->size; (*n)++) {
+		if (h->slot[*n].data)
+			return h->slot[(*n)++].data;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get the number of items in a hash map.
+ */
+unsigned hashmap_count(hashmap_t *h)
+{
+	return h->count;
+}
+
+/*
+ * Compute the load factor of a hash map and the number of slots a lookup of
+ * one of its items has to skip, on average and at worst.
+ */
+void hashmap_stats(hashmap_t *h, struct hashmap_stats *stats)
+{
+	unsigned long total = 0;
+	unsigned i, len;
+
+	stats->count = h->count;
+	stats->size = h->size;
+	stats->load = h->size ? (double)h->count / h->size : 0;
+	stats->probe_max = 0;
+
+	for (i = 0; i < h->size; i++) {
+		if (!h->slot[i].data)
+			continue;
+		len = hashmap_probe_len(h, i);
+		total += len;
+		if (len > stats->probe_max)
+			stats->probe_max = len;
+	}
+
+	stats->probe_avg = h->count ? (double)total / h->count : 0;
+}
+
+/*
+ * Add an item to a hash map. If an item with the same key is already stored,
+ * it is replaced and returned. Otherwise, NULL is returned.
+ */
+void *hashmap_add(hashmap_t *h, void *data)
+{
+	const char *key = h->fn_key(data);
+	unsigned hash = hashmap_hash(key);
+	unsigned n = hashmap_find(h, key, hash);
+	void *old = h->slot[n].data;
+
+	if (!old && (h->count + 1) * 4 > h->size * 3) {
+		hashmap_resize(h, h->size * 2);
+		n = hashmap_find(h, key, hash);
+	}
+
+	h->slot[n].hash = hash;
+	h->slot[n].data = data;
+	if (!old)
+		h->count++;
+
+	return old;
+}
@@ -0,0 +1,90 @@
+/*
+ * Calcurse - text-based organizer
+ *
+ * Copyright (c) 2004-2017 calcurse Development Team <misc@calcurse.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the
+ *        following disclaimer in the documentation and/or other
+ *        materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Send your feedback or comments to : misc@calcurse.org
+ * Calcurse home page : http://calcurse.org
+ *
+ */
+
+#include "calcurse.h"
+
+/*
+ * A slot of a hash map. The hash of the key is stored along with the data so
+ * that probing only looks at the key of an item when the hashes match.
+ */
+struct hashmap_slot {
+	unsigned hash;
+	void *data;
+};
+
+typedef struct hashmap hashmap_t;
+typedef const char *(*hashmap_fn_key_t) (void *);
+
+struct hashmap {
+	unsigned count;
+	unsigned size;
+	struct hashmap_slot *slot;
+	hashmap_fn_key_t fn_key;
+};
+
+struct hashmap_stats {
+	unsigned count;
+	unsigned size;
+	double load;
+	double probe_avg;
+	unsigned probe_max;
+};
+
+/* Initialization and deallocation. */
+void hashmap_init(hashmap_t *, unsigned, hashmap_fn_key_t);
+void hashmap_free(hashmap_t *);
+
+#define HASHMAP_INIT(h, n, fn_key) \
+	hashmap_init(h, n, (hashmap_fn_key_t)fn_key)
+#define HASHMAP_FREE(h) hashmap_free(h)
+
+/* Retrieving hash map items. */
+void *hashmap_get(hashmap_t *, const char *);
+void *hashmap_next(hashmap_t *, unsigned *);
+unsigned hashmap_count(hashmap_t *);
+void hashmap_stats(hashmap_t *, struct hashmap_stats *);
+
+#define HASHMAP_GET(h, key) hashmap_get(h, key)
+#define HASHMAP_COUNT(h) hashmap_count(h)
+#define HASHMAP_STATS(h, stats) hashmap_stats(h, stats)
+
+#define HASHMAP_FOREACH(h, i, data) \
+	for (i = 0; (data = hashmap_next(h, &i));)
+
+/* Hash map manipulation. */
+void *hashmap_add(hashmap_t *, void *);
+
+#define HASHMAP_ADD(h, data) hashmap_add(h, data)
@@ -100,7 +100,8 @@ static void ical_export_footer(FILE * stream)
 /* Export recurrent events. */
 static void ical_export_recur_events(FILE * stream, int export_uid)
 {
-	llist_item_t *i, *j;
+	llist_item_t *i;
+	unsigned j;
 	char ical_date[BUFSIZ];
 
 	LLIST_FOREACH(&recur_elist, i) {
@@ -119,14 +120,14 @@ static void ical_export_recur_events(FILE * stream, int export_uid)
 			fputc('\n', stream);
 		}
 
-		if (LLIST_FIRST(&rev->exc)) {
+		if (rev->exc.count > 0) {
 			fputs("EXDATE:", stream);
-			LLIST_FOREACH(&rev->exc, j) {
-				struct excp *exc = LLIST_GET_DATA(j);
-				date_sec2date_fmt(exc->st, ICALDATEFMT,
-						  ical_date);
+			for (j = 0; j < rev->exc.count; j++) {
+				date_sec2date_fmt(recur_exc_nth(&rev->exc, j),
+						  ICALDATEFMT, ical_date);
 				fprintf(stream, "%s", ical_date);
-				fputc(LLIST_NEXT(j) ? ',' : '\n', stream);
+				fputc(j + 1 < rev->exc.count ? ',' : '\n',
+				      stream);
 			}
 		}
 
@@ -168,7 +169,8 @@ static void ical_export_events(FILE * stream, int export_uid)
 /* Export recurrent appointments. */
 static void ical_export_recur_apoints(FILE * stream, int export_uid)
 {
-	llist_item_t *i, *j;
+	llist_item_t *i;
+	unsigned j;
 	char ical_datetime[BUFSIZ];
 	char ical_date[BUFSIZ];
 
@@ -198,14 +200,14 @@ static void ical_export_recur_apoints(FILE * stream, int export_uid)
 			fputc('\n', stream);
 		}
 
-		if (LLIST_FIRST(&rapt->exc)) {
+		if (rapt->exc.count > 0) {
 			fputs("EXDATE:", stream);
-			LLIST_FOREACH(&rapt->exc, j) {
-				struct excp *exc = LLIST_GET_DATA(j);
-				date_sec2date_fmt(exc->st, ICALDATEFMT,
-						  ical_date);
+			for (j = 0; j < rapt->exc.count; j++) {
+				date_sec2date_fmt(recur_exc_nth(&rapt->exc, j),
+						  ICALDATEFMT, ical_date);
 				fprintf(stream, "%s", ical_date);
-				fputc(LLIST_NEXT(j) ? ',' : '\n', stream);
+				fputc(j + 1 < rapt->exc.count ? ',' : '\n',
+				      stream);
 			}
 		}
 
@@ -329,14 +331,14 @@ static void ical_store_todo(int priority, int completed, char *mesg,
 {
 	struct todo *todo = todo_add(mesg, priority, completed, note);
 	if (fmt_todo)
-		print_todo(fmt_todo, todo);
+		print_todo(stdout, fmt_todo, todo);
 	mem_free(mesg);
 	erase_note(&note);
 }
 
 static void
 ical_store_event(char *mesg, char *note, long day, long end,
-		 ical_rpt_t * rpt, llist_t * exc, const char *fmt_ev,
+		 ical_rpt_t * rpt, struct exc_days *exc, const char *fmt_ev,
 		 const char *fmt_rev)
 {
 	const int EVENTID = 1;
@@ -348,14 +350,14 @@ ical_store_event(char *mesg, char *note, long day, long end,
 				      rpt->freq, rpt->until, exc);
 		mem_free(rpt);
 		if (fmt_rev)
-			print_recur_event(fmt_rev, day, rev);
+			print_recur_event(stdout, fmt_rev, day, rev);
 		goto cleanup;
 	}
 
 	if (end == 0 || end - day <= DAYINSEC) {
 		ev = event_new(mesg, note, day, EVENTID);
 		if (fmt_ev)
-			print_event(fmt_ev, day, ev);
+			print_event(stdout, fmt_ev, day, ev);
 		goto cleanup;
 	}
 
@@ -376,7 +378,7 @@ ical_store_event(char *mesg, char *note, long day, long end,
 			      rpt->freq, rpt->until, exc);
 	mem_free(rpt);
 	if (fmt_rev)
-		print_recur_event(fmt_rev, day, rev);
+		print_recur_event(stdout, fmt_rev, day, rev);
 
 cleanup:
 	mem_free(mesg);
@@ -385,7 +387,7 @@ cleanup:
 
 static void
 ical_store_apoint(char *mesg, char *note, long start, long dur,
-		  ical_rpt_t * rpt, llist_t * exc, int has_alarm,
+		  ical_rpt_t * rpt, struct exc_days *exc, int has_alarm,
 		  const char *fmt_apt, const char *fmt_rapt)
 {
 	char state = 0L;
@@ -399,11 +401,11 @@ ical_store_apoint(char *mesg, char *note, long start, long dur,
 					rpt->type, rpt->freq, rpt->until, exc);
 		mem_free(rpt);
 		if (fmt_rapt)
-			print_recur_apoint(fmt_rapt, start, rapt->start, rapt);
+			print_recur_apoint(stdout, fmt_rapt, start, rapt->start, rapt);
 	} else {
 		apt = apoint_new(mesg, note, start, dur, state);
 		if (fmt_apt)
-			print_apoint(fmt_apt, start, apt);
+			print_apoint(stdout, fmt_apt, start, apt);
 	}
 	mem_free(mesg);
 	erase_note(&note);
@@ -800,15 +802,12 @@ static ical_rpt_t *ical_read_rrule(FILE * log, char *rrulestr,
 	return rpt;
 }
 
-static void ical_add_exc(llist_t * exc_head, long date)
+static void ical_add_exc(struct exc_days *exc, long date)
 {
 	if (date == 0)
 		return;
 
-	struct excp *exc = mem_malloc(sizeof(struct excp));
-	exc->st = date;
-
-	LLIST_ADD(exc_head, exc);
+	recur_exc_add(exc, date);
 }
 
 /*
@@ -816,7 +815,7 @@ static void ical_add_exc(llist_t * exc_head, long date)
  * recurring calendar component.
  */
 static void
-ical_read_exdate(llist_t * exc, FILE * log, char *exstr,
+ical_read_exdate(struct exc_days *exc, FILE * log, char *exstr,
 		 unsigned *noskipped, const int itemline)
 {
 	char *p, *q;
@@ -902,7 +901,7 @@ ical_read_event(FILE * fdi, FILE * log, unsigned *noevents,
 	ical_vevent_e vevent_type;
 	char *p;
 	struct {
-		llist_t exc;
+		struct exc_days exc;
 		ical_rpt_t *rpt;
 		char *mesg, *note;
 		long start, end, dur;
@@ -912,7 +911,7 @@ ical_read_event(FILE * fdi, FILE * log, unsigned *noevents,
 
 	vevent_type = UNDEFINED;
 	memset(&vevent, 0, sizeof vevent);
-	LLIST_INIT(&vevent.exc);
+	recur_exc_init(&vevent.exc);
 	skip_alarm = 0;
 	while (ical_readline(fdi, buf, lstore, lineno)) {
 		if (skip_alarm) {
@@ -1044,7 +1043,7 @@ cleanup:
 		mem_free(vevent.mesg);
 	if (vevent.rpt)
 		mem_free(vevent.rpt);
-	LLIST_FREE(&vevent.exc);
+	recur_exc_free(&vevent.exc);
 	(*noskipped)++;
 }
 
@@ -34,9 +34,15 @@
  *
  */
 
+#ifndef _XOPEN_SOURCE
+/* Needed for realpath(). */
+#define _XOPEN_SOURCE 700
+#endif
+
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <signal.h>
@@ -44,10 +50,20 @@
 #include <math.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <poll.h>
 
 #include "calcurse.h"
 #include "sha1.h"
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 typedef enum {
 	PROGRESS_BAR_SAVE,
 	PROGRESS_BAR_LOAD,
@@ -67,26 +83,76 @@ enum {
 	PROGRESS_BAR_EXPORT_TODO
 };
 
-struct ht_keybindings_s {
+struct io_key_label {
 	const char *label;
 	enum key key;
-	 HTABLE_ENTRY(ht_keybindings_s);
 };
 
-static void load_keys_ht_getkey(struct ht_keybindings_s *, const char **,
-				int *);
-static int load_keys_ht_compare(struct ht_keybindings_s *,
-				struct ht_keybindings_s *);
-
-#define HSIZE 256
-HTABLE_HEAD(ht_keybindings, HSIZE, ht_keybindings_s);
-HTABLE_PROTOTYPE(ht_keybindings, ht_keybindings_s)
-    HTABLE_GENERATE(ht_keybindings, ht_keybindings_s, load_keys_ht_getkey,
-		load_keys_ht_compare)
+/*
+ * Identity of a data file when it was last read or written. As long as it
+ * does not change, the file is assumed to have the contents it had then.
+ */
+struct io_file_stat {
+	int valid;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+};
 
 static int modified = 0;
 static char apts_sha1[SHA1_DIGESTLEN * 2 + 1];
 static char todo_sha1[SHA1_DIGESTLEN * 2 + 1];
+static struct io_file_stat apts_stat;
+static struct io_file_stat todo_stat;
+
+/*
+ * Journals of the changes to the data files since they were last written in
+ * full. Periodic saves append to the journal of a data file instead of
+ * rewriting it, and the journal is replayed on top of the file when it is
+ * loaded. A journal starts with the SHA1 of the data file it applies to,
+ * followed by one line per change:
+ *
+ *   +<item>   an item was added, in the format of the data file
+ *   -<hash>   an item with the given hash was removed
+ *
+ * An edited item is removed and added again. Writing a data file in full,
+ * which explicit saves and saves on exit always do, removes its journal.
+ *
+ * A journal that does not match its data file is stale: the file was written
+ * by another program since, or calcurse stopped between writing the file and
+ * removing the journal. Its changes are applied all the same, except for the
+ * items the file already has, and the file is written in full on the next
+ * save.
+ */
+#define IO_JOURNAL_EXT ".journal"
+#define IO_JOURNAL_MAGIC "# calcurse journal "
+/* Write the data file in full once its journal reaches this share of it. */
+#define IO_JOURNAL_RATIO 4
+#define IO_JOURNAL_MIN 4096
+
+/*
+ * Hashes of the items of a data file as last written, sorted. The journal is
+ * pending if changes were appended to it since the file was written in full.
+ */
+struct io_journal {
+	int valid;
+	int pending;
+	int stale;
+	size_t n, size;
+	uint8_t (*hash)[SHA1_DIGESTLEN];
+	char *seen;
+};
+
+static struct io_journal apts_journal;
+static struct io_journal todo_journal;
+
+/*
+ * Callback for the items of a data file. The item was just appended to the
+ * string, starting at the given offset.
+ */
+typedef void (*io_item_fn_t) (struct string *, int, void *);
+typedef void (*io_foreach_fn_t) (struct string *, io_item_fn_t, void *);
 
 /* Draw a progress bar while saving, loading or exporting data. */
 static void progress_bar(progress_bar_t type, int progress)
@@ -317,123 +383,448 @@ void io_dump_apts(const char *fmt_apt, const char *fmt_rapt,
 	LLIST_FOREACH(&recur_elist, i) {
 		struct recur_event *rev = LLIST_GET_DATA(i);
 		time_t day = update_time_in_date(rev->day, 0, 0);
-		print_recur_event(fmt_rev, day, rev);
+		print_recur_event(stdout, fmt_rev, day, rev);
 	}
 
 	LLIST_TS_FOREACH(&recur_alist_p, i) {
 		struct recur_apoint *rapt = LLIST_GET_DATA(i);
 		time_t day = update_time_in_date(rapt->start, 0, 0);
-		print_recur_apoint(fmt_rapt, day, rapt->start, rapt);
+		print_recur_apoint(stdout, fmt_rapt, day, rapt->start, rapt);
 	}
 
 	LLIST_TS_FOREACH(&alist_p, i) {
 		struct apoint *apt = LLIST_TS_GET_DATA(i);
 		time_t day = update_time_in_date(apt->start, 0, 0);
-		print_apoint(fmt_apt, day, apt);
+		print_apoint(stdout, fmt_apt, day, apt);
 	}
 
 	LLIST_FOREACH(&eventlist, i) {
 		struct event *ev = LLIST_TS_GET_DATA(i);
 		time_t day = update_time_in_date(ev->day, 0, 0);
-		print_event(fmt_ev, day, ev);
+		print_event(stdout, fmt_ev, day, ev);
+	}
+}
+
+static void io_item_hash(const char *str, size_t len,
+			 uint8_t hash[SHA1_DIGESTLEN])
+{
+	sha1_ctx_t ctx;
+
+	sha1_init(&ctx);
+	sha1_update_buffer(&ctx, str, len);
+	sha1_final(&ctx, hash);
+}
+
+static int io_journal_hash_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, SHA1_DIGESTLEN);
+}
+
+static void io_journal_add(struct io_journal *j, const uint8_t *hash)
+{
+	if (j->n == j->size) {
+		j->size = j->size > 0 ? j->size * 2 : 1024;
+		j->hash = mem_realloc(j->hash, j->size, SHA1_DIGESTLEN);
 	}
+	memcpy(j->hash[j->n++], hash, SHA1_DIGESTLEN);
+}
+
+/* Sort the hashes once they are all added, and mark them all as unseen. */
+static void io_journal_sort(struct io_journal *j)
+{
+	qsort(j->hash, j->n, SHA1_DIGESTLEN, io_journal_hash_cmp);
+	if (j->seen)
+		mem_free(j->seen);
+	j->seen = mem_malloc(j->n > 0 ? j->n : 1);
+	memset(j->seen, 0, j->n);
+	j->valid = 1;
+}
+
+static void io_journal_free(struct io_journal *j)
+{
+	if (j->hash)
+		mem_free(j->hash);
+	if (j->seen)
+		mem_free(j->seen);
+	memset(j, 0, sizeof(*j));
 }
 
 /*
- * Save the apts data file, which contains the
- * appointments first, and then the events.
- * Recursive items are written first.
+ * Mark one of the items with the given hash as seen. Returns 0 if there is
+ * no such item left.
  */
-unsigned io_save_apts(const char *aptsfile)
+static int io_journal_see(struct io_journal *j, const uint8_t *hash)
 {
-	llist_item_t *i;
-	FILE *fp;
+	uint8_t (*p)[SHA1_DIGESTLEN];
+	size_t k;
+
+	p = bsearch(hash, j->hash, j->n, SHA1_DIGESTLEN, io_journal_hash_cmp);
+	if (!p)
+		return 0;
 
-	if (aptsfile) {
-		if (read_only)
+	/* Items can have duplicates, find the first one not seen yet. */
+	for (k = p - j->hash; k > 0 && !memcmp(j->hash[k - 1], hash,
+					       SHA1_DIGESTLEN); k--) ;
+	for (; k < j->n && !memcmp(j->hash[k], hash, SHA1_DIGESTLEN); k++) {
+		if (!j->seen[k]) {
+			j->seen[k] = 1;
 			return 1;
+		}
+	}
 
-		if ((fp = fopen(aptsfile, "w")) == NULL)
-			return 0;
-	} else {
-		fp = stdout;
+	return 0;
+}
+
+static void io_journal_remove(const char *path)
+{
+	char *path_journal;
+
+	asprintf(&path_journal, "%s" IO_JOURNAL_EXT, path);
+	unlink(path_journal);
+	mem_free(path_journal);
+}
+
+/*
+ * Append each item of the apts file to a string, in the order of the file, and
+ * call fn after each of them.
+ */
+static void io_apts_foreach(struct string *s, io_item_fn_t fn, void *arg)
+{
+	llist_item_t *i;
+	int start;
+
+	LLIST_FOREACH(&recur_elist, i) {
+		start = s->len;
+		recur_event_catstr(s, LLIST_GET_DATA(i));
+		fn(s, start, arg);
 	}
 
-	recur_save_data(fp);
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i) {
+		start = s->len;
+		recur_apoint_catstr(s, LLIST_TS_GET_DATA(i));
+		fn(s, start, arg);
+	}
+	LLIST_TS_UNLOCK(&recur_alist_p);
 
 	if (ui_mode == UI_CURSES)
 		LLIST_TS_LOCK(&alist_p);
 	LLIST_TS_FOREACH(&alist_p, i) {
-		struct apoint *apt = LLIST_TS_GET_DATA(i);
-		apoint_write(apt, fp);
+		start = s->len;
+		apoint_catstr(s, LLIST_TS_GET_DATA(i));
+		fn(s, start, arg);
 	}
 	if (ui_mode == UI_CURSES)
 		LLIST_TS_UNLOCK(&alist_p);
 
 	LLIST_FOREACH(&eventlist, i) {
-		struct event *ev = LLIST_TS_GET_DATA(i);
-		event_write(ev, fp);
+		start = s->len;
+		event_catstr(s, LLIST_GET_DATA(i));
+		fn(s, start, arg);
 	}
-
-	if (aptsfile)
-		file_close(fp, __FILE_POS__);
-
-	return 1;
 }
 
-/* Print all todo items to stdout. */
-void io_dump_todo(const char *fmt_todo)
+/*
+ * Append each item of the todo file to a string, in the order of the file, and
+ * call fn after each of them.
+ */
+static void io_todo_foreach(struct string *s, io_item_fn_t fn, void *arg)
 {
 	llist_item_t *i;
+	int start;
 
 	LLIST_FOREACH(&todolist, i) {
-		struct todo *todo = LLIST_TS_GET_DATA(i);
-		print_todo(fmt_todo, todo);
+		start = s->len;
+		todo_catstr(s, LLIST_GET_DATA(i));
+		fn(s, start, arg);
 	}
 }
 
-/* Save the todo data file. */
-unsigned io_save_todo(const char *todofile)
+/* Terminate the line of an item, and record its hash if needed. */
+static void io_save_item(struct string *s, int start, void *arg)
 {
-	llist_item_t *i;
-	FILE *fp;
+	struct io_journal *journal = arg;
+	uint8_t hash[SHA1_DIGESTLEN];
 
-	if (todofile) {
-		if (read_only)
-			return 1;
+	if (journal) {
+		io_item_hash(s->buf + start, s->len - start, hash);
+		io_journal_add(journal, hash);
+	}
+	string_catc(s, '\n');
+}
+
+static int io_write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
 
-		if ((fp = fopen(todofile, "w")) == NULL)
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
 			return 0;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 1;
+}
+
+/* Make sure a file that was renamed into place survives a crash. */
+static void io_sync_dir(const char *path)
+{
+	char *dir, *p;
+	int fd;
+
+	dir = mem_strdup(path);
+	p = strrchr(dir, '/');
+	if (p == dir)
+		p[1] = '\0';
+	else if (p)
+		*p = '\0';
+	else
+		strcpy(dir, ".");
+
+	if ((fd = open(dir, O_RDONLY)) >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	mem_free(dir);
+}
+
+/*
+ * Write a data file that was serialized into memory in one go, and store the
+ * SHA1 of its contents in sha1 if it is not NULL. The data goes to a temporary
+ * file that then replaces the data file, so that a crash while saving never
+ * leaves a truncated data file behind.
+ */
+static unsigned io_save_buffer(const char *path, const char *buf, size_t len,
+			       char *sha1)
+{
+	struct stat st;
+	char *path_real, *path_tmp;
+	const char *target;
+	int fd;
+	unsigned ret = 0;
+
+	if (sha1)
+		sha1_buffer(buf, len, sha1);
+
+	/* Replace the file a symbolic link points to, not the link. */
+	path_real = realpath(path, NULL);
+	target = path_real ? path_real : path;
+
+	asprintf(&path_tmp, "%s.XXXXXX", target);
+	if ((fd = mkstemp(path_tmp)) < 0)
+		goto cleanup;
+	if (stat(target, &st) == 0)
+		fchmod(fd, st.st_mode & 07777);
+
+	ret = io_write_all(fd, buf, len) && fsync(fd) == 0;
+	if (close(fd) != 0)
+		ret = 0;
+	if (ret && rename(path_tmp, target) == 0)
+		io_sync_dir(target);
+	else
+		ret = 0;
+	if (!ret)
+		unlink(path_tmp);
+
+cleanup:
+	mem_free(path_tmp);
+	free(path_real);
+	return ret;
+}
+
+/*
+ * Save the items of a data file in full, or print them to stdout if path is
+ * NULL. The SHA1 of the saved file is stored in sha1 and the hashes of the
+ * items in journal, if they are not NULL. The journal of the file on disk no
+ * longer applies and is removed.
+ */
+static unsigned io_save_items(const char *path, io_foreach_fn_t foreach,
+			      char *sha1, struct io_journal *journal)
+{
+	struct string s;
+	unsigned ret = 1;
+
+	if (path && read_only)
+		return 1;
+
+	string_init(&s);
+	if (journal)
+		io_journal_free(journal);
+	foreach(&s, io_save_item, journal);
+	if (journal)
+		io_journal_sort(journal);
+
+	if (!path) {
+		fwrite(s.buf, 1, s.len, stdout);
+	} else if (io_save_buffer(path, s.buf, s.len, sha1)) {
+		io_journal_remove(path);
+	} else {
+		ret = 0;
+	}
+	mem_free(s.buf);
+
+	return ret;
+}
+
+struct io_journal_diff {
+	struct string out;
+	struct io_journal *old;
+	struct io_journal next;
+};
+
+/* Record an item in the journal if it was added, then drop it. */
+static void io_journal_diff_item(struct string *s, int start, void *arg)
+{
+	struct io_journal_diff *d = arg;
+	uint8_t hash[SHA1_DIGESTLEN];
+
+	io_item_hash(s->buf + start, s->len - start, hash);
+	io_journal_add(&d->next, hash);
+	if (!io_journal_see(d->old, hash)) {
+		string_catc(&d->out, '+');
+		string_catn(&d->out, s->buf + start, s->len - start);
+		string_catc(&d->out, '\n');
+	}
+	s->len = start;
+}
+
+/*
+ * Append the changes to the items of a data file since it was last written
+ * to its journal. The SHA1 and size are the ones of the data file on disk.
+ * Returns 0 if the data file has to be written in full instead.
+ */
+static unsigned io_journal_save(const char *path, io_foreach_fn_t foreach,
+				struct io_journal *journal, const char *sha1,
+				off_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+	struct io_journal_diff d;
+	struct string item;
+	struct stat st;
+	char *path_journal, *header;
+	size_t k;
+	off_t max;
+	int fd, i, pending;
+	unsigned ret = 0;
+
+	if (!journal->valid)
+		return 0;
+
+	string_init(&d.out);
+	d.old = journal;
+	memset(&d.next, 0, sizeof(d.next));
+	string_init(&item);
+	foreach(&item, io_journal_diff_item, &d);
+	mem_free(item.buf);
+	for (k = 0; k < journal->n; k++) {
+		if (journal->seen[k])
+			continue;
+		string_catc(&d.out, '-');
+		for (i = 0; i < SHA1_DIGESTLEN; i++) {
+			string_catc(&d.out, hex[journal->hash[k][i] >> 4]);
+			string_catc(&d.out, hex[journal->hash[k][i] & 0xf]);
+		}
+		string_catc(&d.out, '\n');
+	}
+
+	if (d.out.len == 0) {
+		/* Nothing changed. */
+		ret = 1;
+		goto cleanup;
+	}
+
+	asprintf(&path_journal, "%s" IO_JOURNAL_EXT, path);
+	fd = open(path_journal, O_WRONLY | O_APPEND | O_CREAT, 0666);
+	mem_free(path_journal);
+	if (fd < 0)
+		goto cleanup;
+
+	max = size / IO_JOURNAL_RATIO;
+	if (max < IO_JOURNAL_MIN)
+		max = IO_JOURNAL_MIN;
+	if (fstat(fd, &st) == 0 && st.st_size + d.out.len <= max) {
+		ret = 1;
+		if (st.st_size == 0) {
+			asprintf(&header, IO_JOURNAL_MAGIC "%s\n", sha1);
+			ret = io_write_all(fd, header, strlen(header));
+			mem_free(header);
+		}
+		ret = ret && io_write_all(fd, d.out.buf, d.out.len) &&
+		      fsync(fd) == 0;
+	}
+	close(fd);
+
+cleanup:
+	if (ret) {
+		pending = journal->pending || d.out.len > 0;
+		io_journal_free(journal);
+		*journal = d.next;
+		io_journal_sort(journal);
+		journal->pending = pending;
 	} else {
-		fp = stdout;
+		io_journal_free(&d.next);
 	}
+	mem_free(d.out.buf);
+	return ret;
+}
+
+/*
+ * Save the apts data file, which contains the
+ * appointments first, and then the events.
+ * Recursive items are written first.
+ * The SHA1 of the saved file is stored in sha1 if it is not NULL.
+ */
+unsigned io_save_apts(const char *aptsfile, char *sha1)
+{
+	return io_save_items(aptsfile, io_apts_foreach, sha1, NULL);
+}
+
+/* Print all todo items to stdout. */
+void io_dump_todo(const char *fmt_todo)
+{
+	llist_item_t *i;
 
 	LLIST_FOREACH(&todolist, i) {
 		struct todo *todo = LLIST_TS_GET_DATA(i);
-		todo_write(todo, fp);
+		print_todo(stdout, fmt_todo, todo);
 	}
+}
 
-	if (todofile)
-		file_close(fp, __FILE_POS__);
-
-	return 1;
+/*
+ * Save the todo data file. The SHA1 of the saved file is stored in sha1 if it
+ * is not NULL.
+ */
+unsigned io_save_todo(const char *todofile, char *sha1)
+{
+	return io_save_items(todofile, io_todo_foreach, sha1, NULL);
 }
 
 /* Save user-defined keys */
 unsigned io_save_keys(void)
 {
 	FILE *fp;
+	char *buf;
+	size_t len;
+	unsigned ret;
 
 	if (read_only)
 		return 1;
 
-	if ((fp = fopen(path_keys, "w")) == NULL)
+	if ((fp = open_memstream(&buf, &len)) == NULL)
 		return 0;
 
 	keys_save_bindings(fp);
 	file_close(fp, __FILE_POS__);
 
-	return 1;
+	ret = io_save_buffer(path_keys, buf, len, NULL);
+	free(buf);
+
+	return ret;
 }
 
 static int io_compute_hash(const char *path, char *buf)
@@ -457,8 +848,8 @@ static void io_merge_data(void)
 	asprintf(&path_todo_new, "%s%s", path_todo, new_ext);
 
 	io_mutex_lock();
-	io_save_apts(path_apts_new);
-	io_save_todo(path_todo_new);
+	io_save_apts(path_apts_new, NULL);
+	io_save_todo(path_todo_new, NULL);
 	io_mutex_unlock();
 
 	/*
@@ -483,7 +874,7 @@ static void io_merge_data(void)
 	mem_free(path_apts_new);
 	mem_free(path_todo_new);
 
-	io_unset_modified();
+	io_unset_modified(IO_MODIFIED_DATA);
 
 	/*
 	 * We do not directly write to the data files here; however, the
@@ -524,345 +915,1629 @@ static int resolve_save_conflict(void)
 	return ret;
 }
 
-static int io_check_data_files_modified()
+/* Get the modification time of a file, to the nanosecond where available. */
+static void io_stat_mtime(const struct stat *st, struct timespec *ts)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*ts = st->st_mtim;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*ts = st->st_mtimespec;
+#else
+	ts->tv_sec = st->st_mtime;
+	ts->tv_nsec = 0;
+#endif
+}
+
+static void io_file_stat_set(struct io_file_stat *fs, const struct stat *st)
+{
+	fs->valid = 1;
+	fs->dev = st->st_dev;
+	fs->ino = st->st_ino;
+	fs->size = st->st_size;
+	io_stat_mtime(st, &fs->mtime);
+}
+
+static void io_file_stat_record(const char *path, struct io_file_stat *fs)
+{
+	struct stat st;
+
+	if (stat(path, &st) == 0)
+		io_file_stat_set(fs, &st);
+	else
+		fs->valid = 0;
+}
+
+static int io_file_stat_equal(const struct io_file_stat *fs,
+			      const struct stat *st)
+{
+	struct timespec mtime;
+
+	io_stat_mtime(st, &mtime);
+	return fs->valid && fs->dev == st->st_dev && fs->ino == st->st_ino &&
+	       fs->size == st->st_size && fs->mtime.tv_sec == mtime.tv_sec &&
+	       fs->mtime.tv_nsec == mtime.tv_nsec;
+}
+
+/*
+ * Check whether a data file changed since it was last read or written. The
+ * file is only hashed if its identity changed, unless the identity is trusted
+ * entirely.
+ */
+static int io_data_file_modified(const char *path, struct io_file_stat *fs,
+				 const char *sha1)
 {
 	char sha1_new[SHA1_DIGESTLEN * 2 + 1];
-	int ret = 1;
+	struct stat st;
 
-	io_mutex_lock();
+	if (stat(path, &st) != 0)
+		return 0;
+	if (io_file_stat_equal(fs, &st))
+		return 0;
+	if (conf.trust_file_stat && fs->valid)
+		return 1;
 
-	if (io_compute_hash(path_apts, sha1_new)) {
-		if (strncmp(sha1_new, apts_sha1, SHA1_DIGESTLEN * 2) != 0)
-			goto cleanup;
-	}
+	if (!io_compute_hash(path, sha1_new))
+		return 0;
+	if (strncmp(sha1_new, sha1, SHA1_DIGESTLEN * 2) != 0)
+		return 1;
 
-	if (io_compute_hash(path_todo, sha1_new)) {
-		if (strncmp(sha1_new, todo_sha1, SHA1_DIGESTLEN * 2) != 0)
-			goto cleanup;
-	}
+	/* Same contents, e.g. the file was touched. */
+	io_file_stat_set(fs, &st);
+	return 0;
+}
 
-	ret = 0;
+/* Check whether another program changed the data files since they were read. */
+int io_check_data_files_modified(void)
+{
+	int ret;
 
-cleanup:
+	io_mutex_lock();
+	ret = io_data_file_modified(path_apts, &apts_stat, apts_sha1) ||
+	      io_data_file_modified(path_todo, &todo_stat, todo_sha1);
 	io_mutex_unlock();
+
 	return ret;
 }
 
-/* Save the calendar data */
-void io_save_cal(enum save_display display)
+/*
+ * Save a data file for io_save_data(), appending to its journal if journal is
+ * set and writing it in full otherwise. The hashes of the items are only kept
+ * for journals if periodic saves are enabled.
+ */
+static unsigned io_save_data_file(const char *path, io_foreach_fn_t foreach,
+				  struct io_journal *journal, char *sha1,
+				  struct io_file_stat *fs, int append)
+{
+	char sha1_new[SHA1_DIGESTLEN * 2 + 1];
+
+	if (append && fs->valid &&
+	    io_journal_save(path, foreach, journal, sha1, fs->size))
+		return 1;
+
+	if (!io_save_items(path, foreach, sha1_new,
+			   conf.periodic_save > 0 ? journal : NULL))
+		return 0;
+
+	/* The savers hashed what they wrote, no need to read it back. */
+	memcpy(sha1, sha1_new, sizeof(sha1_new));
+	io_file_stat_record(path, fs);
+	journal->pending = 0;
+	journal->stale = 0;
+
+	return 1;
+}
+
+/*
+ * Save the files with unsaved modifications. If journal is set, changes to the
+ * data files are appended to their journals where possible, and the hooks are
+ * not run since the data files alone are out of date. Otherwise, data files
+ * with pending journals are written in full as well. Data files with stale
+ * journals are always written in full.
+ */
+static void io_save_data(enum save_display display, int journal)
 {
 	const char *access_pb = _("Problems accessing data file ...");
 	const char *save_success =
 	    _("The data files were successfully saved");
 	const char *enter = _("Press [ENTER] to continue");
-	int show_bar;
+	int show_bar, files, failed = 0;
 
 	if (read_only)
 		return;
 
-	if (io_check_data_files_modified() && resolve_save_conflict()) {
-		if (io_reload_data()) {
-			day_process_storage(ui_calendar_get_slctd_day(), 1);
-			ui_day_load_items();
-			ui_day_sel_reset();
-			notify_check_next_app(1);
-			ui_calendar_monthly_view_cache_set_invalid();
-			wins_update(FLAG_ALL);
+	files = io_get_modified();
+	if ((!journal && apts_journal.pending) || apts_journal.stale)
+		files |= IO_MODIFIED_APTS;
+	if ((!journal && todo_journal.pending) || todo_journal.stale)
+		files |= IO_MODIFIED_TODO;
+
+	if ((files & IO_MODIFIED_DATA) && io_check_data_files_modified()) {
+		if (resolve_save_conflict()) {
+			if (io_reload_data()) {
+				day_process_storage(ui_calendar_get_slctd_day(),
+						    1);
+				ui_day_load_items();
+				ui_day_sel_reset();
+				notify_check_next_app(1);
+				ui_calendar_day_cache_set_invalid();
+				wins_update(FLAG_ALL);
+			}
+			return;
 		}
-		return;
+		/* Overwrite, the journals do not apply to the files any more. */
+		files |= IO_MODIFIED_DATA;
+		journal = 0;
 	}
 
-	run_hook("pre-save");
+	if (!journal)
+		run_hook("pre-save");
 
 	show_bar = 0;
 	if (ui_mode == UI_CURSES && display == IO_SAVE_DISPLAY_BAR
 	    && conf.progress_bar)
 		show_bar = 1;
 
-	if (show_bar)
-		progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_CONF);
-	if (!config_save())
-		ERROR_MSG("%s", access_pb);
+	/* Modifications made while saving are saved the next time. */
+	io_unset_modified(files);
+
+	if (files & IO_MODIFIED_CONF) {
+		if (show_bar)
+			progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_CONF);
+		if (!config_save())
+			failed |= IO_MODIFIED_CONF;
+	}
+
+	/*
+	 * Hold the mutex until the new state of the data files is recorded, so
+	 * that they are not mistaken for files changed by another program.
+	 */
+	io_mutex_lock();
+	if (files & IO_MODIFIED_TODO) {
+		if (show_bar)
+			progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_TODO);
+		if (!io_save_data_file(path_todo, io_todo_foreach,
+				       &todo_journal, todo_sha1, &todo_stat,
+				       journal))
+			failed |= IO_MODIFIED_TODO;
+	}
+	if (files & IO_MODIFIED_APTS) {
+		if (show_bar)
+			progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_APTS);
+		if (!io_save_data_file(path_apts, io_apts_foreach,
+				       &apts_journal, apts_sha1, &apts_stat,
+				       journal))
+			failed |= IO_MODIFIED_APTS;
+	}
+	io_mutex_unlock();
+
+	if (files & IO_MODIFIED_KEYS) {
+		if (show_bar)
+			progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_KEYS);
+		if (!io_save_keys())
+			failed |= IO_MODIFIED_KEYS;
+	}
 
-	if (show_bar)
-		progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_TODO);
-	if (!io_save_todo(path_todo))
+	if (failed) {
+		io_set_modified(failed);
 		ERROR_MSG("%s", access_pb);
+	}
+
+	/* Print a message telling data were saved */
+	if (ui_mode == UI_CURSES && display == IO_SAVE_DISPLAY_BAR &&
+	    show_dialogs()) {
+		status_mesg(save_success, enter);
+		keys_wait_for_any_key(win[KEY].p);
+	}
+
+	if (!journal)
+		run_hook("post-save");
+}
+
+/* Save the calendar data */
+void io_save_cal(enum save_display display)
+{
+	io_save_data(display, 0);
+}
+
+static void io_load_error(const char *filename, unsigned line,
+			  const char *mesg)
+{
+	EXIT("%s:%u: %s", filename, line, mesg);
+}
+
+/*
+ * A data file mapped into memory, and the position of the parser in it. The
+ * io_scan_*() functions mirror the stdio calls the file used to be parsed
+ * with, so that the same input is accepted and rejected.
+ */
+struct io_scan {
+	char *data;
+	size_t size;
+	int mapped;
+	const char *p;
+	const char *end;
+	sha1_ctx_t *sha1;	/* hash of the data consumed so far */
+	const char *hashed;
+	struct stat st;
+};
+
+/*
+ * Map a file into memory. Failures are fatal and reported with the given
+ * message, unless the message is NULL: 0 is returned in that case.
+ */
+static int io_scan_open(struct io_scan *s, const char *path,
+			const char *errmsg)
+{
+	struct stat st;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		if (errmsg)
+			EXIT("%s", errmsg);
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+
+	s->data = NULL;
+	s->size = st.st_size;
+	s->mapped = 0;
+	s->st = st;
+	if (s->size > 0) {
+		s->data = mmap(NULL, s->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (s->data != MAP_FAILED) {
+			s->mapped = 1;
+			posix_madvise(s->data, s->size,
+				      POSIX_MADV_SEQUENTIAL);
+		} else {
+			/* Not a regular file, read it instead. */
+			s->data = mem_malloc(s->size);
+			n = read(fd, s->data, s->size);
+			if (n < 0) {
+				if (errmsg)
+					EXIT("%s", errmsg);
+				mem_free(s->data);
+				close(fd);
+				return 0;
+			}
+			s->size = n;
+		}
+	}
+	close(fd);
+
+	s->p = s->data;
+	s->end = s->data + s->size;
+	s->sha1 = NULL;
+	s->hashed = s->p;
+
+	return 1;
+}
+
+static void io_scan_close(struct io_scan *s)
+{
+	if (s->mapped)
+		munmap(s->data, s->size);
+	else if (s->data)
+		mem_free(s->data);
+}
+
+/* Start computing the SHA1 of the data while it is consumed. */
+static void io_scan_hash_init(struct io_scan *s, sha1_ctx_t *ctx)
+{
+	sha1_init(ctx);
+	s->sha1 = ctx;
+	s->hashed = s->p;
+}
+
+/* Add the data consumed since the last call to the SHA1, if one is computed. */
+static void io_scan_hash(struct io_scan *s)
+{
+	if (!s->sha1)
+		return;
+	sha1_update_buffer(s->sha1, s->hashed, s->p - s->hashed);
+	s->hashed = s->p;
+}
+
+static int io_scan_getc(struct io_scan *s)
+{
+	return s->p < s->end ? (unsigned char)*s->p++ : EOF;
+}
+
+static void io_scan_ungetc(struct io_scan *s, int c)
+{
+	if (c != EOF)
+		s->p--;
+}
+
+/* Skip white space, like a space in a scanf() format. */
+static void io_scan_space(struct io_scan *s)
+{
+	while (s->p < s->end && isspace((unsigned char)*s->p))
+		s->p++;
+}
+
+/* Match a character, like an ordinary character in a scanf() format. */
+static int io_scan_char(struct io_scan *s, int c)
+{
+	if (s->p == s->end || *s->p != c)
+		return 0;
+	s->p++;
+	return 1;
+}
+
+/* Read a decimal integer, like "%d" in a scanf() format. */
+static int io_scan_int(struct io_scan *s, int *val)
+{
+	const char *p;
+	long v = 0;
+	int neg = 0;
+
+	io_scan_space(s);
+	p = s->p;
+	if (p < s->end && (*p == '-' || *p == '+'))
+		neg = (*p++ == '-');
+	if (p == s->end || !isdigit((unsigned char)*p))
+		return 0;
+
+	for (; p < s->end && isdigit((unsigned char)*p); p++) {
+		if (v <= INT_MAX)
+			v = v * 10 + (*p - '0');
+	}
+	if (v > INT_MAX)
+		v = INT_MAX;
+
+	*val = neg ? -v : v;
+	s->p = p;
+	return 1;
+}
+
+/* Read a date, like "%d / %d / %d " in a scanf() format. */
+static int io_scan_date(struct io_scan *s, struct tm *t)
+{
+	if (!io_scan_int(s, &t->tm_mon))
+		return 0;
+	io_scan_space(s);
+	if (!io_scan_char(s, '/') || !io_scan_int(s, &t->tm_mday))
+		return 0;
+	io_scan_space(s);
+	if (!io_scan_char(s, '/') || !io_scan_int(s, &t->tm_year))
+		return 0;
+	io_scan_space(s);
+
+	return 1;
+}
+
+/* Read a time, like "%d : %d " in a scanf() format. */
+static int io_scan_time(struct io_scan *s, struct tm *t)
+{
+	if (!io_scan_int(s, &t->tm_hour))
+		return 0;
+	io_scan_space(s);
+	if (!io_scan_char(s, ':') || !io_scan_int(s, &t->tm_min))
+		return 0;
+	io_scan_space(s);
+
+	return 1;
+}
+
+static void io_scan_skip_blanks(struct io_scan *s)
+{
+	while (s->p < s->end && *s->p == ' ')
+		s->p++;
+}
+
+/*
+ * Read the rest of a line, like fgets() with a buffer of the given size, and
+ * strip the newline. Returns NULL at the end of the data.
+ */
+static char *io_scan_line(struct io_scan *s, char *buf, size_t size)
+{
+	const char *nl;
+	size_t n;
+
+	if (s->p == s->end)
+		return NULL;
+
+	n = s->end - s->p;
+	if (n > size - 1)
+		n = size - 1;
+	nl = memchr(s->p, '\n', n);
+	if (nl)
+		n = nl - s->p + 1;
+
+	memcpy(buf, s->p, n);
+	buf[nl ? n - 1 : n] = '\0';
+	s->p += n;
+
+	return buf;
+}
+
+/* Read a serialized note file name, like note_read(). */
+static void io_scan_note(struct io_scan *s, char *buffer)
+{
+	int i;
+
+	for (i = 0; i < MAX_NOTESIZ; i++) {
+		buffer[i] = io_scan_getc(s);
+		if (buffer[i] == ' ') {
+			buffer[i] = '\0';
+			return;
+		}
+	}
+
+	while (s->p < s->end && io_scan_getc(s) != ' ') ;
+	buffer[MAX_NOTESIZ] = '\0';
+}
+
+/*
+ * Binary snapshots of the data files. A snapshot is written next to a data
+ * file after the file was parsed, and is loaded instead of parsing the file
+ * again as long as the SHA1 of the file and the rules of the time zone did not
+ * change. Snapshots use the native data layout and item order, and are only
+ * read back by a build with the same format version.
+ */
+#define IO_SNAP_MAGIC "calcsnap"
+#define IO_SNAP_VERSION 2
+#define IO_SNAP_EXT ".snap"
+#define IO_SNAP_TZDIR "/usr/share/zoneinfo"
+
+enum io_snap_kind {
+	IO_SNAP_APTS,
+	IO_SNAP_TODO
+};
+
+struct io_snap_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t order;
+	uint32_t long_size;
+	uint32_t kind;
+	char sha1[SHA1_DIGESTLEN * 2 + 1];
+	char tz[SHA1_DIGESTLEN * 2 + 1];
+	uint32_t count[4];	/* number of items in each list */
+};
+
+/*
+ * Compute the SHA1 of the rules of the local time zone, as found by the C
+ * library: the contents of the zoneinfo file named by TZ, or of /etc/localtime
+ * if TZ is not set, or TZ itself if it spells out the rules. Returns 0 if the
+ * rules cannot be told apart from the ones of another time zone.
+ */
+static int io_snap_tz_hash(char *sha1)
+{
+	const char *tz = getenv("TZ"), *tzdir;
+	char *path;
+	int ret;
+
+	if (!tz)
+		return io_compute_hash("/etc/localtime", sha1);
+
+	if (*tz == ':')
+		tz++;
+	if (*tz == '/') {
+		if (io_compute_hash(tz, sha1))
+			return 1;
+	} else if (*tz) {
+		tzdir = getenv("TZDIR");
+		asprintf(&path, "%s/%s", tzdir && *tzdir ? tzdir : IO_SNAP_TZDIR,
+			 tz);
+		ret = io_compute_hash(path, sha1);
+		mem_free(path);
+		if (ret)
+			return 1;
+	}
+
+	/* An empty TZ stands for UTC, and rules are given after a comma. */
+	if (*tz && !strchr(tz, ','))
+		return 0;
+	sha1_digest(tz, sha1);
+	return 1;
+}
+
+/*
+ * Fill in the header of a snapshot. Returns 0 if snapshots cannot be used in
+ * the current time zone.
+ */
+static int io_snap_header_init(struct io_snap_header *h,
+			       enum io_snap_kind kind, const char *sha1)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, IO_SNAP_MAGIC, sizeof(h->magic));
+	h->version = IO_SNAP_VERSION;
+	h->order = 0x01020304;
+	h->long_size = sizeof(long);
+	h->kind = kind;
+	strncpy(h->sha1, sha1, SHA1_DIGESTLEN * 2);
+
+	/* Item times depend on the rules of the local time zone. */
+	return io_snap_tz_hash(h->tz);
+}
+
+/*
+ * Check whether a filter lets all items of a data file through. The fields of
+ * the filter that only apply to the other data file are ignored.
+ */
+static int
+io_filter_is_empty(struct item_filter *filter, enum io_snap_kind kind)
+{
+	if (!filter)
+		return 1;
+	if (filter->hash || filter->regex)
+		return 0;
+
+	if (kind == IO_SNAP_APTS)
+		return (filter->type_mask & TYPE_MASK_CAL) == TYPE_MASK_CAL &&
+		       filter->start_from == -1 && filter->start_to == -1 &&
+		       filter->end_from == -1 && filter->end_to == -1;
+	else
+		return (filter->type_mask & TYPE_MASK_TODO) &&
+		       !filter->priority && !filter->completed &&
+		       !filter->uncompleted;
+}
+
+static void io_snap_put_long(FILE *fp, long val)
+{
+	fwrite(&val, sizeof(val), 1, fp);
+}
+
+static void io_snap_put_str(FILE *fp, const char *str)
+{
+	uint32_t len = str ? strlen(str) + 1 : 0;
+
+	fwrite(&len, sizeof(len), 1, fp);
+	if (len > 0)
+		fwrite(str, 1, len, fp);
+}
+
+static void io_snap_put_exc(FILE *fp, struct exc_days *exc)
+{
+	io_snap_put_long(fp, exc->count);
+	if (exc->count > 0)
+		fwrite(exc->day, sizeof(long), exc->count, fp);
+}
+
+static void io_snap_put_apts(FILE *fp, struct io_snap_header *h)
+{
+	llist_item_t *i;
+
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_FOREACH(&alist_p, i) {
+		struct apoint *apt = LLIST_TS_GET_DATA(i);
+
+		io_snap_put_long(fp, apt->start);
+		io_snap_put_long(fp, apt->dur);
+		io_snap_put_long(fp, apt->state);
+		io_snap_put_str(fp, apt->mesg);
+		io_snap_put_str(fp, apt->note);
+		h->count[0]++;
+	}
+	LLIST_TS_UNLOCK(&alist_p);
+
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i) {
+		struct recur_apoint *rapt = LLIST_TS_GET_DATA(i);
+
+		io_snap_put_long(fp, rapt->start);
+		io_snap_put_long(fp, rapt->dur);
+		io_snap_put_long(fp, rapt->state);
+		io_snap_put_long(fp, rapt->rpt->type);
+		io_snap_put_long(fp, rapt->rpt->freq);
+		io_snap_put_long(fp, rapt->rpt->until);
+		io_snap_put_exc(fp, &rapt->exc);
+		io_snap_put_str(fp, rapt->mesg);
+		io_snap_put_str(fp, rapt->note);
+		h->count[1]++;
+	}
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	LLIST_FOREACH(&eventlist, i) {
+		struct event *ev = LLIST_GET_DATA(i);
+
+		io_snap_put_long(fp, ev->day);
+		io_snap_put_long(fp, ev->id);
+		io_snap_put_str(fp, ev->mesg);
+		io_snap_put_str(fp, ev->note);
+		h->count[2]++;
+	}
+
+	LLIST_FOREACH(&recur_elist, i) {
+		struct recur_event *rev = LLIST_GET_DATA(i);
+
+		io_snap_put_long(fp, rev->day);
+		io_snap_put_long(fp, rev->id);
+		io_snap_put_long(fp, rev->rpt->type);
+		io_snap_put_long(fp, rev->rpt->freq);
+		io_snap_put_long(fp, rev->rpt->until);
+		io_snap_put_exc(fp, &rev->exc);
+		io_snap_put_str(fp, rev->mesg);
+		io_snap_put_str(fp, rev->note);
+		h->count[3]++;
+	}
+}
+
+static void io_snap_put_todo(FILE *fp, struct io_snap_header *h)
+{
+	llist_item_t *i;
+
+	LLIST_FOREACH(&todolist, i) {
+		struct todo *todo = LLIST_GET_DATA(i);
+
+		io_snap_put_long(fp, todo->id);
+		io_snap_put_long(fp, todo->completed);
+		io_snap_put_str(fp, todo->mesg);
+		io_snap_put_str(fp, todo->note);
+		h->count[0]++;
+	}
+}
+
+/*
+ * Write the snapshot of a data file that was just loaded. Errors are ignored,
+ * the file is simply parsed again next time.
+ */
+static void io_snap_save(const char *path, enum io_snap_kind kind,
+			 const char *sha1)
+{
+	struct io_snap_header h;
+	char *path_snap, *path_tmp;
+	FILE *fp;
+	int fd, err;
+
+	if (!io_snap_header_init(&h, kind, sha1))
+		return;
+
+	asprintf(&path_snap, "%s" IO_SNAP_EXT, path);
+	asprintf(&path_tmp, "%s" IO_SNAP_EXT ".new", path);
+
+	fd = open(path_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		goto cleanup;
+	}
+
+	fwrite(&h, sizeof(h), 1, fp);
+	if (kind == IO_SNAP_APTS)
+		io_snap_put_apts(fp, &h);
+	else
+		io_snap_put_todo(fp, &h);
+	rewind(fp);
+	fwrite(&h, sizeof(h), 1, fp);
+
+	err = ferror(fp);
+	if (fclose(fp) != 0 || err || rename(path_tmp, path_snap) != 0)
+		unlink(path_tmp);
+
+cleanup:
+	mem_free(path_snap);
+	mem_free(path_tmp);
+}
+
+static int io_snap_get(struct io_scan *s, void *buf, size_t size)
+{
+	if ((size_t)(s->end - s->p) < size)
+		return 0;
+	memcpy(buf, s->p, size);
+	s->p += size;
+	return 1;
+}
+
+static int io_snap_get_long(struct io_scan *s, long *val)
+{
+	return io_snap_get(s, val, sizeof(*val));
+}
+
+static int io_snap_get_str(struct io_scan *s, char **str)
+{
+	uint32_t len;
+
+	if (!io_snap_get(s, &len, sizeof(len)))
+		return 0;
+	if (len == 0) {
+		*str = NULL;
+		return 1;
+	}
+	if ((size_t)(s->end - s->p) < len || s->p[len - 1] != '\0')
+		return 0;
+	*str = (char *)s->p;
+	s->p += len;
+	return 1;
+}
+
+/* Read a set of exceptions, which is only checked unless exc is set. */
+static int io_snap_get_exc(struct io_scan *s, struct exc_days *exc)
+{
+	long count, day, prev = LONG_MIN;
+	long i;
+
+	if (!io_snap_get_long(s, &count) || count < 0 ||
+	    (size_t)count > (size_t)(s->end - s->p) / sizeof(long))
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		if (!io_snap_get_long(s, &day) || day < prev)
+			return 0;
+		prev = day;
+	}
+
+	if (exc) {
+		recur_exc_init(exc);
+		if (count > 0) {
+			exc->day = mem_malloc(count * sizeof(long));
+			memcpy(exc->day, s->p - count * sizeof(long),
+			       count * sizeof(long));
+			exc->count = exc->size = count;
+		}
+	}
+
+	return 1;
+}
+
+static int io_snap_valid_type(long type)
+{
+	return type == RECUR_DAILY || type == RECUR_WEEKLY ||
+	       type == RECUR_MONTHLY || type == RECUR_YEARLY;
+}
+
+/*
+ * Read the items of a snapshot of the appointments file. The snapshot is only
+ * checked, unless create is set: the items are then added to the lists.
+ */
+static int io_snap_get_apts(struct io_scan *s, struct io_snap_header *h,
+			    int create)
+{
+	long start, dur, state, day, id, type, freq, until;
+	struct exc_days exc;
+	char *mesg, *note;
+	uint32_t i;
+
+	for (i = 0; i < h->count[0]; i++) {
+		if (!io_snap_get_long(s, &start) ||
+		    !io_snap_get_long(s, &dur) ||
+		    !io_snap_get_long(s, &state) ||
+		    !io_snap_get_str(s, &mesg) ||
+		    !io_snap_get_str(s, &note) || !mesg)
+			return 0;
+		if (create)
+			apoint_new(mesg, note, start, dur, state);
+	}
+
+	for (i = 0; i < h->count[1]; i++) {
+		if (!io_snap_get_long(s, &start) ||
+		    !io_snap_get_long(s, &dur) ||
+		    !io_snap_get_long(s, &state) ||
+		    !io_snap_get_long(s, &type) ||
+		    !io_snap_get_long(s, &freq) ||
+		    !io_snap_get_long(s, &until) ||
+		    !io_snap_get_exc(s, create ? &exc : NULL) ||
+		    !io_snap_get_str(s, &mesg) ||
+		    !io_snap_get_str(s, &note) || !mesg ||
+		    !io_snap_valid_type(type))
+			return 0;
+		if (create)
+			recur_apoint_new(mesg, note, start, dur, state, type,
+					 freq, until, &exc);
+	}
+
+	for (i = 0; i < h->count[2]; i++) {
+		if (!io_snap_get_long(s, &day) ||
+		    !io_snap_get_long(s, &id) ||
+		    !io_snap_get_str(s, &mesg) ||
+		    !io_snap_get_str(s, &note) || !mesg)
+			return 0;
+		if (create)
+			event_new(mesg, note, day, id);
+	}
+
+	for (i = 0; i < h->count[3]; i++) {
+		if (!io_snap_get_long(s, &day) ||
+		    !io_snap_get_long(s, &id) ||
+		    !io_snap_get_long(s, &type) ||
+		    !io_snap_get_long(s, &freq) ||
+		    !io_snap_get_long(s, &until) ||
+		    !io_snap_get_exc(s, create ? &exc : NULL) ||
+		    !io_snap_get_str(s, &mesg) ||
+		    !io_snap_get_str(s, &note) || !mesg ||
+		    !io_snap_valid_type(type))
+			return 0;
+		if (create)
+			recur_event_new(mesg, note, day, id, type, freq,
+					until, &exc);
+	}
+
+	return s->p == s->end;
+}
+
+/* Same as io_snap_get_apts(), for a snapshot of the todo file. */
+static int io_snap_get_todo(struct io_scan *s, struct io_snap_header *h,
+			    int create)
+{
+	long id, completed;
+	char *mesg, *note;
+	uint32_t i;
+
+	for (i = 0; i < h->count[0]; i++) {
+		if (!io_snap_get_long(s, &id) ||
+		    !io_snap_get_long(s, &completed) ||
+		    !io_snap_get_str(s, &mesg) ||
+		    !io_snap_get_str(s, &note) || !mesg)
+			return 0;
+		if (create)
+			todo_add(mesg, id, completed, note);
+	}
+
+	return s->p == s->end;
+}
+
+/*
+ * Map the snapshot of a data file and check that it was written by this build
+ * in the current time zone. Whether it matches the contents of the data file
+ * is checked by io_snap_load(). Returns 0 if there is no usable snapshot.
+ */
+static int io_snap_open(struct io_scan *s, struct io_snap_header *h,
+			const char *path, enum io_snap_kind kind)
+{
+	struct io_snap_header expected;
+	char *path_snap;
+	int ret;
+
+	asprintf(&path_snap, "%s" IO_SNAP_EXT, path);
+	ret = io_scan_open(s, path_snap, NULL);
+	mem_free(path_snap);
+	if (!ret)
+		return 0;
+
+	if (io_snap_get(s, h, sizeof(*h)) &&
+	    io_snap_header_init(&expected, kind, "")) {
+		memcpy(expected.sha1, h->sha1, sizeof(expected.sha1));
+		if (!memcmp(h, &expected,
+			    offsetof(struct io_snap_header, count)))
+			return 1;
+	}
+
+	io_scan_close(s);
+	return 0;
+}
+
+/*
+ * Load the items of a data file from a snapshot opened by io_snap_open(), if
+ * it matches the given SHA1 of the file. The item lists must be in bulk mode.
+ * The snapshot is closed. Returns 0 if the file needs to be parsed.
+ */
+static int io_snap_load(struct io_scan *s, struct io_snap_header *h,
+			const char *sha1)
+{
+	int ret = 0;
+
+	if (strncmp(h->sha1, sha1, sizeof(h->sha1)) != 0)
+		goto cleanup;
+
+	/* Check everything first, so that items are only added once. */
+	if (h->kind == IO_SNAP_APTS) {
+		if (!io_snap_get_apts(s, h, 0))
+			goto cleanup;
+		s->p = s->data + sizeof(*h);
+		io_snap_get_apts(s, h, 1);
+	} else {
+		if (!io_snap_get_todo(s, h, 0))
+			goto cleanup;
+		s->p = s->data + sizeof(*h);
+		io_snap_get_todo(s, h, 1);
+	}
+	ret = 1;
 
-	if (show_bar)
-		progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_APTS);
-	if (!io_save_apts(path_apts))
-		ERROR_MSG("%s", access_pb);
+cleanup:
+	io_scan_close(s);
+	return ret;
+}
 
-	if (show_bar)
-		progress_bar(PROGRESS_BAR_SAVE, PROGRESS_BAR_KEYS);
-	if (!io_save_keys())
-		ERROR_MSG("%s", access_pb);
+/* Appointment files smaller than this are parsed by a single thread. */
+#define IO_LOAD_CHUNK_MIN (1 << 20)
 
-	io_mutex_lock();
-	io_unset_modified();
-	io_compute_hash(path_apts, apts_sha1);
-	io_compute_hash(path_todo, todo_sha1);
-	io_mutex_unlock();
+/*
+ * A part of the appointments file that starts and ends at line boundaries.
+ * Its items are collected into separate lists in bulk mode, which are merged
+ * into the item lists once all parts are loaded.
+ */
+struct io_load_chunk {
+	struct io_scan data;
+	struct item_filter *filter;
+	struct exc_days exc;
+	int threaded;
+	int failed;
+	llist_t apts;
+	llist_t recur_apts;
+	llist_t events;
+	llist_t recur_events;
+};
 
-	/* Print a message telling data were saved */
-	if (ui_mode == UI_CURSES && display == IO_SAVE_DISPLAY_BAR &&
-	    show_dialogs()) {
-		status_mesg(save_success, enter);
-		keys_wait_for_any_key(win[KEY].p);
+/*
+ * Report an error found while loading a chunk. Errors are fatal, unless the
+ * chunk is loaded by a worker thread: the thread then stops and the whole file
+ * is parsed again to report the first error. A line of zero means the error is
+ * reported without a location.
+ */
+static void io_load_chunk_error(struct io_load_chunk *c, unsigned line,
+				const char *mesg)
+{
+	if (c->threaded) {
+		c->failed = 1;
+		pthread_exit(NULL);
 	}
 
-	run_hook("post-save");
+	if (line > 0)
+		io_load_error(path_apts, line, mesg);
+	else
+		EXIT("%s", mesg);
 }
 
-static void io_load_error(const char *filename, unsigned line,
-			  const char *mesg)
+/*
+ * Read days for which recurrent items must not be repeated
+ * (such days are called exceptions). The character following the
+ * exceptions, usually the closing brace, is consumed as well.
+ */
+static void io_scan_exc(struct io_load_chunk *c)
 {
-	EXIT("%s:%u: %s", filename, line, mesg);
+	struct tm day;
+
+	recur_exc_init(&c->exc);
+	while (io_scan_getc(&c->data) == '!') {
+		if (!io_scan_date(&c->data, &day))
+			io_load_chunk_error(c, 0,
+					    _("syntax error in item date"));
+
+		if (!check_date(day.tm_year, day.tm_mon, day.tm_mday))
+			io_load_chunk_error(c, 0,
+					    _("date error in item exception"));
+
+		recur_exc_add_day(&c->exc, day.tm_year, day.tm_mon,
+				  day.tm_mday);
+	}
 }
 
 /*
- * Check what type of data is written in the appointment file,
+ * Check what type of data is written in a chunk of the appointment file,
  * and then load either: a new appointment, a new event, or a new
  * recursive item (which can also be either an event or an appointment).
  */
-void io_load_app(struct item_filter *filter)
+static void io_load_chunk(struct io_load_chunk *c)
 {
-	FILE *data_file;
-	int c, is_appointment, is_event, is_recursive;
+	struct io_scan *data = &c->data;
+	struct item_filter *filter = c->filter;
+	int is_appointment, is_event, is_recursive;
 	struct tm start, end, until, lt;
-	llist_t exc;
 	time_t t;
 	int id = 0;
 	int freq;
-	char type, state = 0L;
+	char type = 0, state = 0L;
 	char note[MAX_NOTESIZ + 1], *notep;
+	char buf[BUFSIZ];
 	unsigned line = 0;
+	const char *err;
+	void *item;
+	int ch;
 
 	t = time(NULL);
 	localtime_r(&t, &lt);
 	start = end = until = lt;
 
-	data_file = fopen(path_apts, "r");
-	EXIT_IF(data_file == NULL, _("failed to open appointment file"));
-
-	sha1_stream(data_file, apts_sha1);
-	rewind(data_file);
-
 	for (;;) {
-		LLIST_INIT(&exc);
+		io_scan_hash(data);
+		recur_exc_init(&c->exc);
 		is_appointment = is_event = is_recursive = 0;
 		line++;
-		c = getc(data_file);
-		if (c == EOF)
+		if (data->p == data->end)
 			break;
-		ungetc(c, data_file);
 
 		/* Read the date first: it is common to both events
 		 * and appointments.
 		 */
-		if (fscanf(data_file, "%d / %d / %d ",
-			   &start.tm_mon, &start.tm_mday,
-			   &start.tm_year) != 3)
-			io_load_error(path_apts, line,
-				      _("syntax error in the item date"));
+		if (!io_scan_date(data, &start))
+			io_load_chunk_error(c, line,
+					    _("syntax error in the item date"));
 
 		/* Read the next character : if it is an '@' then we have
 		 * an appointment, else if it is an '[' we have en event.
 		 */
-		c = getc(data_file);
+		ch = io_scan_getc(data);
 
-		if (c == '@')
+		if (ch == '@')
 			is_appointment = 1;
-		else if (c == '[')
+		else if (ch == '[')
 			is_event = 1;
 		else
-			io_load_error(path_apts, line,
-				      _("no event nor appointment found"));
+			io_load_chunk_error(c, line,
+					    _("no event nor appointment found"));
 
 		/* Read the remaining informations. */
 		if (is_appointment) {
-			if (fscanf
-			    (data_file,
-			     " %d : %d -> %d / %d / %d @ %d : %d ",
-			     &start.tm_hour, &start.tm_min, &end.tm_mon,
-			     &end.tm_mday, &end.tm_year, &end.tm_hour,
-			     &end.tm_min) != 7)
-				io_load_error(path_apts, line,
-					      _("syntax error in item time or duration"));
+			io_scan_space(data);
+			if (!io_scan_time(data, &start) ||
+			    !io_scan_char(data, '-') ||
+			    !io_scan_char(data, '>') ||
+			    !io_scan_date(data, &end) ||
+			    !io_scan_char(data, '@') ||
+			    !io_scan_time(data, &end))
+				io_load_chunk_error(c, line,
+						    _("syntax error in item time or duration"));
 		} else if (is_event) {
-			if (fscanf(data_file, " %d ", &id) != 1
-			    || getc(data_file) != ']')
-				io_load_error(path_apts, line,
-					      _("syntax error in item identifier"));
-			while ((c = getc(data_file)) == ' ') ;
-			ungetc(c, data_file);
+			if (!io_scan_int(data, &id))
+				io_load_chunk_error(c, line,
+						    _("syntax error in item identifier"));
+			io_scan_space(data);
+			if (io_scan_getc(data) != ']')
+				io_load_chunk_error(c, line,
+						    _("syntax error in item identifier"));
+			io_scan_skip_blanks(data);
 		} else {
-			io_load_error(path_apts, line,
-				      _("wrong format in the appointment or event"));
+			io_load_chunk_error(c, line,
+					    _("wrong format in the appointment or event"));
 			/* NOTREACHED */
 		}
 
 		/* Check if we have a recursive item. */
-		c = getc(data_file);
+		ch = io_scan_getc(data);
 
-		if (c == '{') {
+		if (ch == '{') {
 			is_recursive = 1;
-			if (fscanf(data_file, " %d%c ", &freq, &type) != 2)
-				io_load_error(path_apts, line,
-					      _("syntax error in item repetition"));
-
-			c = getc(data_file);
-			if (c == '}') {	/* endless recurrent item */
+			if (!io_scan_int(data, &freq) ||
+			    (ch = io_scan_getc(data)) == EOF)
+				io_load_chunk_error(c, line,
+						    _("syntax error in item repetition"));
+			type = ch;
+			io_scan_space(data);
+
+			ch = io_scan_getc(data);
+			if (ch == '}') {	/* endless recurrent item */
 				until.tm_year = 0;
-				while ((c = getc(data_file)) == ' ') ;
-				ungetc(c, data_file);
-			} else if (c == '-' && getc(data_file) == '>') {
-				if (fscanf
-				    (data_file, " %d / %d / %d ",
-				     &until.tm_mon, &until.tm_mday,
-				     &until.tm_year) != 3)
-					io_load_error(path_apts, line,
-						      _("syntax error in item repetition"));
-				c = getc(data_file);
-				if (c == '!') {
-					ungetc(c, data_file);
-					recur_exc_scan(&exc, data_file);
-					while ((c =
-						getc(data_file)) == ' ') ;
-					ungetc(c, data_file);
-				} else if (c == '}') {
-					while ((c =
-						getc(data_file)) == ' ') ;
-					ungetc(c, data_file);
+				io_scan_skip_blanks(data);
+			} else if (ch == '-' && io_scan_getc(data) == '>') {
+				if (!io_scan_date(data, &until))
+					io_load_chunk_error(c, line,
+							    _("syntax error in item repetition"));
+				ch = io_scan_getc(data);
+				if (ch == '!') {
+					io_scan_ungetc(data, ch);
+					io_scan_exc(c);
+					io_scan_skip_blanks(data);
+				} else if (ch == '}') {
+					io_scan_skip_blanks(data);
 				} else {
-					io_load_error(path_apts, line,
-						      _("syntax error in item repetition"));
+					io_load_chunk_error(c, line,
+							    _("syntax error in item repetition"));
 				}
-			} else if (c == '!') {	/* endless item with exceptions */
-				ungetc(c, data_file);
-				recur_exc_scan(&exc, data_file);
-				while ((c = getc(data_file)) == ' ') ;
-				ungetc(c, data_file);
+			} else if (ch == '!') {	/* endless item with exceptions */
+				io_scan_ungetc(data, ch);
+				io_scan_exc(c);
+				io_scan_skip_blanks(data);
 				until.tm_year = 0;
 			} else {
-				io_load_error(path_apts, line,
-					      _("wrong format in the appointment or event"));
+				io_load_chunk_error(c, line,
+						    _("wrong format in the appointment or event"));
 				/* NOTREACHED */
 			}
 		} else {
-			ungetc(c, data_file);
+			io_scan_ungetc(data, ch);
 		}
 
 		/* Check if a note is attached to the item. */
-		c = getc(data_file);
-		if (c == '>') {
-			note_read(note, data_file);
+		if (io_scan_char(data, '>')) {
+			io_scan_note(data, note);
 			notep = note;
 		} else {
 			notep = NULL;
-			ungetc(c, data_file);
 		}
 
 		/*
 		 * Last: read the item description and load it into its
 		 * corresponding linked list, depending on the item type.
 		 */
+		err = NULL;
 		if (is_appointment) {
-			c = getc(data_file);
-			if (c == '!') {
+			ch = io_scan_getc(data);
+			if (ch == '!') {
 				state |= APOINT_NOTIFY;
-				while ((c = getc(data_file)) == ' ') ;
-				ungetc(c, data_file);
-			} else if (c == '|') {
+				io_scan_skip_blanks(data);
+			} else if (ch == '|') {
 				state = 0L;
-				while ((c = getc(data_file)) == ' ') ;
-				ungetc(c, data_file);
+				io_scan_skip_blanks(data);
 			} else {
-				io_load_error(path_apts, line,
-					      _("syntax error in item repetition"));
+				io_load_chunk_error(c, line,
+						    _("syntax error in item repetition"));
 			}
 			if (is_recursive) {
-				recur_apoint_scan(data_file, start, end,
-						  type, freq, until, notep,
-						  &exc, state, filter);
+				item = recur_apoint_scan(io_scan_line(data, buf,
+								      sizeof buf),
+							 start, end, type,
+							 freq, until, notep,
+							 &c->exc, state,
+							 filter, &err);
+				recur_exc_free(&c->exc);
+				if (item)
+					LLIST_ADD_SORTED(&c->recur_apts, item,
+							 recur_apoint_cmp);
 			} else {
-				apoint_scan(data_file, start, end, state,
-					    notep, filter);
+				item = apoint_scan(io_scan_line(data, buf,
+								sizeof buf),
+						   start, end, state, notep,
+						   filter, &err);
+				if (item)
+					LLIST_ADD_SORTED(&c->apts, item,
+							 apoint_cmp);
 			}
 		} else if (is_event) {
 			if (is_recursive) {
-				recur_event_scan(data_file, start, id,
-						 type, freq, until, notep,
-						 &exc, filter);
+				item = recur_event_scan(io_scan_line(data, buf,
+								     sizeof buf),
+							start, id, type, freq,
+							until, notep, &c->exc,
+							filter, &err);
+				recur_exc_free(&c->exc);
+				if (item)
+					LLIST_ADD_SORTED(&c->recur_events,
+							 item,
+							 recur_event_cmp);
 			} else {
-				event_scan(data_file, start, id, notep,
-					   filter);
+				item = event_scan(io_scan_line(data, buf,
+							       sizeof buf),
+						  start, id, notep, filter,
+						  &err);
+				if (item)
+					LLIST_ADD_SORTED(&c->events, item,
+							 event_cmp);
 			}
 		} else {
-			io_load_error(path_apts, line,
-				      _("wrong format in the appointment or event"));
+			io_load_chunk_error(c, line,
+					    _("wrong format in the appointment or event"));
 			/* NOTREACHED */
 		}
+		if (err)
+			io_load_chunk_error(c, 0, err);
 	}
-	file_close(data_file, __FILE_POS__);
+
+	/* Sort the items now, they are merged in io_load_app(). */
+	LLIST_BULK_SORT(&c->apts);
+	LLIST_BULK_SORT(&c->recur_apts);
+	LLIST_BULK_SORT(&c->events);
+	LLIST_BULK_SORT(&c->recur_events);
 }
 
-/* Load the todo data */
-void io_load_todo(struct item_filter *filter)
+static void *io_load_chunk_thread(void *arg)
+{
+	io_load_chunk(arg);
+	return NULL;
+}
+
+static void io_load_chunk_init(struct io_load_chunk *c, struct io_scan *data,
+			       const char *from, const char *to,
+			       struct item_filter *filter)
+{
+	c->data = *data;
+	c->data.p = from;
+	c->data.end = to;
+	c->filter = filter;
+	recur_exc_init(&c->exc);
+	c->threaded = 0;
+	c->failed = 0;
+	LLIST_INIT(&c->apts);
+	LLIST_INIT(&c->recur_apts);
+	LLIST_INIT(&c->events);
+	LLIST_INIT(&c->recur_events);
+	LLIST_BULK_BEGIN(&c->apts);
+	LLIST_BULK_BEGIN(&c->recur_apts);
+	LLIST_BULK_BEGIN(&c->events);
+	LLIST_BULK_BEGIN(&c->recur_events);
+}
+
+/* Drop the items of a chunk that could not be loaded completely. */
+static void io_load_chunk_free(struct io_load_chunk *c)
+{
+	recur_exc_free(&c->exc);
+	LLIST_FREE_INNER(&c->apts, apoint_free);
+	LLIST_FREE(&c->apts);
+	LLIST_FREE_INNER(&c->recur_apts, recur_apoint_free);
+	LLIST_FREE(&c->recur_apts);
+	LLIST_FREE_INNER(&c->events, event_free);
+	LLIST_FREE(&c->events);
+	LLIST_FREE_INNER(&c->recur_events, recur_event_free);
+	LLIST_FREE(&c->recur_events);
+}
+
+/* Get the number of chunks the appointments file is split into. */
+static unsigned io_load_nchunks(size_t size)
+{
+#ifdef CALCURSE_MEMORY_DEBUG
+	/* Allocation statistics are not thread-safe. */
+	return 1;
+#else
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t n = size / IO_LOAD_CHUNK_MIN;
+
+	if (ncpu < 1)
+		ncpu = 1;
+	if (n > (size_t)ncpu)
+		n = ncpu;
+
+	return n > 0 ? n : 1;
+#endif
+}
+
+/*
+ * Parse the appointment file. Large files are split at line boundaries into
+ * one chunk per processor, and the chunks are parsed concurrently. Items are
+ * sorted per chunk and added to the item lists, which must be in bulk mode, at
+ * the end. If sha1 is not NULL, the SHA1 of the file is computed on the way.
+ */
+static void io_load_app_chunks(struct io_scan *data,
+			       struct item_filter *filter, char *sha1)
+{
+	struct io_load_chunk *chunk;
+	sha1_ctx_t ctx;
+	pthread_t *thread;
+	const char *from, *to;
+	unsigned nchunks, i;
+	int failed = 0;
+
+	nchunks = io_load_nchunks(data->size);
+	chunk = mem_malloc(nchunks * sizeof(struct io_load_chunk));
+	for (i = 0, from = data->p; i < nchunks; i++, from = to) {
+		to = data->p + data->size / nchunks * (i + 1);
+		if (i == nchunks - 1) {
+			to = data->end;
+		} else {
+			if (to < from)
+				to = from;
+			to = memchr(to, '\n', data->end - to);
+			to = to ? to + 1 : data->end;
+		}
+		io_load_chunk_init(&chunk[i], data, from, to, filter);
+	}
+
+	if (nchunks > 1) {
+		thread = mem_malloc(nchunks * sizeof(pthread_t));
+		for (i = 0; i < nchunks; i++) {
+			chunk[i].threaded = 1;
+			pthread_create(&thread[i], NULL, io_load_chunk_thread,
+				       &chunk[i]);
+		}
+		if (sha1) {
+			/* Hash the file while the chunks are parsed. */
+			sha1_buffer(data->data, data->size, sha1);
+			sha1 = NULL;
+		}
+		for (i = 0; i < nchunks; i++) {
+			pthread_join(thread[i], NULL);
+			failed |= chunk[i].failed;
+		}
+		mem_free(thread);
+
+		/*
+		 * A chunk may also fail because an item spans several lines.
+		 * Parse the whole file at once to be sure.
+		 */
+		if (failed) {
+			for (i = 0; i < nchunks; i++)
+				io_load_chunk_free(&chunk[i]);
+			nchunks = 1;
+			io_load_chunk_init(&chunk[0], data, data->p,
+					   data->end, filter);
+		}
+	}
+	if (nchunks == 1) {
+		if (sha1)
+			io_scan_hash_init(&chunk[0].data, &ctx);
+		io_load_chunk(&chunk[0]);
+		if (sha1)
+			sha1_final_hex(&ctx, sha1);
+	}
+
+	/* Merge the sorted chunks into the item lists. */
+	for (i = 0; i < nchunks; i++) {
+		apoint_llist_splice(&chunk[i].apts);
+		recur_apoint_llist_splice(&chunk[i].recur_apts);
+		event_llist_splice(&chunk[i].events);
+		recur_event_llist_splice(&chunk[i].recur_events);
+	}
+	mem_free(chunk);
+}
+
+/* Changes to a data file read from its journal. */
+struct io_journal_replay {
+	struct io_scan adds;	/* items added, in the format of the file */
+	struct io_journal dels;	/* hashes of the items removed */
+	int stale;		/* the journal does not match the file */
+};
+
+static int io_hex_digit(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+static int io_hash_parse(const char *str, size_t len,
+			 uint8_t hash[SHA1_DIGESTLEN])
+{
+	int i, hi, lo;
+
+	if (len != SHA1_DIGESTLEN * 2)
+		return 0;
+	for (i = 0; i < SHA1_DIGESTLEN; i++) {
+		hi = io_hex_digit(str[2 * i]);
+		lo = io_hex_digit(str[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return 0;
+		hash[i] = hi << 4 | lo;
+	}
+
+	return 1;
+}
+
+/*
+ * Get the next record of a journal. Returns 0 at the end of the journal. An
+ * incomplete last record, left behind by an interrupted write, is ignored.
+ */
+static int io_journal_next(const char **p, const char *end, char *type,
+			   const char **str, size_t *len)
+{
+	const char *eol;
+
+	for (;;) {
+		if (*p >= end || !(eol = memchr(*p, '\n', end - *p)))
+			return 0;
+		*type = **p;
+		*str = *p + 1;
+		*len = eol - *str;
+		*p = eol + 1;
+		if (*len > 0 && (*type == '+' || *type == '-'))
+			return 1;
+	}
+}
+
+/*
+ * Read the journal of a data file with the given SHA1, whose items are listed
+ * by foreach. Removals of items that were added by the journal itself cancel
+ * out, so that the removals left only concern the items of the data file. If
+ * the journal is stale, the items it added that the file already has are
+ * skipped. Returns 0 if there is no journal.
+ */
+static int io_journal_read(const char *path, const char *sha1,
+			   io_foreach_fn_t foreach, struct io_journal_replay *r)
+{
+	struct io_scan j;
+	struct io_journal added, dels, cancelled, present;
+	struct string s;
+	uint8_t hash[SHA1_DIGESTLEN];
+	const char *p, *str;
+	char *path_journal, *buf, type;
+	size_t len, magic_len = strlen(IO_JOURNAL_MAGIC), hash_len;
+	size_t size = 0, k;
+	int ret;
+
+	asprintf(&path_journal, "%s" IO_JOURNAL_EXT, path);
+	ret = io_scan_open(&j, path_journal, NULL);
+	mem_free(path_journal);
+	if (!ret)
+		return 0;
+
+	hash_len = SHA1_DIGESTLEN * 2;
+	if (j.size < magic_len + hash_len + 1 ||
+	    memcmp(j.data, IO_JOURNAL_MAGIC, magic_len) ||
+	    j.data[magic_len + hash_len] != '\n') {
+		io_scan_close(&j);
+		return 0;
+	}
+	r->stale = memcmp(j.data + magic_len, sha1, hash_len) != 0;
+	j.p += magic_len + hash_len + 1;
+
+	memset(&added, 0, sizeof(added));
+	memset(&dels, 0, sizeof(dels));
+	memset(&cancelled, 0, sizeof(cancelled));
+	memset(&present, 0, sizeof(present));
+	memset(&r->dels, 0, sizeof(r->dels));
+
+	if (r->stale) {
+		string_init(&s);
+		foreach(&s, io_save_item, &present);
+		mem_free(s.buf);
+		io_journal_sort(&present);
+	}
+
+	for (p = j.p; io_journal_next(&p, j.end, &type, &str, &len);) {
+		if (type == '+') {
+			io_item_hash(str, len, hash);
+			io_journal_add(&added, hash);
+			size += len + 1;
+		} else if (io_hash_parse(str, len, hash)) {
+			io_journal_add(&dels, hash);
+		}
+	}
+	io_journal_sort(&added);
+	io_journal_sort(&dels);
+
+	for (k = 0; k < dels.n; k++) {
+		if (io_journal_see(&added, dels.hash[k]))
+			io_journal_add(&cancelled, dels.hash[k]);
+		else
+			io_journal_add(&r->dels, dels.hash[k]);
+	}
+	io_journal_sort(&cancelled);
+	io_journal_sort(&r->dels);
+
+	buf = mem_malloc(size > 0 ? size : 1);
+	size = 0;
+	for (p = j.p; io_journal_next(&p, j.end, &type, &str, &len);) {
+		if (type != '+')
+			continue;
+		io_item_hash(str, len, hash);
+		if (io_journal_see(&cancelled, hash) ||
+		    (r->stale && io_journal_see(&present, hash)))
+			continue;
+		memcpy(buf + size, str, len);
+		buf[size + len] = '\n';
+		size += len + 1;
+	}
+	io_scan_close(&j);
+	io_journal_free(&added);
+	io_journal_free(&dels);
+	io_journal_free(&cancelled);
+	io_journal_free(&present);
+
+	r->adds.data = buf;
+	r->adds.size = size;
+	r->adds.mapped = 0;
+	r->adds.p = buf;
+	r->adds.end = buf + size;
+	r->adds.sha1 = NULL;
+	r->adds.hashed = buf;
+
+	return 1;
+}
+
+static void io_journal_replay_free(struct io_journal_replay *r)
+{
+	io_scan_close(&r->adds);
+	io_journal_free(&r->dels);
+}
+
+/* Match the items removed by a journal, each of them once. */
+static int io_journal_match(const char *str, void *arg)
+{
+	uint8_t hash[SHA1_DIGESTLEN];
+
+	io_item_hash(str, strlen(str), hash);
+	return io_journal_see(arg, hash);
+}
+
+static void io_load_app_begin(void)
+{
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_BULK_BEGIN(&alist_p);
+	LLIST_TS_UNLOCK(&alist_p);
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_BULK_BEGIN(&recur_alist_p);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+	LLIST_BULK_BEGIN(&eventlist);
+	LLIST_BULK_BEGIN(&recur_elist);
+	mem_arena_begin();
+}
+
+static void io_load_app_end(void)
+{
+	mem_arena_end();
+
+	LLIST_TS_LOCK(&alist_p);
+	LLIST_TS_BULK_END(&alist_p);
+	LLIST_TS_UNLOCK(&alist_p);
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_BULK_END(&recur_alist_p);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+	LLIST_BULK_END(&eventlist);
+	LLIST_BULK_END(&recur_elist);
+}
+
+/*
+ * Load the appointment file, from its snapshot if it is up to date and all
+ * items are loaded.
+ */
+void io_load_app(struct item_filter *filter)
+{
+	struct io_scan data, snap_data;
+	struct io_snap_header h;
+	struct io_journal_replay r;
+	int snap = 0, loaded = 0;
+
+	io_scan_open(&data, path_apts, _("failed to open appointment file"));
+	io_load_app_begin();
+
+	/* The hash is needed upfront only to check a snapshot. */
+	if (io_filter_is_empty(filter, IO_SNAP_APTS))
+		snap = io_snap_open(&snap_data, &h, path_apts, IO_SNAP_APTS);
+	if (snap) {
+		sha1_buffer(data.data, data.size, apts_sha1);
+		loaded = io_snap_load(&snap_data, &h, apts_sha1);
+	}
+	if (!loaded)
+		io_load_app_chunks(&data, filter, snap ? NULL : apts_sha1);
+	io_file_stat_set(&apts_stat, &data.st);
+
+	io_scan_close(&data);
+	io_load_app_end();
+
+	if (!loaded && io_filter_is_empty(filter, IO_SNAP_APTS) && !read_only)
+		io_snap_save(path_apts, IO_SNAP_APTS, apts_sha1);
+
+	/* The snapshot is of the data file alone, replay the journal now. */
+	io_journal_free(&apts_journal);
+	if (io_journal_read(path_apts, apts_sha1, io_apts_foreach, &r)) {
+		apts_journal.pending = 1;
+		apts_journal.stale = r.stale;
+		if (r.dels.n > 0) {
+			recur_event_llist_drop(io_journal_match, &r.dels);
+			recur_apoint_llist_drop(io_journal_match, &r.dels);
+			apoint_llist_drop(io_journal_match, &r.dels);
+			event_llist_drop(io_journal_match, &r.dels);
+		}
+		if (r.adds.size > 0) {
+			io_load_app_begin();
+			io_load_app_chunks(&r.adds, filter, NULL);
+			io_load_app_end();
+		}
+		io_journal_replay_free(&r);
+	}
+}
+
+/*
+ * Parse todo items, in the format of the todo file, and add them to the list
+ * of todo items. Errors are reported against the given file.
+ */
+static void io_load_todo_scan(struct io_scan *data, struct item_filter *filter,
+			      const char *path)
 {
-	FILE *data_file;
-	char *newline;
-	int nb_tod = 0;
 	int c, id, completed;
 	char buf[BUFSIZ], e_todo[BUFSIZ], note[MAX_NOTESIZ + 1];
 	unsigned line = 0;
 
-	data_file = fopen(path_todo, "r");
-	EXIT_IF(data_file == NULL, _("failed to open todo file"));
-
-	sha1_stream(data_file, todo_sha1);
-	rewind(data_file);
-
 	for (;;) {
+		io_scan_hash(data);
 		line++;
-		c = getc(data_file);
+		c = io_scan_getc(data);
 		if (c == EOF) {
 			break;
 		} else if (c == '[') {
 			/* new style with id */
-			c = getc(data_file);
+			c = io_scan_getc(data);
 			if (c == '-') {
 				completed = 1;
 			} else {
 				completed = 0;
-				ungetc(c, data_file);
+				io_scan_ungetc(data, c);
 			}
-			if (fscanf(data_file, " %d ", &id) != 1
-			    || getc(data_file) != ']')
-				io_load_error(path_todo, line,
+			if (!io_scan_int(data, &id))
+				io_load_error(path, line,
 					      _("syntax error in item identifier"));
-			while ((c = getc(data_file)) == ' ') ;
-			ungetc(c, data_file);
+			io_scan_space(data);
+			if (!io_scan_char(data, ']'))
+				io_load_error(path, line,
+					      _("syntax error in item identifier"));
+			io_scan_skip_blanks(data);
 		} else {
 			id = 9;
 			completed = 0;
-			ungetc(c, data_file);
+			io_scan_ungetc(data, c);
 		}
 		/* Now read the attached note, if any. */
-		c = getc(data_file);
-		if (c == '>') {
-			note_read(note, data_file);
-		} else {
+		if (io_scan_char(data, '>'))
+			io_scan_note(data, note);
+		else
 			note[0] = '\0';
-			ungetc(c, data_file);
-		}
 		/* Then read todo description. */
-		if (!fgets(buf, sizeof buf, data_file))
+		if (!io_scan_line(data, buf, sizeof buf))
 			buf[0] = '\0';
-		newline = strchr(buf, '\n');
-		if (newline)
-			*newline = '\0';
 		io_extract_data(e_todo, buf, sizeof buf);
 
 		/* Filter item. */
@@ -885,17 +2560,63 @@ void io_load_todo(struct item_filter *filter)
 		/* Filter by hash. */
 		if (filter && filter->hash) {
 			char *hash = todo_hash(todo);
-			if (!hash_matches(filter->hash, hash)) {
+			if (!hash_matches(filter->hash, hash))
 				todo_delete(todo);
-				todo = NULL;
-			}
 			mem_free(hash);
 		}
+	}
+}
+
+/* Load the todo data */
+void io_load_todo(struct item_filter *filter)
+{
+	struct io_scan data, snap_data;
+	struct io_snap_header h;
+	struct io_journal_replay r;
+	sha1_ctx_t ctx;
+	int snap = 0, loaded = 0;
+
+	io_scan_open(&data, path_todo, _("failed to open todo file"));
+
+	LLIST_BULK_BEGIN(&todolist);
+	mem_arena_begin();
+
+	/* The hash is needed upfront only to check a snapshot. */
+	if (io_filter_is_empty(filter, IO_SNAP_TODO))
+		snap = io_snap_open(&snap_data, &h, path_todo, IO_SNAP_TODO);
+	if (snap) {
+		sha1_buffer(data.data, data.size, todo_sha1);
+		loaded = io_snap_load(&snap_data, &h, todo_sha1);
+	} else {
+		io_scan_hash_init(&data, &ctx);
+	}
 
-		if (todo)
-			++nb_tod;
+	if (!loaded)
+		io_load_todo_scan(&data, filter, path_todo);
+	if (!snap)
+		sha1_final_hex(&ctx, todo_sha1);
+	io_file_stat_set(&todo_stat, &data.st);
+	io_scan_close(&data);
+	mem_arena_end();
+
+	LLIST_BULK_END(&todolist);
+
+	if (!loaded && io_filter_is_empty(filter, IO_SNAP_TODO) && !read_only)
+		io_snap_save(path_todo, IO_SNAP_TODO, todo_sha1);
+
+	io_journal_free(&todo_journal);
+	if (io_journal_read(path_todo, todo_sha1, io_todo_foreach, &r)) {
+		todo_journal.pending = 1;
+		todo_journal.stale = r.stale;
+		if (r.dels.n > 0)
+			todo_llist_drop(io_journal_match, &r.dels);
+		if (r.adds.size > 0) {
+			LLIST_BULK_BEGIN(&todolist);
+			io_load_todo_scan(&r.adds, filter, path_todo);
+			LLIST_BULK_END(&todolist);
+		}
+		io_journal_replay_free(&r);
 	}
-	file_close(data_file, __FILE_POS__);
 }
 
 /* Load appointments and todo items */
@@ -915,7 +2636,7 @@ int io_reload_data(void)
 	const char *enter = _("Press [ENTER] to continue");
 	int ret = 0;
 
-	if (io_get_modified()) {
+	if (io_get_modified() & IO_MODIFIED_DATA) {
 		const char *msg_um_prefix =
 				_("There are unsaved modifications:");
 		const char *msg_um_discard = _("(d)iscard");
@@ -945,7 +2666,7 @@ int io_reload_data(void)
 	if (!io_check_data_files_modified())
 		goto cleanup;
 
-	if (notify_bar())
+	if (ui_mode == UI_CURSES && notify_bar())
 		notify_stop_main_thread();
 
 	/* Reinitialize data structures. */
@@ -954,6 +2675,8 @@ int io_reload_data(void)
 	recur_apoint_llist_free();
 	recur_event_llist_free();
 	todo_free_list();
+	ui_day_item_cut_migrate();
+	mem_arena_drop();
 
 	apoint_llist_init();
 	event_llist_init();
@@ -964,24 +2687,28 @@ int io_reload_data(void)
 	/*
 	 * Temporarily reinitialize the todo list box without any items to make
 	 * sure wins_unprepare_external() does not fail when it is called after
-	 * executing the pre-load hook.
+	 * executing the pre-load hook. The daemon has no list boxes.
 	 */
-	ui_todo_load_items();
-	ui_todo_sel_reset();
+	if (ui_mode == UI_CURSES) {
+		ui_todo_load_items();
+		ui_todo_sel_reset();
+	}
 
 	io_load_data(NULL);
 	run_hook("post-load");
 
-	io_unset_modified();
-	ui_todo_load_items();
-	ui_todo_sel_reset();
+	io_unset_modified(IO_MODIFIED_DATA);
+	if (ui_mode == UI_CURSES) {
+		ui_todo_load_items();
+		ui_todo_sel_reset();
+	}
 
-	if (show_dialogs()) {
+	if (ui_mode == UI_CURSES && show_dialogs()) {
 		status_mesg(reload_success, enter);
 		keys_wait_for_any_key(win[KEY].p);
 	}
 
-	if (notify_bar())
+	if (ui_mode == UI_CURSES && notify_bar())
 		notify_start_main_thread();
 
 	ret = 1;
@@ -991,25 +2718,9 @@ cleanup:
 	return ret;
 }
 
-static void
-load_keys_ht_getkey(struct ht_keybindings_s *data, const char **key,
-		    int *len)
-{
-	*key = data->label;
-	*len = strlen(data->label);
-}
-
-static int
-load_keys_ht_compare(struct ht_keybindings_s *data1,
-		     struct ht_keybindings_s *data2)
+static const char *io_key_label_get(struct io_key_label *data)
 {
-	const int KEYLEN = strlen(data1->label);
-
-	if (strlen(data2->label) == KEYLEN
-	    && !memcmp(data1->label, data2->label, KEYLEN))
-		return 0;
-	else
-		return 1;
+	return data->label;
 }
 
 /*
@@ -1031,7 +2742,8 @@ static int is_blank(int c)
  */
 void io_load_keys(const char *pager)
 {
-	struct ht_keybindings_s keys[NBKEYS];
+	struct io_key_label keys[NBKEYS];
+	hashmap_t labels;
 	FILE *keyfp;
 	char buf[BUFSIZ];
 	struct io_file *log;
@@ -1040,12 +2752,11 @@ void io_load_keys(const char *pager)
 
 	keys_init();
 
-	struct ht_keybindings ht_keys = HTABLE_INITIALIZER(&ht_keys);
-
+	HASHMAP_INIT(&labels, NBKEYS, io_key_label_get);
 	for (i = 0; i < NBKEYS; i++) {
 		keys[i].key = (enum key)i;
 		keys[i].label = keys_get_label((enum key)i);
-		HTABLE_INSERT(ht_keybindings, &ht_keys, &keys[i]);
+		HASHMAP_ADD(&labels, &keys[i]);
 	}
 
 	keyfp = fopen(path_keys, "r");
@@ -1055,7 +2766,7 @@ void io_load_keys(const char *pager)
 	skipped = loaded = line = 0;
 	while (fgets(buf, BUFSIZ, keyfp) != NULL) {
 		char key_label[BUFSIZ], *p;
-		struct ht_keybindings_s *ht_elm, ht_entry;
+		struct io_key_label *label;
 		const int AWAITED = 1;
 		int assigned;
 
@@ -1086,11 +2797,9 @@ void io_load_keys(const char *pager)
 		if (strcmp(key_label, "generic-cut") == 0)
 			continue;
 
-		ht_entry.label = key_label;
 		p = buf + strlen(key_label) + 1;
-		ht_elm =
-		    HTABLE_LOOKUP(ht_keybindings, &ht_keys, &ht_entry);
-		if (!ht_elm) {
+		label = HASHMAP_GET(&labels, key_label);
+		if (!label) {
 			skipped++;
 			io_log_print(log, line,
 				     _("Key label not recognized"));
@@ -1119,10 +2828,8 @@ void io_load_keys(const char *pager)
 				} else {
 					int used;
 
-					used =
-					    keys_assign_binding(ch,
-								ht_elm->
-								key);
+					used = keys_assign_binding(ch,
+								   label->key);
 					if (used) {
 						char *already_assigned;
 
@@ -1145,6 +2852,7 @@ void io_load_keys(const char *pager)
 			}
 		}
 	}
+	HASHMAP_FREE(&labels);
 	file_close(keyfp, __FILE_POS__);
 	file_close(log->fd, __FILE_POS__);
 	if (skipped > 0) {
@@ -1394,6 +3102,11 @@ void io_import_data(enum import_type type, const char *stream_name,
 	if (stream != stdin)
 		file_close(stream, __FILE_POS__);
 
+	if (stats.apoints > 0 || stats.events > 0)
+		io_set_modified(IO_MODIFIED_APTS);
+	if (stats.todos > 0)
+		io_set_modified(IO_MODIFIED_TODO);
+
 	asprintf(&stats_str[0], ngettext("%d app", "%d apps", stats.apoints),
 		 stats.apoints);
 	asprintf(&stats_str[1],
@@ -1512,7 +3225,7 @@ static void *io_psave_thread(void *arg)
 
 	for (;;) {
 		sleep(delay * MININSEC);
-		io_save_cal(IO_SAVE_DISPLAY_NONE);
+		io_save_data(IO_SAVE_DISPLAY_NONE, 1);
 	}
 }
 
@@ -1537,6 +3250,197 @@ void io_stop_psave_thread(void)
 	io_t_psave = pthread_self();
 }
 
+/*
+ * Watch the data files for changes made by other programs. The directories
+ * containing the files are watched, so that files replaced by a rename are
+ * noticed as well.
+ */
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* Changes closer together than this, in milliseconds, are merged. */
+#define IO_WATCH_DELAY 500
+
+static int io_watch_fd = -1;
+static int io_watch_wd_apts, io_watch_wd_todo;
+static const char *io_watch_name_apts, *io_watch_name_todo;
+static pthread_t io_t_main;
+
+static int io_watch_add(const char *path, const char **name)
+{
+	char *dir, *p;
+	int wd;
+
+	dir = mem_strdup(path);
+	p = strrchr(dir, '/');
+	if (p) {
+		*name = path + (p - dir) + 1;
+		if (p == dir)
+			p[1] = '\0';
+		else
+			*p = '\0';
+	} else {
+		*name = path;
+		strcpy(dir, ".");
+	}
+
+	wd = inotify_add_watch(io_watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	mem_free(dir);
+
+	return wd;
+}
+
+/* Start watching the data files. Returns 0 if they cannot be watched. */
+int io_watch_init(void)
+{
+	if (io_watch_fd >= 0)
+		return 1;
+
+	io_watch_fd = inotify_init();
+	if (io_watch_fd < 0)
+		return 0;
+
+	io_watch_wd_apts = io_watch_add(path_apts, &io_watch_name_apts);
+	io_watch_wd_todo = io_watch_add(path_todo, &io_watch_name_todo);
+	if (io_watch_wd_apts < 0 || io_watch_wd_todo < 0) {
+		io_watch_free();
+		return 0;
+	}
+
+	return 1;
+}
+
+void io_watch_free(void)
+{
+	if (io_watch_fd < 0)
+		return;
+	close(io_watch_fd);
+	io_watch_fd = -1;
+}
+
+static int io_watch_match(const struct inotify_event *ev)
+{
+	if (ev->len == 0)
+		return 0;
+	if (ev->wd == io_watch_wd_apts &&
+	    strcmp(ev->name, io_watch_name_apts) == 0)
+		return 1;
+	if (ev->wd == io_watch_wd_todo &&
+	    strcmp(ev->name, io_watch_name_todo) == 0)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Wait up to the given number of seconds, or indefinitely if it is negative,
+ * for one of the data files to change. Changes in quick succession, such as
+ * another program saving both files, are reported once. Returns 1 if a data
+ * file changed, and 0 on timeout or if the wait was interrupted by a signal.
+ */
+int io_watch_wait(int timeout)
+{
+	/* Aligned for the events, room for a few with the longest name. */
+	long events[8 * (sizeof(struct inotify_event) + NAME_MAX + 1) /
+		    sizeof(long)];
+	struct pollfd pfd;
+	const struct inotify_event *ev;
+	const char *p;
+	ssize_t len;
+	int changed = 0;
+
+	if (io_watch_fd < 0) {
+		if (timeout >= 0)
+			psleep(timeout);
+		return 0;
+	}
+
+	pfd.fd = io_watch_fd;
+	pfd.events = POLLIN;
+	for (;;) {
+		if (poll(&pfd, 1, changed ? IO_WATCH_DELAY :
+			 timeout < 0 ? -1 : timeout * 1000) <= 0)
+			return changed;
+
+		len = read(io_watch_fd, events, sizeof(events));
+		if (len <= 0)
+			return changed;
+		for (p = (const char *)events; p < (const char *)events + len;
+		     p += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (io_watch_match(ev))
+				changed = 1;
+		}
+	}
+}
+
+/* Thread used to reload the data files when they change. */
+static void *io_watch_thread(void *arg)
+{
+	int state;
+
+	for (;;) {
+		if (!io_watch_wait(-1))
+			continue;
+		/* Do not get cancelled while holding the I/O mutex. */
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		if (io_check_data_files_modified())
+			pthread_kill(io_t_main, SIGUSR1);
+		pthread_setcancelstate(state, NULL);
+	}
+
+	return NULL;
+}
+
+/* Launch the thread which reloads changed data files. */
+void io_start_watch_thread(void)
+{
+	if (!io_watch_init())
+		return;
+	io_t_main = pthread_self();
+	pthread_create(&io_t_watch, NULL, io_watch_thread, NULL);
+}
+
+/* Stop watching the data files. */
+void io_stop_watch_thread(void)
+{
+	/* Is the thread running? */
+	if (pthread_equal(io_t_watch, pthread_self()))
+		return;
+
+	pthread_cancel(io_t_watch);
+	pthread_join(io_t_watch, NULL);
+	io_t_watch = pthread_self();
+	io_watch_free();
+}
+
+#else /* HAVE_SYS_INOTIFY_H */
+
+int io_watch_init(void)
+{
+	return 0;
+}
+
+void io_watch_free(void)
+{
+}
+
+int io_watch_wait(int timeout)
+{
+	if (timeout >= 0)
+		psleep(timeout);
+	return 0;
+}
+
+void io_start_watch_thread(void)
+{
+}
+
+void io_stop_watch_thread(void)
+{
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
+
 /*
  * This sets a lock file to prevent from having two different instances of
  * calcurse running.
@@ -1696,16 +3600,19 @@ int io_file_cp(const char *src, const char *dst)
 	return 1;
 }
 
-void io_unset_modified(void)
+/* Mark the given files, a mask of IO_MODIFIED_*, as saved. */
+void io_unset_modified(int files)
 {
-	modified = 0;
+	modified &= ~files;
 }
 
-void io_set_modified(void)
+/* Mark the given files, a mask of IO_MODIFIED_*, as needing to be saved. */
+void io_set_modified(int files)
 {
-	modified = 1;
+	modified |= files;
 }
 
+/* Get the mask of the files with unsaved modifications. */
 int io_get_modified(void)
 {
 	return modified;
@@ -34,8 +34,13 @@
  *
  */
 
+#include <stdint.h>
+
 #include "calcurse.h"
 
+#define SKIP_NEXT(i, k) ((i)->skip[2 * (k)])
+#define SKIP_PREV(i, k) ((i)->skip[2 * (k) + 1])
+
 /*
  * Initialize a list.
  */
@@ -43,6 +48,16 @@ void llist_init(llist_t * l)
 {
 	l->head = NULL;
 	l->tail = NULL;
+	l->skip = NULL;
+	l->bulk = 0;
+	l->bulk_cmp = NULL;
+}
+
+static void llist_item_free(llist_item_t * i)
+{
+	if (i->skip)
+		mem_free(i->skip);
+	mem_free(i);
 }
 
 /*
@@ -54,11 +69,16 @@ void llist_free(llist_t * l)
 
 	for (i = l->head; i; i = t) {
 		t = i->next;
-		mem_free(i);
+		llist_item_free(i);
 	}
 
 	l->head = NULL;
 	l->tail = NULL;
+	if (l->skip)
+		mem_free(l->skip);
+	l->skip = NULL;
+	l->bulk = 0;
+	l->bulk_cmp = NULL;
 }
 
 /*
@@ -129,78 +149,321 @@ void *llist_get_data(llist_item_t * i)
 	return i ? i->data : NULL;
 }
 
+static llist_item_t *llist_item_new(void *data)
+{
+	llist_item_t *o = mem_malloc(sizeof(llist_item_t));
+
+	o->data = data;
+	o->next = NULL;
+	o->prev = NULL;
+	o->skip = NULL;
+	o->height = 0;
+
+	return o;
+}
+
+/* Insert an item after another one (or at the head if there is none). */
+static void llist_link(llist_t * l, llist_item_t * o, llist_item_t * after)
+{
+	o->prev = after;
+	o->next = after ? after->next : l->head;
+	if (o->next)
+		o->next->prev = o;
+	else
+		l->tail = o;
+	if (after)
+		after->next = o;
+	else
+		l->head = o;
+}
+
+/*
+ * Choose the number of upper levels an item is linked into. Each level is
+ * used by a quarter of the items of the level below. The item address serves
+ * as a source of randomness, which avoids any global state.
+ */
+static unsigned llist_skip_height(llist_item_t * o)
+{
+	uint64_t h = (uint64_t)(uintptr_t)o;
+	unsigned height = 0;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	while (height < LLIST_SKIP_LEVELS && (h & 3) == 0) {
+		height++;
+		h >>= 2;
+	}
+
+	return height;
+}
+
+/* Link an item into the upper levels, after the given predecessors. */
+static void llist_skip_link(llist_t * l, llist_item_t * o,
+			    llist_item_t ** update)
+{
+	struct llist_skip *sk = l->skip;
+	unsigned k;
+
+	o->height = llist_skip_height(o);
+	if (o->height == 0)
+		return;
+	o->skip = mem_calloc(2 * o->height, sizeof(llist_item_t *));
+
+	for (k = 0; k < o->height; k++) {
+		llist_item_t *after = update[k];
+
+		SKIP_PREV(o, k) = after;
+		SKIP_NEXT(o, k) = after ? SKIP_NEXT(after, k) : sk->head[k];
+		if (SKIP_NEXT(o, k))
+			SKIP_PREV(SKIP_NEXT(o, k), k) = o;
+		else
+			sk->tail[k] = o;
+		if (after)
+			SKIP_NEXT(after, k) = o;
+		else
+			sk->head[k] = o;
+	}
+}
+
+/* Remove an item from the upper levels. */
+static void llist_skip_unlink(llist_t * l, llist_item_t * o)
+{
+	struct llist_skip *sk = l->skip;
+	unsigned k;
+
+	for (k = 0; k < o->height; k++) {
+		if (SKIP_PREV(o, k))
+			SKIP_NEXT(SKIP_PREV(o, k), k) = SKIP_NEXT(o, k);
+		else
+			sk->head[k] = SKIP_NEXT(o, k);
+		if (SKIP_NEXT(o, k))
+			SKIP_PREV(SKIP_NEXT(o, k), k) = SKIP_PREV(o, k);
+		else
+			sk->tail[k] = SKIP_PREV(o, k);
+	}
+
+	mem_free(o->skip);
+	o->skip = NULL;
+	o->height = 0;
+}
+
 /*
  * Add an item at the end of a list.
  */
 void llist_add(llist_t * l, void *data)
 {
-	llist_item_t *o = mem_malloc(sizeof(llist_item_t));
+	llist_link(l, llist_item_new(data), l->tail);
+}
 
-	if (o) {
-		o->data = data;
-		o->next = NULL;
+/*
+ * Add an item to a sorted list. The item is inserted after all items that
+ * compare equal to it.
+ */
+void llist_add_sorted(llist_t * l, void *data, llist_fn_cmp_t fn_cmp)
+{
+	llist_item_t *o, *i, *n;
+	llist_item_t *update[LLIST_SKIP_LEVELS];
+	int k;
+
+	if (l->bulk) {
+		l->bulk_cmp = fn_cmp;
+		llist_add(l, data);
+		return;
+	}
 
-		if (!l->head) {
-			l->head = l->tail = o;
-		} else {
-			l->tail->next = o;
-			l->tail = o;
+	if (!l->skip)
+		l->skip = mem_calloc(1, sizeof(struct llist_skip));
+
+	o = llist_item_new(data);
+
+	if (!l->tail || fn_cmp(data, l->tail->data) >= 0) {
+		/* Fast path for items added in order. */
+		for (k = 0; k < LLIST_SKIP_LEVELS; k++)
+			update[k] = l->skip->tail[k];
+		i = l->tail;
+	} else {
+		i = NULL;
+		for (k = LLIST_SKIP_LEVELS - 1; k >= 0; k--) {
+			n = i ? SKIP_NEXT(i, k) : l->skip->head[k];
+			while (n && fn_cmp(data, n->data) >= 0) {
+				i = n;
+				n = SKIP_NEXT(i, k);
+			}
+			update[k] = i;
+		}
+		n = i ? i->next : l->head;
+		while (n && fn_cmp(data, n->data) >= 0) {
+			i = n;
+			n = i->next;
 		}
 	}
+
+	llist_link(l, o, i);
+	llist_skip_link(l, o, update);
 }
 
 /*
- * Add an item to a sorted list.
+ * Remove an item from a list.
  */
-void llist_add_sorted(llist_t * l, void *data, llist_fn_cmp_t fn_cmp)
+void llist_remove(llist_t * l, llist_item_t * i)
+{
+	if (!i)
+		return;
+
+	if (i->height > 0)
+		llist_skip_unlink(l, i);
+
+	if (i->prev)
+		i->prev->next = i->next;
+	else
+		l->head = i->next;
+	if (i->next)
+		i->next->prev = i->prev;
+	else
+		l->tail = i->prev;
+
+	mem_free(i);
+}
+
+/*
+ * Start loading a large number of items into a list. Until llist_bulk_end()
+ * is called, sorted insertions simply append items to the list.
+ */
+void llist_bulk_begin(llist_t * l)
 {
-	llist_item_t *o = mem_malloc(sizeof(llist_item_t));
 	llist_item_t *i;
 
-	if (o) {
-		o->data = data;
-		o->next = NULL;
-
-		if (!l->head) {
-			l->head = l->tail = o;
-		} else if (fn_cmp(o->data, l->tail->data) >= 0) {
-			l->tail->next = o;
-			l->tail = o;
-		} else if (fn_cmp(o->data, l->head->data) < 0) {
-			o->next = l->head;
-			l->head = o;
+	for (i = l->head; i; i = i->next) {
+		if (i->skip)
+			mem_free(i->skip);
+		i->skip = NULL;
+		i->height = 0;
+	}
+	if (l->skip)
+		mem_free(l->skip);
+	l->skip = NULL;
+
+	l->bulk = 1;
+	l->bulk_cmp = NULL;
+}
+
+/* Merge two sorted chains of items, preferring items from the first one. */
+static llist_item_t *llist_merge(llist_item_t * a, llist_item_t * b,
+				 llist_fn_cmp_t fn_cmp)
+{
+	llist_item_t *head = NULL, **tail = &head;
+
+	while (a && b) {
+		if (fn_cmp(b->data, a->data) < 0) {
+			*tail = b;
+			b = b->next;
 		} else {
-			i = l->head;
-			while (i->next
-			       && fn_cmp(o->data, i->next->data) >= 0)
-				i = i->next;
-			o->next = i->next;
-			i->next = o;
+			*tail = a;
+			a = a->next;
 		}
+		tail = &(*tail)->next;
 	}
+	*tail = a ? a : b;
+
+	return head;
 }
 
 /*
- * Remove an item from a list.
+ * Sort the items of a list using a stable bottom-up merge sort, so that
+ * items comparing equal keep the order they were added in. Runs of items that
+ * are already in order are merged as a whole, which makes merging lists that
+ * were sorted separately cheap.
  */
-void llist_remove(llist_t * l, llist_item_t * i)
+static void llist_sort(llist_t * l, llist_fn_cmp_t fn_cmp)
 {
-	llist_item_t *j = NULL;
+	llist_item_t *bins[64] = { NULL };
+	llist_item_t *i, *n, *chain;
+	unsigned k, nbins = 0;
+
+	for (i = l->head; i; i = n) {
+		chain = i;
+		for (n = i->next; n && fn_cmp(n->data, i->data) >= 0;
+		     n = n->next)
+			i = n;
+		i->next = NULL;
+		for (k = 0; k < nbins && bins[k]; k++) {
+			chain = llist_merge(bins[k], chain, fn_cmp);
+			bins[k] = NULL;
+		}
+		if (k == nbins)
+			nbins++;
+		bins[k] = chain;
+	}
 
-	if (l->head && i == l->head) {
-		l->head = i->next;
-	} else {
-		for (j = l->head; j && j->next != i; j = j->next) ;
+	chain = NULL;
+	for (k = 0; k < nbins; k++) {
+		if (bins[k])
+			chain = llist_merge(bins[k], chain, fn_cmp);
 	}
 
-	if (i) {
-		if (j)
-			j->next = i->next;
-		if (i == l->tail)
-			l->tail = j;
+	l->head = chain;
+	l->tail = NULL;
+	for (i = chain; i; i = i->next) {
+		i->prev = l->tail;
+		l->tail = i;
+	}
+}
+
+/*
+ * Sort the items added to a list in bulk mode so far, without leaving bulk
+ * mode. Lists that are not shared can be sorted concurrently.
+ */
+void llist_bulk_sort(llist_t * l)
+{
+	if (l->bulk && l->bulk_cmp)
+		llist_sort(l, l->bulk_cmp);
+}
 
-		mem_free(i);
+/*
+ * Move all items of a list in bulk mode to the end of another list in bulk
+ * mode. The source list is left empty.
+ */
+void llist_bulk_splice(llist_t * l, llist_t * src)
+{
+	if (!src->head)
+		return;
+
+	if (l->tail) {
+		l->tail->next = src->head;
+		src->head->prev = l->tail;
+	} else {
+		l->head = src->head;
 	}
+	l->tail = src->tail;
+	if (src->bulk_cmp)
+		l->bulk_cmp = src->bulk_cmp;
+
+	src->head = NULL;
+	src->tail = NULL;
+}
+
+/*
+ * Finish a bulk load: sort the list once and rebuild its index.
+ */
+void llist_bulk_end(llist_t * l)
+{
+	llist_item_t *i;
+
+	if (!l->bulk)
+		return;
+	l->bulk = 0;
+
+	if (!l->bulk_cmp)
+		return;
+
+	llist_sort(l, l->bulk_cmp);
+	l->bulk_cmp = NULL;
+
+	l->skip = mem_calloc(1, sizeof(struct llist_skip));
+	for (i = l->head; i; i = i->next)
+		llist_skip_link(l, i, l->skip->tail);
 }
 
 /*
@@ -226,6 +489,38 @@ llist_item_t *llist_find_first(llist_t * l, void *data,
 	return NULL;
 }
 
+/*
+ * Find the item holding the given data in a list sorted with respect to
+ * fn_cmp. Falls back to a linear search if the data cannot be found at its
+ * expected position, e.g. because its sort key was changed in place.
+ */
+llist_item_t *llist_find_sorted(llist_t * l, void *data,
+				llist_fn_cmp_t fn_cmp)
+{
+	llist_item_t *i = NULL, *n;
+	int k;
+
+	if (!l->skip || l->bulk)
+		return llist_find_first(l, data, NULL);
+
+	for (k = LLIST_SKIP_LEVELS - 1; k >= 0; k--) {
+		n = i ? SKIP_NEXT(i, k) : l->skip->head[k];
+		while (n && fn_cmp(n->data, data) < 0) {
+			i = n;
+			n = SKIP_NEXT(i, k);
+		}
+	}
+
+	for (n = i ? i->next : l->head; n; n = n->next) {
+		if (n->data == data)
+			return n;
+		if (fn_cmp(n->data, data) > 0)
+			break;
+	}
+
+	return llist_find_first(l, data, NULL);
+}
+
 /*
  * Find the next item matched by some filter callback.
  */
@@ -34,20 +34,41 @@
  *
  */
 
-/* Linked lists. */
+/*
+ * Linked lists.
+ *
+ * Lists that are kept sorted using llist_add_sorted() are additionally
+ * indexed by a skip list: every item may be linked into a number of express
+ * lanes on top of the regular list, which makes sorted insertions run in
+ * logarithmic time. Iterating over a list is not affected by the index.
+ */
+#define LLIST_SKIP_LEVELS 16
+
 typedef struct llist_item llist_item_t;
 struct llist_item {
 	struct llist_item *next;
 	void *data;
+	struct llist_item *prev;
+	struct llist_item **skip;	/* next/prev pairs for upper levels */
+	unsigned height;		/* number of upper levels */
+};
+
+struct llist_skip {
+	struct llist_item *head[LLIST_SKIP_LEVELS];
+	struct llist_item *tail[LLIST_SKIP_LEVELS];
 };
 
+typedef int (*llist_fn_cmp_t) (void *, void *);
+
 typedef struct llist llist_t;
 struct llist {
 	struct llist_item *head;
 	struct llist_item *tail;
+	struct llist_skip *skip;
+	int bulk;
+	llist_fn_cmp_t bulk_cmp;
 };
 
-typedef int (*llist_fn_cmp_t) (void *, void *);
 typedef int (*llist_fn_match_t) (void *, void *);
 typedef void (*llist_fn_free_t) (void *);
 
@@ -69,6 +90,7 @@ llist_item_t *llist_next_filter(llist_item_t *, void *, llist_fn_match_t);
 llist_item_t *llist_find_first(llist_t *, void *, llist_fn_match_t);
 llist_item_t *llist_find_next(llist_item_t *, void *, llist_fn_match_t);
 llist_item_t *llist_find_nth(llist_t *, int, void *, llist_fn_match_t);
+llist_item_t *llist_find_sorted(llist_t *, void *, llist_fn_cmp_t);
 
 #define LLIST_FIRST(l) llist_first(l)
 #define LLIST_NTH(l, n) llist_nth(l, n)
@@ -81,6 +103,8 @@ llist_item_t *llist_find_nth(llist_t *, int, void *, llist_fn_match_t);
   llist_find_next(i, data, (llist_fn_match_t)fn_match)
 #define LLIST_FIND_NTH(l, n, data, fn_match)                                  \
   llist_find_nth(l, n, data, (llist_fn_match_t)fn_match)
+#define LLIST_FIND_SORTED(l, data, fn_cmp)                                    \
+  llist_find_sorted(l, data, (llist_fn_cmp_t)fn_cmp)
 
 #define LLIST_FOREACH(l, i) for (i = LLIST_FIRST (l); i; i = LLIST_NEXT (i))
 #define LLIST_FIND_FOREACH(l, data, fn_match, i)                              \
@@ -104,3 +128,14 @@ void llist_remove(llist_t *, llist_item_t *);
 #define LLIST_ADD_SORTED(l, data, fn_cmp)                                     \
   llist_add_sorted(l, data, (llist_fn_cmp_t)fn_cmp)
 #define LLIST_REMOVE(l, i) llist_remove(l, i)
+
+/* Bulk loading. */
+void llist_bulk_begin(llist_t *);
+void llist_bulk_end(llist_t *);
+void llist_bulk_sort(llist_t *);
+void llist_bulk_splice(llist_t *, llist_t *);
+
+#define LLIST_BULK_BEGIN(l) llist_bulk_begin(l)
+#define LLIST_BULK_END(l) llist_bulk_end(l)
+#define LLIST_BULK_SORT(l) llist_bulk_sort(l)
+#define LLIST_BULK_SPLICE(l, src) llist_bulk_splice(l, src)
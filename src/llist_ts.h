@@ -39,6 +39,9 @@ typedef struct llist_ts llist_ts_t;
 struct llist_ts {
 	llist_item_t *head;
 	llist_item_t *tail;
+	struct llist_skip *skip;
+	int bulk;
+	llist_fn_cmp_t bulk_cmp;
 	pthread_mutex_t mutex;
 };
 
@@ -72,6 +75,8 @@ struct llist_ts {
   llist_find_next (i, data, (llist_fn_match_t)fn_match)
 #define LLIST_TS_FIND_NTH(l_ts, n, data, fn_match)                            \
   llist_find_nth ((llist_t *)l_ts, n, data, (llist_fn_match_t)fn_match)
+#define LLIST_TS_FIND_SORTED(l_ts, data, fn_cmp)                              \
+  llist_find_sorted ((llist_t *)l_ts, data, (llist_fn_cmp_t)fn_cmp)
 
 #define LLIST_TS_FOREACH(l_ts, i) \
   for (i = LLIST_TS_FIRST (l_ts); i; i = LLIST_TS_NEXT (i))
@@ -90,3 +95,8 @@ struct llist_ts {
 #define LLIST_TS_REMOVE(l_ts, i) llist_remove ((llist_t *)l_ts, i)
 #define LLIST_TS_ADD_SORTED(l_ts, data, fn_cmp)                               \
   llist_add_sorted ((llist_t *)l_ts, data, (llist_fn_cmp_t)fn_cmp)
+
+/* Bulk loading. */
+#define LLIST_TS_BULK_BEGIN(l_ts) llist_bulk_begin ((llist_t *)l_ts)
+#define LLIST_TS_BULK_END(l_ts) llist_bulk_end ((llist_t *)l_ts)
+#define LLIST_TS_BULK_SPLICE(l_ts, src) llist_bulk_splice ((llist_t *)l_ts, src)
@@ -38,6 +38,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "calcurse.h"
 
@@ -71,6 +72,197 @@ static struct mem_stats mstats;
 
 #endif /* CALCURSE_MEMORY_DEBUG */
 
+/*
+ * Arena for the items and strings loaded from the data files. Allocations
+ * made with mem_arena_malloc() while a load generation is open are carved out
+ * of large chunks, and the whole generation is released at once by
+ * mem_arena_drop(). Freeing arena memory is a no-op and reallocating it moves
+ * the data to the heap, so that items edited later on migrate out of the
+ * arena without any special handling. The blocks they leave behind are only
+ * reclaimed when the arena is dropped, on the next reload.
+ */
+#define MEM_ARENA_CHUNK    (256 * 1024)
+#define MEM_ARENA_ALIGN    (2 * sizeof(void *))
+
+/* Header of each arena allocation, used when moving it to the heap. */
+#define MEM_ARENA_HDR      MEM_ARENA_ALIGN
+
+struct mem_chunk {
+	char *base;
+	size_t size;
+};
+
+static struct {
+	int open;
+	char *cur;		/* free space of the current chunk */
+	size_t avail;
+	struct mem_chunk *chunk;	/* sorted by base address */
+	unsigned nchunks;
+	unsigned size;
+	uintptr_t lo, hi;	/* range of addresses spanned by the chunks */
+} mem_arena;
+/*
+ * Lookups of blocks are far more frequent than changes to the arena and come
+ * from all threads, so they only share the lock.
+ */
+static pthread_rwlock_t mem_arena_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Add a chunk to the arena. Must be called with the arena lock held. */
+static char *mem_arena_add_chunk(size_t size)
+{
+	char *base = xmalloc(size);
+	struct mem_chunk *chunk;
+	unsigned i;
+
+	if (mem_arena.nchunks == mem_arena.size) {
+		/*
+		 * Not xrealloc(), which looks the block up in the arena and
+		 * would take the arena lock a second time.
+		 */
+		mem_arena.size = mem_arena.size > 0 ? mem_arena.size * 2 : 16;
+		chunk = realloc(mem_arena.chunk,
+				mem_arena.size * sizeof(struct mem_chunk));
+		EXIT_IF(chunk == NULL, _("xrealloc: out of memory"));
+		mem_arena.chunk = chunk;
+	}
+
+	for (i = mem_arena.nchunks; i > 0; i--) {
+		if ((uintptr_t)mem_arena.chunk[i - 1].base < (uintptr_t)base)
+			break;
+		mem_arena.chunk[i] = mem_arena.chunk[i - 1];
+	}
+	mem_arena.chunk[i].base = base;
+	mem_arena.chunk[i].size = size;
+	if (mem_arena.nchunks == 0 || (uintptr_t)base < mem_arena.lo)
+		mem_arena.lo = (uintptr_t)base;
+	if ((uintptr_t)base + size > mem_arena.hi)
+		mem_arena.hi = (uintptr_t)base + size;
+	mem_arena.nchunks++;
+
+	return base;
+}
+
+/*
+ * Return the size of a block if it belongs to the arena, 0 otherwise. This is
+ * called for every block freed or reallocated, so blocks outside of the range
+ * spanned by the chunks are ruled out before searching the chunks.
+ */
+static size_t mem_arena_size(const void *p)
+{
+	unsigned lo = 0, hi, mid;
+	size_t size = 0;
+
+	pthread_rwlock_rdlock(&mem_arena_lock);
+	if ((uintptr_t)p < mem_arena.lo || (uintptr_t)p >= mem_arena.hi) {
+		pthread_rwlock_unlock(&mem_arena_lock);
+		return 0;
+	}
+
+	hi = mem_arena.nchunks;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if ((uintptr_t)mem_arena.chunk[mid].base <= (uintptr_t)p)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0 && (uintptr_t)p < (uintptr_t)mem_arena.chunk[lo - 1].base +
+	    mem_arena.chunk[lo - 1].size)
+		size = *(size_t *)((char *)p - MEM_ARENA_HDR);
+	pthread_rwlock_unlock(&mem_arena_lock);
+
+	return size;
+}
+
+/* Move a block out of the arena. */
+static void *mem_arena_move(void *p, size_t old_size, void *buf,
+			    size_t new_size)
+{
+	memcpy(buf, p, old_size < new_size ? old_size : new_size);
+	return buf;
+}
+
+/* Open a new load generation. */
+void mem_arena_begin(void)
+{
+	pthread_rwlock_wrlock(&mem_arena_lock);
+	mem_arena.open = 1;
+	pthread_rwlock_unlock(&mem_arena_lock);
+}
+
+/* Stop allocating from the arena. */
+void mem_arena_end(void)
+{
+	pthread_rwlock_wrlock(&mem_arena_lock);
+	mem_arena.open = 0;
+	pthread_rwlock_unlock(&mem_arena_lock);
+}
+
+/*
+ * Release all memory of the loaded generations. None of the items allocated
+ * from them must be referenced anymore.
+ */
+void mem_arena_drop(void)
+{
+	unsigned i;
+
+	pthread_rwlock_wrlock(&mem_arena_lock);
+	mem_arena.open = 0;
+	for (i = 0; i < mem_arena.nchunks; i++)
+		free(mem_arena.chunk[i].base);
+	free(mem_arena.chunk);
+	mem_arena.chunk = NULL;
+	mem_arena.nchunks = mem_arena.size = 0;
+	mem_arena.lo = mem_arena.hi = 0;
+	mem_arena.cur = NULL;
+	mem_arena.avail = 0;
+	pthread_rwlock_unlock(&mem_arena_lock);
+}
+
+/*
+ * Allocate memory for a loaded item from the current generation. Falls back
+ * to mem_malloc() if no generation is open.
+ */
+void *mem_arena_malloc(size_t size)
+{
+	size_t need;
+	char *p;
+
+	EXIT_IF(size == 0, _("mem_arena_malloc: zero size"));
+
+	pthread_rwlock_wrlock(&mem_arena_lock);
+	if (!mem_arena.open) {
+		pthread_rwlock_unlock(&mem_arena_lock);
+		return mem_malloc(size);
+	}
+
+	need = MEM_ARENA_HDR +
+	       (size + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN;
+	if (need > MEM_ARENA_CHUNK / 4) {
+		/* Large blocks get a chunk of their own. */
+		p = mem_arena_add_chunk(need);
+	} else {
+		if (need > mem_arena.avail) {
+			mem_arena.cur = mem_arena_add_chunk(MEM_ARENA_CHUNK);
+			mem_arena.avail = MEM_ARENA_CHUNK;
+		}
+		p = mem_arena.cur;
+		mem_arena.cur += need;
+		mem_arena.avail -= need;
+	}
+	pthread_rwlock_unlock(&mem_arena_lock);
+
+	*(size_t *)p = size;
+	return p + MEM_ARENA_HDR;
+}
+
+char *mem_arena_strdup(const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	return memcpy(mem_arena_malloc(len), str, len);
+}
+
 void *xmalloc(size_t size)
 {
 	void *p;
@@ -97,11 +289,14 @@ void *xcalloc(size_t nmemb, size_t size)
 void *xrealloc(void *ptr, size_t nmemb, size_t size)
 {
 	void *new_ptr;
-	size_t new_size;
+	size_t old_size, new_size;
 
 	new_size = nmemb * size;
 	EXIT_IF(new_size == 0, _("xrealloc: zero size"));
 	EXIT_IF(SIZE_MAX / nmemb < size, _("xrealloc: overflow"));
+	if (ptr && (old_size = mem_arena_size(ptr)) > 0)
+		return mem_arena_move(ptr, old_size, xmalloc(new_size),
+				      new_size);
 	new_ptr = realloc(ptr, new_size);
 	EXIT_IF(new_ptr == NULL, _("xrealloc: out of memory"));
 
@@ -121,6 +316,8 @@ char *xstrdup(const char *str)
 
 void xfree(void *p)
 {
+	if (p && mem_arena_size(p) > 0)
+		return;
 	free(p);
 }
 
@@ -208,19 +405,25 @@ void *dbg_realloc(void *ptr, size_t nmemb, size_t size, const char *pos)
 {
 	unsigned *buf, old_size, new_size, cpy_size;
 
-	if (ptr == NULL)
-		return NULL;
-
 	new_size = nmemb * size;
 	if (new_size == 0)
 		return NULL;
 
 	EXIT_IF(nmemb > SIZE_MAX / size, _("overflow at %s"), pos);
 
+	/* Behave like realloc(), which the non-debug path relies on. */
+	if (ptr == NULL)
+		return dbg_malloc(new_size, pos);
+
 	if ((buf = dbg_malloc(new_size, pos)) == NULL)
 		return NULL;
 
+	if ((cpy_size = mem_arena_size(ptr)) > 0)
+		return mem_arena_move(ptr, cpy_size, buf, new_size);
+
+	/* The block size is stored in units, including the extra space. */
 	old_size = *((unsigned *)ptr - EXTRA_SPACE_START + BLK_SIZE);
+	old_size = (old_size - (EXTRA_SPACE)) * sizeof(unsigned);
 	cpy_size = (old_size > new_size) ? new_size : old_size;
 	memmove(buf, ptr, cpy_size);
 
@@ -249,6 +452,8 @@ void dbg_free(void *ptr, const char *pos)
 	unsigned *buf, size;
 
 	EXIT_IF(ptr == NULL, _("dbg_free: null pointer at %s"), pos);
+	if (mem_arena_size(ptr) > 0)
+		return;
 
 	buf = (unsigned *)ptr - EXTRA_SPACE_START;
 	size = buf[BLK_SIZE];
@@ -40,20 +40,6 @@
 #include "calcurse.h"
 #include "sha1.h"
 
-struct note_gc_hash {
-	char *hash;
-	char buf[MAX_NOTESIZ + 1];
-	 HTABLE_ENTRY(note_gc_hash);
-};
-
-static void note_gc_extract_key(struct note_gc_hash *, const char **,
-				int *);
-static int note_gc_cmp(struct note_gc_hash *, struct note_gc_hash *);
-
-HTABLE_HEAD(htp, NOTE_GC_HSIZE, note_gc_hash);
-HTABLE_PROTOTYPE(htp, note_gc_hash)
-    HTABLE_GENERATE(htp, note_gc_hash, note_gc_extract_key, note_gc_cmp)
-
 /* Create note file from a string and return a newly allocated string that
  * contains its name. */
 char *generate_note(const char *str)
@@ -155,93 +141,120 @@ void note_read(char *buffer, FILE * fp)
 	buffer[MAX_NOTESIZ] = '\0';
 }
 
-static void
-note_gc_extract_key(struct note_gc_hash *data, const char **key, int *len)
+static const char *note_gc_key(char *note)
 {
-	*key = data->hash;
-	*len = strlen(data->hash);
+	return note;
 }
 
-static int note_gc_cmp(struct note_gc_hash *a, struct note_gc_hash *b)
+static void note_gc_ref(hashmap_t *notes, char *note)
 {
-	return strcmp(a->hash, b->hash);
+	if (note)
+		HASHMAP_ADD(notes, note);
 }
 
-/* Spot and unlink unused note files. */
+/*
+ * Spot and unlink unused note files.
+ *
+ * The notes attached to items are collected first, so that the notes directory
+ * is only read once and each entry costs a single lookup. The unused files are
+ * then removed relative to the directory rather than through full paths.
+ */
 void note_gc(void)
 {
-	struct htp gc_htable = HTABLE_INITIALIZER(&gc_htable);
-	struct note_gc_hash *hp;
+	hashmap_t notes;
+	vector_t unused;
+	struct timespec start, end;
 	DIR *dirp;
 	struct dirent *dp;
 	llist_item_t *i;
-	struct note_gc_hash tmph;
-	char *notepath;
-
-	if (!(dirp = opendir(path_notes)))
-		return;
-
-	/* Insert all note file names into a hash table. */
-	do {
-		if ((dp = readdir(dirp)) && *(dp->d_name) != '.') {
-			hp = mem_malloc(sizeof(struct note_gc_hash));
+	unsigned scanned = 0, removed = 0, n;
+	char *name;
+	int fd, timed;
 
-			strncpy(hp->buf, dp->d_name, MAX_NOTESIZ + 1);
-			hp->buf[MAX_NOTESIZ] = '\0';
-			hp->hash = hp->buf;
-
-			HTABLE_INSERT(htp, &gc_htable, hp);
-		}
-	}
-	while (dp);
+	timed = clock_gettime(CLOCK_MONOTONIC, &start) == 0;
 
-	closedir(dirp);
+	/* Collect the hashes of the notes that are in use. */
+	HASHMAP_INIT(&notes, 0, note_gc_key);
 
-	/* Remove hashes that are actually in use. */
 	LLIST_TS_FOREACH(&alist_p, i) {
 		struct apoint *apt = LLIST_GET_DATA(i);
-		if (apt->note) {
-			tmph.hash = apt->note;
-			mem_free(HTABLE_REMOVE(htp, &gc_htable, &tmph));
-		}
+		note_gc_ref(&notes, apt->note);
 	}
 
 	LLIST_FOREACH(&eventlist, i) {
 		struct event *ev = LLIST_GET_DATA(i);
-		if (ev->note) {
-			tmph.hash = ev->note;
-			mem_free(HTABLE_REMOVE(htp, &gc_htable, &tmph));
-		}
+		note_gc_ref(&notes, ev->note);
 	}
 
 	LLIST_TS_FOREACH(&recur_alist_p, i) {
 		struct recur_apoint *rapt = LLIST_GET_DATA(i);
-		if (rapt->note) {
-			tmph.hash = rapt->note;
-			mem_free(HTABLE_REMOVE(htp, &gc_htable, &tmph));
-		}
+		note_gc_ref(&notes, rapt->note);
 	}
 
 	LLIST_FOREACH(&recur_elist, i) {
 		struct recur_event *rev = LLIST_GET_DATA(i);
-		if (rev->note) {
-			tmph.hash = rev->note;
-			mem_free(HTABLE_REMOVE(htp, &gc_htable, &tmph));
-		}
+		note_gc_ref(&notes, rev->note);
 	}
 
 	LLIST_FOREACH(&todolist, i) {
 		struct todo *todo = LLIST_GET_DATA(i);
-		if (todo->note) {
-			tmph.hash = todo->note;
-			mem_free(HTABLE_REMOVE(htp, &gc_htable, &tmph));
-		}
+		note_gc_ref(&notes, todo->note);
+	}
+
+	if (!(dirp = opendir(path_notes))) {
+		HASHMAP_FREE(&notes);
+		return;
+	}
+
+	/*
+	 * Gather the unused files before removing any of them, so that the
+	 * directory is not modified while it is being read. Names that are
+	 * too long to be note hashes are left alone.
+	 */
+	VECTOR_INIT(&unused, 64);
+	while ((dp = readdir(dirp))) {
+		if (*(dp->d_name) == '.' || strlen(dp->d_name) > MAX_NOTESIZ)
+			continue;
+		scanned++;
+		if (!HASHMAP_GET(&notes, dp->d_name))
+			VECTOR_ADD(&unused, mem_strdup(dp->d_name));
 	}
 
 	/* Unlink unused note files. */
-	HTABLE_FOREACH(hp, htp, &gc_htable) {
-		asprintf(&notepath, "%s%s", path_notes, hp->hash);
-		unlink(notepath);
-		mem_free(notepath);
+	fd = dirfd(dirp);
+	VECTOR_FOREACH(&unused, n) {
+		name = VECTOR_NTH(&unused, n);
+		if (unlinkat(fd, name, 0) == 0)
+			removed++;
+		mem_free(name);
 	}
+
+	closedir(dirp);
+
+	if (ui_mode == UI_CMDLINE && show_dialogs()) {
+		double elapsed = 0;
+
+		if (timed && clock_gettime(CLOCK_MONOTONIC, &end) == 0)
+			elapsed = (end.tv_sec - start.tv_sec) +
+			    (end.tv_nsec - start.tv_nsec) / 1e9;
+		printf(_("Garbage collection report: %u note files checked in %.3f seconds\n"),
+		       scanned, elapsed);
+		printf(_("%u in use / %u removed / %u not removed\n"),
+		       scanned - VECTOR_COUNT(&unused), removed,
+		       VECTOR_COUNT(&unused) - removed);
+#ifdef CALCURSE_MEMORY_DEBUG
+		{
+			struct hashmap_stats stats;
+
+			HASHMAP_STATS(&notes, &stats);
+			printf(_("%u notes in %u slots (load %.2f), probe "
+				 "length %.2f on average / %u at most\n"),
+			       stats.count, stats.size, stats.load,
+			       stats.probe_avg, stats.probe_max);
+		}
+#endif
+	}
+
+	VECTOR_FREE(&unused);
+	HASHMAP_FREE(&notes);
 }
@@ -385,7 +385,7 @@ unsigned notify_get_next(struct notify_app *a)
 	a->got_app = 0;
 	a->state = 0;
 	a->txt = NULL;
-	recur_apoint_check_next(a, current_time, get_today());
+	recur_apoint_check_next(a, current_time);
 	apoint_check_next(a, current_time);
 
 	return 1;
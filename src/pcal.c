@@ -55,49 +55,18 @@ typedef void (*cb_dump_t) (FILE *, long, long, char *);
  * (mainly used to export data).
  */
 static void
-foreach_date_dump(const long date_end, struct rpt *rpt, llist_t * exc,
+foreach_date_dump(const long date_end, struct rpt *rpt, struct exc_days *exc,
 		  long item_first_date, long item_dur, char *item_mesg,
 		  cb_dump_t cb_dump, FILE * stream)
 {
-	long date, item_time;
-	struct tm lt;
-	time_t t;
+	struct recur_occurrence_iter it;
+	time_t occurrence;
 
-	t = item_first_date;
-	localtime_r(&t, &lt);
-	lt.tm_hour = lt.tm_min = lt.tm_sec = 0;
-	lt.tm_isdst = -1;
-	date = mktime(&lt);
-	item_time = item_first_date - date;
-
-	while (date <= date_end && date <= rpt->until) {
-		if (recur_item_inday
-		    (item_first_date, item_dur, exc, rpt->type, rpt->freq,
-		     rpt->until, date)) {
-			(*cb_dump) (stream, date + item_time, item_dur,
-				    item_mesg);
-		}
-		switch (rpt->type) {
-		case RECUR_DAILY:
-			date = date_sec_change(date, 0, rpt->freq);
-			break;
-		case RECUR_WEEKLY:
-			date =
-			    date_sec_change(date, 0,
-					    rpt->freq * WEEKINDAYS);
-			break;
-		case RECUR_MONTHLY:
-			date = date_sec_change(date, rpt->freq, 0);
-			break;
-		case RECUR_YEARLY:
-			date = date_sec_change(date, rpt->freq * 12, 0);
-			break;
-		default:
-			EXIT(_("incoherent repetition type"));
-			/* NOTREACHED */
-			break;
-		}
-	}
+	recur_occurrence_iter_init(&it, item_first_date, item_dur, exc, rpt,
+				   item_first_date);
+	while (recur_occurrence_iter_next(&it, &occurrence) &&
+	       occurrence <= date_end)
+		(*cb_dump) (stream, occurrence, item_dur, item_mesg);
 }
 
 static void pcal_export_header(FILE * stream)
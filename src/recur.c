@@ -46,44 +46,116 @@
 llist_ts_t recur_alist_p;
 llist_t recur_elist;
 
-static void free_exc(struct excp *exc)
+static void recur_cache_update_apoint(struct recur_apoint *, int);
+static void recur_cache_update_event(struct recur_event *, int);
+
+void recur_exc_init(struct exc_days *exc)
 {
-	mem_free(exc);
+	exc->count = 0;
+	exc->size = 0;
+	exc->day = NULL;
 }
 
-static void free_exc_list(llist_t * exc)
+void recur_exc_free(struct exc_days *exc)
 {
-	LLIST_FREE_INNER(exc, free_exc);
-	LLIST_FREE(exc);
+	if (exc->day)
+		mem_free(exc->day);
+	recur_exc_init(exc);
 }
 
-static int exc_cmp_day(struct excp *a, struct excp *b)
+/*
+ * Add a day to a set of exceptions. Exceptions are kept sorted, and a day that
+ * is already present is added after the existing entries.
+ */
+static void exc_add_day(struct exc_days *exc, long day)
 {
-	return a->st < b->st ? -1 : (a->st == b->st ? 0 : 1);
+	unsigned lo = 0, hi = exc->count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (exc->day[mid] <= day)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!exc->day) {
+		exc->size = 4;
+		exc->day = mem_malloc(exc->size * sizeof(long));
+	} else if (exc->count >= exc->size) {
+		exc->size *= 2;
+		exc->day = mem_realloc(exc->day, exc->size, sizeof(long));
+	}
+
+	memmove(exc->day + lo + 1, exc->day + lo,
+		(exc->count - lo) * sizeof(long));
+	exc->day[lo] = day;
+	exc->count++;
 }
 
-static void recur_add_exc(llist_t * exc, long day)
+/* Add the day a given date belongs to. */
+void recur_exc_add(struct exc_days *exc, long date)
 {
-	struct excp *o = mem_malloc(sizeof(struct excp));
-	o->st = day;
+	exc_add_day(exc, civil_day(date));
+}
 
-	LLIST_ADD_SORTED(exc, o, exc_cmp_day);
+/* Add a day given by its year, month and day of month. */
+void recur_exc_add_day(struct exc_days *exc, int year, int month, int day)
+{
+	exc_add_day(exc, civil_days(year, month, day));
 }
 
-static void exc_dup(llist_t * in, llist_t * exc)
+/* Get the start of the nth exception day. */
+long recur_exc_nth(struct exc_days *exc, unsigned n)
 {
-	llist_item_t *i;
+	long day = exc->day[n];
+	struct date d;
+	int yyyy, mm, dd;
 
-	LLIST_INIT(in);
+	civil_date(day, &yyyy, &mm, &dd);
+	d.dd = dd;
+	d.mm = mm;
+	d.yyyy = yyyy;
 
-	if (exc) {
-		LLIST_FOREACH(exc, i) {
-			struct excp *p = LLIST_GET_DATA(i);
-			recur_add_exc(in, p->st);
-		}
+	return date2sec(d, 0, 0);
+}
+
+/* Check whether a day (given as a day number) is an exception. */
+static int exc_on_day(struct exc_days *exc, long day)
+{
+	unsigned lo = 0, hi = exc->count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (exc->day[mid] < day)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < exc->count && exc->day[lo] == day;
+}
+
+static void exc_dup(struct exc_days *in, struct exc_days *exc)
+{
+	recur_exc_init(in);
+
+	if (exc && exc->count > 0) {
+		in->count = in->size = exc->count;
+		in->day = mem_malloc(in->size * sizeof(long));
+		memcpy(in->day, exc->day, in->count * sizeof(long));
 	}
 }
 
+/* Move all exceptions to another day, keeping their distance. */
+static void exc_shift(struct exc_days *exc, long days)
+{
+	unsigned i;
+
+	for (i = 0; i < exc->count; i++)
+		exc->day[i] += days;
+}
+
 struct recur_event *recur_event_dup(struct recur_event *in)
 {
 	EXIT_IF(!in, _("null pointer"));
@@ -139,11 +211,13 @@ struct recur_apoint *recur_apoint_dup(struct recur_apoint *in)
 void recur_apoint_llist_init(void)
 {
 	LLIST_TS_INIT(&recur_alist_p);
+	recur_cache_flush();
 }
 
 void recur_event_llist_init(void)
 {
 	LLIST_INIT(&recur_elist);
+	recur_cache_flush();
 }
 
 void recur_apoint_free(struct recur_apoint *rapt)
@@ -153,7 +227,7 @@ void recur_apoint_free(struct recur_apoint *rapt)
 		mem_free(rapt->note);
 	if (rapt->rpt)
 		mem_free(rapt->rpt);
-	free_exc_list(&rapt->exc);
+	recur_exc_free(&rapt->exc);
 	mem_free(rapt);
 }
 
@@ -164,24 +238,25 @@ void recur_event_free(struct recur_event *rev)
 		mem_free(rev->note);
 	if (rev->rpt)
 		mem_free(rev->rpt);
-	free_exc_list(&rev->exc);
+	recur_exc_free(&rev->exc);
 	mem_free(rev);
 }
 
 void recur_apoint_llist_free(void)
 {
+	recur_cache_flush();
 	LLIST_TS_FREE_INNER(&recur_alist_p, recur_apoint_free);
 	LLIST_TS_FREE(&recur_alist_p);
 }
 
 void recur_event_llist_free(void)
 {
+	recur_cache_flush();
 	LLIST_FREE_INNER(&recur_elist, recur_event_free);
 	LLIST_FREE(&recur_elist);
 }
 
-static int
-recur_apoint_cmp(struct recur_apoint *a, struct recur_apoint *b)
+int recur_apoint_cmp(struct recur_apoint *a, struct recur_apoint *b)
 {
 	if (a->start < b->start)
 		return -1;
@@ -195,7 +270,7 @@ recur_apoint_cmp(struct recur_apoint *a, struct recur_apoint *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-static int recur_event_cmp(struct recur_event *a, struct recur_event *b)
+int recur_event_cmp(struct recur_event *a, struct recur_event *b)
 {
 	if (a->day < b->day)
 		return -1;
@@ -205,18 +280,18 @@ static int recur_event_cmp(struct recur_event *a, struct recur_event *b)
 	return strcmp(a->mesg, b->mesg);
 }
 
-/* Insert a new recursive appointment in the general linked list */
-struct recur_apoint *recur_apoint_new(char *mesg, char *note, long start,
-				      long dur, char state, int type,
-				      int freq, long until,
-				      llist_t * except)
+static struct recur_apoint *recur_apoint_alloc(char *mesg, char *note,
+					       long start, long dur,
+					       char state, int type, int freq,
+					       long until,
+					       struct exc_days *except)
 {
 	struct recur_apoint *rapt =
-	    mem_malloc(sizeof(struct recur_apoint));
+	    mem_arena_malloc(sizeof(struct recur_apoint));
 
-	rapt->rpt = mem_malloc(sizeof(struct rpt));
-	rapt->mesg = mem_strdup(mesg);
-	rapt->note = (note != NULL) ? mem_strdup(note) : 0;
+	rapt->rpt = mem_arena_malloc(sizeof(struct rpt));
+	rapt->mesg = mem_arena_strdup(mesg);
+	rapt->note = (note != NULL) ? mem_arena_strdup(note) : 0;
 	rapt->start = start;
 	rapt->state = state;
 	rapt->dur = dur;
@@ -224,46 +299,169 @@ struct recur_apoint *recur_apoint_new(char *mesg, char *note, long start,
 	rapt->rpt->freq = freq;
 	rapt->rpt->until = until;
 	if (except) {
-		exc_dup(&rapt->exc, except);
-		free_exc_list(except);
+		rapt->exc = *except;
+		recur_exc_init(except);
 	} else {
-		LLIST_INIT(&rapt->exc);
+		recur_exc_init(&rapt->exc);
 	}
 
+	return rapt;
+}
+
+/* Insert a new recursive appointment in the general linked list */
+struct recur_apoint *recur_apoint_new(char *mesg, char *note, long start,
+				      long dur, char state, int type,
+				      int freq, long until,
+				      struct exc_days *except)
+{
+	struct recur_apoint *rapt;
+
+	rapt = recur_apoint_alloc(mesg, note, start, dur, state, type, freq,
+				  until, except);
+
 	LLIST_TS_LOCK(&recur_alist_p);
 	LLIST_TS_ADD_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
 	LLIST_TS_UNLOCK(&recur_alist_p);
+	recur_cache_update_apoint(rapt, 1);
 
 	return rapt;
 }
 
-/* Insert a new recursive event in the general linked list */
-struct recur_event *recur_event_new(char *mesg, char *note, long day,
-				    int id, int type, int freq, long until,
-				    llist_t * except)
+static struct recur_event *recur_event_alloc(char *mesg, char *note,
+					     long day, int id, int type,
+					     int freq, long until,
+					     struct exc_days *except)
 {
-	struct recur_event *rev = mem_malloc(sizeof(struct recur_event));
+	struct recur_event *rev =
+	    mem_arena_malloc(sizeof(struct recur_event));
 
-	rev->rpt = mem_malloc(sizeof(struct rpt));
-	rev->mesg = mem_strdup(mesg);
-	rev->note = (note != NULL) ? mem_strdup(note) : 0;
+	rev->rpt = mem_arena_malloc(sizeof(struct rpt));
+	rev->mesg = mem_arena_strdup(mesg);
+	rev->note = (note != NULL) ? mem_arena_strdup(note) : 0;
 	rev->day = day;
 	rev->id = id;
 	rev->rpt->type = type;
 	rev->rpt->freq = freq;
 	rev->rpt->until = until;
 	if (except) {
-		exc_dup(&rev->exc, except);
-		free_exc_list(except);
+		rev->exc = *except;
+		recur_exc_init(except);
 	} else {
-		LLIST_INIT(&rev->exc);
+		recur_exc_init(&rev->exc);
 	}
 
+	return rev;
+}
+
+/* Insert a new recursive event in the general linked list */
+struct recur_event *recur_event_new(char *mesg, char *note, long day,
+				    int id, int type, int freq, long until,
+				    struct exc_days *except)
+{
+	struct recur_event *rev;
+
+	rev = recur_event_alloc(mesg, note, day, id, type, freq, until,
+				except);
+
 	LLIST_ADD_SORTED(&recur_elist, rev, recur_event_cmp);
+	recur_cache_update_event(rev, 1);
 
 	return rev;
 }
 
+/*
+ * Add the recurrent appointments of a list filled in bulk mode, such as the
+ * ones returned by recur_apoint_scan(), to the list of recurrent
+ * appointments. That list must be in bulk mode as well.
+ */
+void recur_apoint_llist_splice(llist_t *batch)
+{
+	llist_item_t *i;
+
+	LLIST_FOREACH(batch, i)
+		recur_cache_update_apoint(LLIST_GET_DATA(i), 1);
+
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_BULK_SPLICE(&recur_alist_p, batch);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+}
+
+/*
+ * Add the recurrent events of a list filled in bulk mode, such as the ones
+ * returned by recur_event_scan(), to the list of recurrent events. That list
+ * must be in bulk mode as well.
+ */
+void recur_event_llist_splice(llist_t *batch)
+{
+	llist_item_t *i;
+
+	LLIST_FOREACH(batch, i)
+		recur_cache_update_event(LLIST_GET_DATA(i), 1);
+
+	LLIST_BULK_SPLICE(&recur_elist, batch);
+}
+
+/*
+ * Remove and free the recurrent appointments for which fn_match returns a
+ * non-zero value when passed their representation in the data files.
+ */
+void recur_apoint_llist_drop(item_fn_match_t fn_match, void *arg)
+{
+	llist_t dropped;
+	llist_item_t *i, *next;
+	struct recur_apoint *rapt;
+	char *str;
+	int match;
+
+	LLIST_INIT(&dropped);
+	LLIST_TS_LOCK(&recur_alist_p);
+	for (i = LLIST_TS_FIRST(&recur_alist_p); i; i = next) {
+		next = LLIST_TS_NEXT(i);
+		rapt = LLIST_TS_GET_DATA(i);
+		str = recur_apoint_tostr(rapt);
+		match = fn_match(str, arg);
+		mem_free(str);
+		if (!match)
+			continue;
+		LLIST_TS_REMOVE(&recur_alist_p, i);
+		LLIST_ADD(&dropped, rapt);
+	}
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	/* The cache is updated without the lock, see recur_apoint_erase(). */
+	LLIST_FOREACH(&dropped, i) {
+		rapt = LLIST_GET_DATA(i);
+		recur_cache_update_apoint(rapt, 0);
+		recur_apoint_free(rapt);
+	}
+	LLIST_FREE(&dropped);
+}
+
+/*
+ * Remove and free the recurrent events for which fn_match returns a non-zero
+ * value when passed their representation in the data files.
+ */
+void recur_event_llist_drop(item_fn_match_t fn_match, void *arg)
+{
+	llist_item_t *i, *next;
+	struct recur_event *rev;
+	char *str;
+	int match;
+
+	for (i = LLIST_FIRST(&recur_elist); i; i = next) {
+		next = LLIST_NEXT(i);
+		rev = LLIST_GET_DATA(i);
+		str = recur_event_tostr(rev);
+		match = fn_match(str, arg);
+		mem_free(str);
+		if (!match)
+			continue;
+		LLIST_REMOVE(&recur_elist, i);
+		recur_cache_update_event(rev, 0);
+		recur_event_free(rev);
+	}
+}
+
 /*
  * Correspondance between the defines on recursive type,
  * and the letter to be written in file.
@@ -321,53 +519,54 @@ int recur_char2def(char type)
 	return recur_def;
 }
 
+/* Check that a letter written in file denotes a recursive type. */
+static int recur_char_valid(char type)
+{
+	return type == 'D' || type == 'W' || type == 'M' || type == 'Y';
+}
+
 /* Write days for which recurrent items should not be repeated. */
-static void recur_exc_append(struct string *s, llist_t *lexc)
+static void recur_exc_append(struct string *s, struct exc_days *exc)
 {
-	llist_item_t *i;
-	struct tm lt;
-	time_t t;
+	unsigned i;
 	int st_mon, st_day, st_year;
 
-	LLIST_FOREACH(lexc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		t = exc->st;
-		localtime_r(&t, &lt);
-		st_mon = lt.tm_mon + 1;
-		st_day = lt.tm_mday;
-		st_year = lt.tm_year + 1900;
-		string_catf(s, " !%02u/%02u/%04u", st_mon, st_day, st_year);
+	for (i = 0; i < exc->count; i++) {
+		civil_date(exc->day[i], &st_year, &st_mon, &st_day);
+		string_cat(s, " !");
+		string_catdate(s, st_year, st_mon, st_day);
 	}
 }
 
-/* Load the recursive appointment description */
-struct recur_apoint *recur_apoint_scan(FILE * f, struct tm start,
+/*
+ * Create a recurrent appointment read from the data file. The description is
+ * NULL if the end of the file was reached before it. The appointment is not
+ * added to the list of recurrent appointments. If the item is invalid, NULL is
+ * returned and *err is set to an error message.
+ */
+struct recur_apoint *recur_apoint_scan(char *buf, struct tm start,
 				       struct tm end, char type, int freq,
 				       struct tm until, char *note,
-				       llist_t * exc, char state,
-				       struct item_filter *filter)
+				       struct exc_days *exc, char state,
+				       struct item_filter *filter,
+				       const char **err)
 {
-	char buf[BUFSIZ], *nl;
 	time_t tstart, tend, tuntil;
 	struct recur_apoint *rapt;
 
-	EXIT_IF(!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
-		!check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
-		!check_time(start.tm_hour, start.tm_min) ||
-		!check_time(end.tm_hour, end.tm_min) ||
-		(until.tm_year != 0
-		 && !check_date(until.tm_year, until.tm_mon,
-				until.tm_mday)),
-		_("date error in appointment"));
-
-	/* Read the appointment description */
-	if (!fgets(buf, sizeof buf, f))
+	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
+	    !check_date(end.tm_year, end.tm_mon, end.tm_mday) ||
+	    !check_time(start.tm_hour, start.tm_min) ||
+	    !check_time(end.tm_hour, end.tm_min) ||
+	    (until.tm_year != 0 &&
+	     !check_date(until.tm_year, until.tm_mon, until.tm_mday))) {
+		*err = _("date error in appointment");
 		return NULL;
-
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
 	}
+
+	if (!buf)
+		return NULL;
+
 	start.tm_sec = end.tm_sec = 0;
 	start.tm_isdst = end.tm_isdst = -1;
 	start.tm_year -= 1900;
@@ -388,8 +587,10 @@ struct recur_apoint *recur_apoint_scan(FILE * f, struct tm start,
 	} else {
 		tuntil = 0;
 	}
-	EXIT_IF(tstart == -1 || tend == -1 || tstart > tend
-		|| tuntil == -1, _("date error in appointment"));
+	if (tstart == -1 || tend == -1 || tstart > tend || tuntil == -1) {
+		*err = _("date error in appointment");
+		return NULL;
+	}
 
 	/* Filter item. */
 	if (filter) {
@@ -407,14 +608,18 @@ struct recur_apoint *recur_apoint_scan(FILE * f, struct tm start,
 			return NULL;
 	}
 
-	rapt = recur_apoint_new(buf, note, tstart, tend - tstart, state,
-				recur_char2def(type), freq, tuntil, exc);
+	if (!recur_char_valid(type)) {
+		*err = _("unknown character");
+		return NULL;
+	}
+	rapt = recur_apoint_alloc(buf, note, tstart, tend - tstart, state,
+				  recur_char2def(type), freq, tuntil, exc);
 
 	/* Filter by hash. */
 	if (filter && filter->hash) {
 		char *hash = recur_apoint_hash(rapt);
 		if (!hash_matches(filter->hash, hash)) {
-			recur_apoint_erase(rapt);
+			recur_apoint_free(rapt);
 			rapt = NULL;
 		}
 		mem_free(hash);
@@ -423,30 +628,32 @@ struct recur_apoint *recur_apoint_scan(FILE * f, struct tm start,
 	return rapt;
 }
 
-/* Load the recursive events from file */
-struct recur_event *recur_event_scan(FILE * f, struct tm start, int id,
+/*
+ * Create a recurrent event read from the data file. The description is NULL if
+ * the end of the file was reached before it. The event is not added to the
+ * list of recurrent events. If the item is invalid, NULL is returned and *err
+ * is set to an error message.
+ */
+struct recur_event *recur_event_scan(char *buf, struct tm start, int id,
 				     char type, int freq, struct tm until,
-				     char *note, llist_t * exc,
-				     struct item_filter *filter)
+				     char *note, struct exc_days *exc,
+				     struct item_filter *filter,
+				     const char **err)
 {
-	char buf[BUFSIZ], *nl;
 	time_t tstart, tend, tuntil;
 	struct recur_event *rev;
 
-	EXIT_IF(!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
-		!check_time(start.tm_hour, start.tm_min) ||
-		(until.tm_year != 0
-		 && !check_date(until.tm_year, until.tm_mon,
-				until.tm_mday)), _("date error in event"));
+	if (!check_date(start.tm_year, start.tm_mon, start.tm_mday) ||
+	    !check_time(start.tm_hour, start.tm_min) ||
+	    (until.tm_year != 0 &&
+	     !check_date(until.tm_year, until.tm_mon, until.tm_mday))) {
+		*err = _("date error in event");
+		return NULL;
+	}
 
-	/* Read the event description */
-	if (!fgets(buf, sizeof buf, f))
+	if (!buf)
 		return NULL;
 
-	nl = strchr(buf, '\n');
-	if (nl) {
-		*nl = '\0';
-	}
 	start.tm_hour = until.tm_hour = 0;
 	start.tm_min = until.tm_min = 0;
 	start.tm_sec = until.tm_sec = 0;
@@ -461,7 +668,10 @@ struct recur_event *recur_event_scan(FILE * f, struct tm start, int id,
 		tuntil = 0;
 	}
 	tstart = mktime(&start);
-	EXIT_IF(tstart == -1 || tuntil == -1, _("date error in event"));
+	if (tstart == -1 || tuntil == -1) {
+		*err = _("date error in event");
+		return NULL;
+	}
 	tend = tstart + DAYINSEC - 1;
 
 	/* Filter item. */
@@ -480,14 +690,18 @@ struct recur_event *recur_event_scan(FILE * f, struct tm start, int id,
 			return NULL;
 	}
 
-	rev = recur_event_new(buf, note, tstart, id, recur_char2def(type),
-			      freq, tuntil, exc);
+	if (!recur_char_valid(type)) {
+		*err = _("unknown character");
+		return NULL;
+	}
+	rev = recur_event_alloc(buf, note, tstart, id, recur_char2def(type),
+				freq, tuntil, exc);
 
 	/* Filter by hash. */
 	if (filter && filter->hash) {
 		char *hash = recur_event_hash(rev);
 		if (!hash_matches(filter->hash, hash)) {
-			recur_event_erase(rev);
+			recur_event_free(rev);
 			rev = NULL;
 		}
 		mem_free(hash);
@@ -496,44 +710,56 @@ struct recur_event *recur_event_scan(FILE * f, struct tm start, int id,
 	return rev;
 }
 
-char *recur_apoint_tostr(struct recur_apoint *o)
+/* Append the local date of a time in the format of the data file. */
+static void recur_cat_date(struct string *s, long date)
 {
-	struct string s;
 	struct tm lt;
-	time_t t;
-
-	string_init(&s);
+	time_t t = date;
 
-	t = o->start;
 	localtime_r(&t, &lt);
-	string_catf(&s, "%02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
+	string_catdate(s, 1900 + lt.tm_year, lt.tm_mon + 1, lt.tm_mday);
+}
 
-	t = o->start + o->dur;
-	localtime_r(&t, &lt);
-	string_catf(&s, " -> %02u/%02u/%04u @ %02u:%02u", lt.tm_mon + 1,
-		lt.tm_mday, 1900 + lt.tm_year, lt.tm_hour, lt.tm_min);
-
-	t = o->rpt->until;
-	if (t == 0) {
-		/* We have an endless recurrent appointment. */
-		string_catf(&s, " {%d%c", o->rpt->freq,
-			recur_def2char(o->rpt->type));
-	} else {
-		localtime_r(&t, &lt);
-		string_catf(&s, " {%d%c -> %02u/%02u/%04u", o->rpt->freq,
-			recur_def2char(o->rpt->type), lt.tm_mon + 1,
-			lt.tm_mday, 1900 + lt.tm_year);
-	}
-	recur_exc_append(&s, &o->exc);
-	string_catf(&s, "} ");
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
+/* Append the repetition and exceptions of an item, and the brace after them. */
+static void recur_cat_rpt(struct string *s, struct rpt *rpt,
+			  struct exc_days *exc)
+{
+	string_cat(s, " {");
+	string_catint(s, rpt->freq, 0);
+	string_catc(s, recur_def2char(rpt->type));
+	if (rpt->until != 0) {
+		string_cat(s, " -> ");
+		recur_cat_date(s, rpt->until);
+	}
+	recur_exc_append(s, exc);
+	string_cat(s, "} ");
+}
+
+/* Append a recurrent appointment in the format of the data file. */
+void recur_apoint_catstr(struct string *s, struct recur_apoint *o)
+{
+	apoint_cat_datetime(s, o->start);
+	string_cat(s, " -> ");
+	apoint_cat_datetime(s, o->start + o->dur);
+	recur_cat_rpt(s, o->rpt, &o->exc);
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
 	if (o->state & APOINT_NOTIFY)
-		string_catf(&s, "%c", '!');
+		string_catc(s, '!');
 	else
-		string_catf(&s, "%c", '|');
-	string_catf(&s, "%s", o->mesg);
+		string_catc(s, '|');
+	string_cat(s, o->mesg);
+}
+
+char *recur_apoint_tostr(struct recur_apoint *o)
+{
+	struct string s;
+
+	string_init(&s);
+	recur_apoint_catstr(&s, o);
 
 	return string_buf(&s);
 }
@@ -555,42 +781,28 @@ void recur_apoint_write(struct recur_apoint *o, FILE * f)
 	mem_free(str);
 }
 
+/* Append a recurrent event in the format of the data file. */
+void recur_event_catstr(struct string *s, struct recur_event *o)
+{
+	recur_cat_date(s, o->day);
+	string_cat(s, " [");
+	string_catint(s, o->id, 0);
+	string_catc(s, ']');
+	recur_cat_rpt(s, o->rpt, &o->exc);
+	if (o->note) {
+		string_catc(s, '>');
+		string_cat(s, o->note);
+		string_catc(s, ' ');
+	}
+	string_cat(s, o->mesg);
+}
+
 char *recur_event_tostr(struct recur_event *o)
 {
 	struct string s;
-	struct tm lt;
-	time_t t;
-	int st_mon, st_day, st_year;
-	int end_mon, end_day, end_year;
 
 	string_init(&s);
-
-	t = o->day;
-	localtime_r(&t, &lt);
-	st_mon = lt.tm_mon + 1;
-	st_day = lt.tm_mday;
-	st_year = lt.tm_year + 1900;
-	t = o->rpt->until;
-	if (t == 0) {
-		/* We have an endless recurrent event. */
-		string_catf(&s, "%02u/%02u/%04u [%d] {%d%c", st_mon, st_day,
-			st_year, o->id, o->rpt->freq,
-			recur_def2char(o->rpt->type));
-	} else {
-		localtime_r(&t, &lt);
-		end_mon = lt.tm_mon + 1;
-		end_day = lt.tm_mday;
-		end_year = lt.tm_year + 1900;
-		string_catf(&s, "%02u/%02u/%04u [%d] {%d%c -> %02u/%02u/%04u",
-			st_mon, st_day, st_year, o->id, o->rpt->freq,
-			recur_def2char(o->rpt->type), end_mon, end_day,
-			end_year);
-	}
-	recur_exc_append(&s, &o->exc);
-	string_catf(&s, "} ");
-	if (o->note)
-		string_catf(&s, ">%s ", o->note);
-	string_catf(&s, "%s", o->mesg);
+	recur_event_catstr(&s, o);
 
 	return string_buf(&s);
 }
@@ -613,52 +825,22 @@ void recur_event_write(struct recur_event *o, FILE * f)
 }
 
 /* Write recursive items to file. */
-void recur_save_data(FILE * f)
-{
-	llist_item_t *i;
-
-	LLIST_FOREACH(&recur_elist, i) {
-		struct recur_event *rev = LLIST_GET_DATA(i);
-		recur_event_write(rev, f);
-	}
-
-	LLIST_TS_LOCK(&recur_alist_p);
-	LLIST_TS_FOREACH(&recur_alist_p, i) {
-		struct recur_apoint *rapt = LLIST_GET_DATA(i);
-		recur_apoint_write(rapt, f);
-	}
-	LLIST_TS_UNLOCK(&recur_alist_p);
-}
-
 /*
- * The two following defines together with the diff_days, diff_months and
- * diff_years functions were provided by Lukas Fleischer to correct the wrong
- * calculation of recurrent dates after a turn of year.
+ * The diff_days, diff_months and diff_years functions were originally
+ * provided by Lukas Fleischer to correct the wrong calculation of recurrent
+ * dates after a turn of year.
  */
-#define BC(start, end, bs)                                              \
-  (((end) - (start) + ((start) % bs) - ((end) % bs)) / bs               \
-   + ((((start) % bs) == 0) ? 1 : 0))
-
-#define LEAPCOUNT(start, end)                                           \
-  (BC(start, end, 4) - BC(start, end, 100) + BC(start, end, 400))
 
 /* Calculate the difference in days between two dates. */
 static long diff_days(struct tm lt_start, struct tm lt_end)
 {
-	long diff;
-
 	if (lt_end.tm_year < lt_start.tm_year)
 		return 0;
 
-	diff = lt_end.tm_yday - lt_start.tm_yday;
-
-	if (lt_end.tm_year > lt_start.tm_year) {
-		diff += (lt_end.tm_year - lt_start.tm_year) * YEARINDAYS;
-		diff += LEAPCOUNT(lt_start.tm_year + TM_YEAR_BASE,
-				  lt_end.tm_year + TM_YEAR_BASE - 1);
-	}
-
-	return diff;
+	return civil_days(lt_end.tm_year + TM_YEAR_BASE, lt_end.tm_mon + 1,
+			  lt_end.tm_mday) -
+	       civil_days(lt_start.tm_year + TM_YEAR_BASE,
+			  lt_start.tm_mon + 1, lt_start.tm_mday);
 }
 
 /* Calculate the difference in months between two dates. */
@@ -681,11 +863,6 @@ static long diff_years(struct tm lt_start, struct tm lt_end)
 	return lt_end.tm_year - lt_start.tm_year;
 }
 
-static int exc_inday(struct excp *exc, long *day_start)
-{
-	return (date_cmp_day(exc->st, *day_start) == 0);
-}
-
 /*
  * Check if the recurrent item belongs to the selected day, and if yes, store
  * the start date of the occurrence that belongs to the day in a buffer.
@@ -697,7 +874,7 @@ static int exc_inday(struct excp *exc, long *day_start)
  */
 unsigned
 recur_item_find_occurrence(long item_start, long item_dur,
-			   llist_t * item_exc, int rpt_type, int rpt_freq,
+			   struct exc_days *item_exc, int rpt_type, int rpt_freq,
 			   long rpt_until, long day_start,
 			   time_t *occurrence)
 {
@@ -712,16 +889,14 @@ recur_item_find_occurrence(long item_start, long item_dur,
 	if (rpt_until != 0 && day_start >= rpt_until + item_dur)
 		return 0;
 
-	t = day_start;
-	localtime_r(&t, &lt_day);
-
-	t = item_start;
-	localtime_r(&t, &lt_item);
+	civil_localtime(day_start, &lt_day);
+	civil_localtime(item_start, &lt_item);
 
 	lt_item_day = lt_item;
 	lt_item_day.tm_sec = lt_item_day.tm_min = lt_item_day.tm_hour = 0;
 
-	span = (item_start - mktime(&lt_item_day) + item_dur - 1) / DAYINSEC;
+	span = (item_start - civil_mktime(&lt_item_day) + item_dur - 1) /
+	       DAYINSEC;
 
 	switch (rpt_type) {
 	case RECUR_DAILY:
@@ -757,15 +932,15 @@ recur_item_find_occurrence(long item_start, long item_dur,
 	}
 
 	lt_item_day.tm_isdst = lt_day.tm_isdst;
-	t = mktime(&lt_item_day);
+	t = civil_mktime(&lt_item_day);
 
-	if (LLIST_FIND_FIRST(item_exc, &t, exc_inday))
+	if (exc_on_day(item_exc, civil_day(t)))
 		return 0;
 
 	if (rpt_until != 0 && t > rpt_until)
 		return 0;
 
-	localtime_r(&t, &lt_item_day);
+	civil_localtime(t, &lt_item_day);
 	diff = diff_days(lt_item_day, lt_day);
 
 	if (diff > span)
@@ -806,7 +981,7 @@ recur_event_find_occurrence(struct recur_event *rev, long day_start,
 
 /* Check if a recurrent item belongs to the selected day. */
 unsigned
-recur_item_inday(long item_start, long item_dur, llist_t * item_exc,
+recur_item_inday(long item_start, long item_dur, struct exc_days *item_exc,
 		 int rpt_type, int rpt_freq, long rpt_until,
 		 long day_start)
 {
@@ -831,10 +1006,516 @@ unsigned recur_event_inday(struct recur_event *rev, long *day_start)
 				rev->rpt->until, *day_start);
 }
 
+/*
+ * Day number of the nth occurrence of an item, not taking exceptions into
+ * account. Days that do not exist in a month overflow into the next one.
+ */
+static long recur_iter_day(struct recur_occurrence_iter *it, long n)
+{
+	long months;
+
+	switch (it->type) {
+	case RECUR_DAILY:
+		return it->first + n * it->freq;
+	case RECUR_WEEKLY:
+		return it->first + n * it->freq * WEEKINDAYS;
+	case RECUR_MONTHLY:
+		months = it->yyyy * YEARINMONTHS + it->mm - 1 + n * it->freq;
+		return civil_days(months / YEARINMONTHS,
+				       months % YEARINMONTHS + 1, 1) +
+		       it->dd - 1;
+	case RECUR_YEARLY:
+		return civil_days(it->yyyy + n * it->freq, it->mm, 1) +
+		       it->dd - 1;
+	default:
+		EXIT(_("unknown item type"));
+		/* NOTREACHED */
+	}
+
+	return 0;
+}
+
+/*
+ * Start time of an occurrence on a given day.
+ */
+static time_t recur_iter_start(struct recur_occurrence_iter *it, long day)
+{
+	struct date d;
+	int yyyy, mm, dd;
+
+	civil_date(day, &yyyy, &mm, &dd);
+	d.dd = dd;
+	d.mm = mm;
+	d.yyyy = yyyy;
+
+	return date2sec(d, it->hour, it->min);
+}
+
+/*
+ * Number of days after its first one an occurrence spills over into. This
+ * depends on the occurrence since days are shorter or longer than DAYINSEC
+ * when the clocks change.
+ */
+static long
+recur_iter_span(struct recur_occurrence_iter *it, long day, time_t start)
+{
+	if (it->dur <= 0)
+		return 0;
+
+	return civil_day(start + it->dur - 1) - day;
+}
+
+/*
+ * Initialize an iterator over the occurrences of a recurrent item. The first
+ * occurrence returned is the first one that has not ended before the day the
+ * given date belongs to. An item with a duration of zero only covers the day
+ * it starts on.
+ */
+void
+recur_occurrence_iter_init(struct recur_occurrence_iter *it, long start,
+			   long dur, struct exc_days *exc, struct rpt *rpt,
+			   long from)
+{
+	struct tm lt;
+	long span, from_day, day, n;
+
+	civil_localtime(start, &lt);
+
+	it->dur = dur;
+	it->exc = exc;
+	it->type = rpt->type;
+	it->freq = rpt->freq;
+	it->until = rpt->until ? civil_day(rpt->until) : 0;
+	it->yyyy = lt.tm_year + 1900;
+	it->mm = lt.tm_mon + 1;
+	it->dd = lt.tm_mday;
+	it->hour = lt.tm_hour;
+	it->min = lt.tm_min;
+	it->first = civil_days(it->yyyy, it->mm, it->dd);
+	it->span = 0;
+	it->n = 0;
+	it->day = 0;
+
+	if (it->freq <= 0)
+		return;
+
+	/*
+	 * Upper bound of the number of days an occurrence spills over into,
+	 * with one day to spare for clock changes.
+	 */
+	span = dur > 0 ? (lt.tm_hour * HOURINSEC + lt.tm_min * MININSEC +
+			  lt.tm_sec + dur - 1) / DAYINSEC + 1 : 0;
+	from_day = civil_day(from);
+
+	/* Jump close to the first relevant occurrence... */
+	switch (it->type) {
+	case RECUR_DAILY:
+		n = (from_day - span - it->first) / it->freq;
+		break;
+	case RECUR_WEEKLY:
+		n = (from_day - span - it->first) / (it->freq * WEEKINDAYS);
+		break;
+	case RECUR_MONTHLY:
+		n = ((from_day - span - it->first) / 31 - 1) / it->freq;
+		break;
+	case RECUR_YEARLY:
+		n = ((from_day - span - it->first) / 366 - 1) / it->freq;
+		break;
+	default:
+		EXIT(_("unknown item type"));
+		/* NOTREACHED */
+	}
+
+	/* ...and step forward to reach it. */
+	for (it->n = n > 0 ? n : 0;; it->n++) {
+		day = recur_iter_day(it, it->n);
+		if (day >= from_day || day + recur_iter_span(it, day,
+		    recur_iter_start(it, day)) >= from_day)
+			break;
+	}
+}
+
+void
+recur_apoint_iter_init(struct recur_occurrence_iter *it,
+		       struct recur_apoint *rapt, long from)
+{
+	recur_occurrence_iter_init(it, rapt->start, rapt->dur, &rapt->exc,
+				   rapt->rpt, from);
+}
+
+void
+recur_event_iter_init(struct recur_occurrence_iter *it,
+		      struct recur_event *rev, long from)
+{
+	recur_occurrence_iter_init(it, rev->day, 0, &rev->exc, rev->rpt,
+				   from);
+}
+
+/*
+ * Store the start time of the next occurrence in a buffer. Returns 0 if there
+ * are no more occurrences.
+ */
+int recur_occurrence_iter_next(struct recur_occurrence_iter *it,
+			       time_t *occurrence)
+{
+	long day;
+
+	if (it->freq <= 0)
+		return 0;
+
+	for (;;) {
+		day = recur_iter_day(it, it->n);
+		if (it->until && day > it->until)
+			return 0;
+		it->n++;
+		if (!exc_on_day(it->exc, day))
+			break;
+	}
+
+	it->day = day;
+	*occurrence = recur_iter_start(it, day);
+	it->span = recur_iter_span(it, day, *occurrence);
+
+	return 1;
+}
+
+/*
+ * Cache of the occurrences of all recurrent items, one month at a time. The
+ * first time a day of a month is looked at, the occurrences of every recurrent
+ * item within that month are expanded into an array sorted by day. The most
+ * recently used months are kept until an item they contain is modified, in
+ * which case only the entries of that item are recomputed.
+ */
+#define RECUR_CACHE_MONTHS 24
+
+struct recur_month {
+	int valid;
+	long first;		/* day number of the first day of the month */
+	long last;		/* day number of the last day of the month */
+	unsigned long used;	/* time of last use, for eviction */
+	unsigned count;
+	unsigned size;
+	struct recur_occ *occ;
+};
+
+static struct recur_month recur_cache[RECUR_CACHE_MONTHS];
+static unsigned long recur_cache_clock;
+static pthread_mutex_t recur_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int recur_occ_cmp(const void *a, const void *b)
+{
+	const struct recur_occ *oa = a, *ob = b;
+
+	if (oa->day < ob->day)
+		return -1;
+	if (oa->day > ob->day)
+		return 1;
+
+	return 0;
+}
+
+static void recur_month_add(struct recur_month *m, long day, long start,
+			    enum day_item_type type, union aptev_ptr item)
+{
+	if (m->count >= m->size) {
+		m->size = m->size ? 2 * m->size : 64;
+		m->occ = mem_realloc(m->occ, m->size,
+				     sizeof(struct recur_occ));
+	}
+
+	m->occ[m->count].day = day;
+	m->occ[m->count].start = start;
+	m->occ[m->count].type = type;
+	m->occ[m->count].item = item;
+	m->count++;
+}
+
+/*
+ * Add the occurrences of an item to a month. A day the item spans is
+ * associated with the latest occurrence covering it.
+ */
+static void recur_month_expand(struct recur_month *m,
+			       struct recur_occurrence_iter *it,
+			       enum day_item_type type, union aptev_ptr item)
+{
+	long start[31];
+	char set[31] = { 0 };
+	long d, from, to;
+	time_t occurrence;
+
+	while (recur_occurrence_iter_next(it, &occurrence)) {
+		if (it->day > m->last)
+			break;
+		from = it->day > m->first ? it->day : m->first;
+		to = it->day + it->span < m->last ? it->day + it->span :
+		     m->last;
+		for (d = from; d <= to; d++) {
+			start[d - m->first] = occurrence;
+			set[d - m->first] = 1;
+		}
+	}
+
+	for (d = m->first; d <= m->last; d++) {
+		if (set[d - m->first])
+			recur_month_add(m, d, start[d - m->first], type, item);
+	}
+}
+
+static long recur_month_start(struct recur_month *m)
+{
+	struct date d;
+	int yyyy, mm, dd;
+
+	civil_date(m->first, &yyyy, &mm, &dd);
+	d.dd = dd;
+	d.mm = mm;
+	d.yyyy = yyyy;
+
+	return date2sec(d, 0, 0);
+}
+
+static void recur_month_expand_apoint(struct recur_month *m,
+				      struct recur_apoint *rapt)
+{
+	struct recur_occurrence_iter it;
+	union aptev_ptr p;
+
+	p.rapt = rapt;
+	recur_apoint_iter_init(&it, rapt, recur_month_start(m));
+	recur_month_expand(m, &it, RECUR_APPT, p);
+}
+
+static void recur_month_expand_event(struct recur_month *m,
+				     struct recur_event *rev)
+{
+	struct recur_occurrence_iter it;
+	union aptev_ptr p;
+
+	p.rev = rev;
+	recur_event_iter_init(&it, rev, recur_month_start(m));
+	recur_month_expand(m, &it, RECUR_EVNT, p);
+}
+
+static void recur_month_sort(struct recur_month *m)
+{
+	qsort(m->occ, m->count, sizeof(struct recur_occ), recur_occ_cmp);
+}
+
+/* Get the cached month containing a given day, building it if needed. */
+static struct recur_month *recur_cache_get(long day)
+{
+	struct recur_month *m = NULL;
+	llist_item_t *i;
+	int yyyy, mm, dd, n;
+	long first;
+
+	civil_date(day, &yyyy, &mm, &dd);
+	first = day - dd + 1;
+
+	for (n = 0; n < RECUR_CACHE_MONTHS; n++) {
+		struct recur_month *c = &recur_cache[n];
+		if (c->valid && c->first == first) {
+			c->used = ++recur_cache_clock;
+			return c;
+		}
+		if (!m || (m->valid && (!c->valid || c->used < m->used)))
+			m = c;
+	}
+
+	m->valid = 1;
+	m->first = first;
+	if (mm == 12)
+		m->last = civil_days(yyyy + 1, 1, 1) - 1;
+	else
+		m->last = civil_days(yyyy, mm + 1, 1) - 1;
+	m->used = ++recur_cache_clock;
+	m->count = 0;
+
+	LLIST_FOREACH(&recur_elist, i)
+		recur_month_expand_event(m, LLIST_GET_DATA(i));
+
+	LLIST_TS_LOCK(&recur_alist_p);
+	LLIST_TS_FOREACH(&recur_alist_p, i)
+		recur_month_expand_apoint(m, LLIST_TS_GET_DATA(i));
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	recur_month_sort(m);
+
+	return m;
+}
+
+/* Remove all entries of an item from the cache. */
+static void recur_cache_remove(void *item)
+{
+	unsigned i, j;
+	int n;
+
+	for (n = 0; n < RECUR_CACHE_MONTHS; n++) {
+		struct recur_month *m = &recur_cache[n];
+
+		if (!m->valid)
+			continue;
+		for (i = j = 0; i < m->count; i++) {
+			if (m->occ[i].item.rapt != item)
+				m->occ[j++] = m->occ[i];
+		}
+		m->count = j;
+	}
+}
+
+/* Drop all cached months. */
+void recur_cache_flush(void)
+{
+	int n;
+
+	pthread_mutex_lock(&recur_cache_mutex);
+	for (n = 0; n < RECUR_CACHE_MONTHS; n++)
+		recur_cache[n].valid = 0;
+	pthread_mutex_unlock(&recur_cache_mutex);
+}
+
+static void recur_cache_update_apoint(struct recur_apoint *rapt, int keep)
+{
+	int n;
+
+	pthread_mutex_lock(&recur_cache_mutex);
+	recur_cache_remove(rapt);
+	for (n = 0; keep && n < RECUR_CACHE_MONTHS; n++) {
+		if (recur_cache[n].valid) {
+			recur_month_expand_apoint(&recur_cache[n], rapt);
+			recur_month_sort(&recur_cache[n]);
+		}
+	}
+	pthread_mutex_unlock(&recur_cache_mutex);
+}
+
+static void recur_cache_update_event(struct recur_event *rev, int keep)
+{
+	int n;
+
+	pthread_mutex_lock(&recur_cache_mutex);
+	recur_cache_remove(rev);
+	for (n = 0; keep && n < RECUR_CACHE_MONTHS; n++) {
+		if (recur_cache[n].valid) {
+			recur_month_expand_event(&recur_cache[n], rev);
+			recur_month_sort(&recur_cache[n]);
+		}
+	}
+	pthread_mutex_unlock(&recur_cache_mutex);
+}
+
+/*
+ * Call fn_visit on each occurrence of a recurrent item on the day containing
+ * the given date, events first. Stops as soon as fn_visit returns a non-zero
+ * value, and returns that value.
+ */
+int recur_foreach_occurrence(long date, recur_fn_visit_t fn_visit, void *arg)
+{
+	struct recur_month *m;
+	long day = civil_day(date);
+	unsigned lo, hi, mid;
+	int ret = 0;
+
+	pthread_mutex_lock(&recur_cache_mutex);
+	m = recur_cache_get(day);
+
+	lo = 0;
+	hi = m->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (m->occ[mid].day < day)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < m->count && m->occ[lo].day == day; lo++) {
+		ret = fn_visit(&m->occ[lo], arg);
+		if (ret)
+			break;
+	}
+	pthread_mutex_unlock(&recur_cache_mutex);
+
+	return ret;
+}
+
+/*
+ * Call fn_visit on each occurrence of a recurrent item on the days containing
+ * the dates of [from, to), in the order of the days. Within a day, the order
+ * is the same as for recur_foreach_occurrence().
+ */
+int recur_foreach_occurrence_range(long from, long to,
+				   recur_fn_visit_t fn_visit, void *arg)
+{
+	struct recur_month *m;
+	long day, last;
+	unsigned i;
+	int ret = 0;
+
+	if (from >= to)
+		return 0;
+
+	day = civil_day(from);
+	last = civil_day(to - 1);
+
+	pthread_mutex_lock(&recur_cache_mutex);
+	while (!ret && day <= last) {
+		m = recur_cache_get(day);
+		for (i = 0; i < m->count && m->occ[i].day <= last; i++) {
+			if (m->occ[i].day < day)
+				continue;
+			ret = fn_visit(&m->occ[i], arg);
+			if (ret)
+				break;
+		}
+		day = m->last + 1;
+	}
+	pthread_mutex_unlock(&recur_cache_mutex);
+
+	return ret;
+}
+
+/*
+ * Update the position and the cached occurrences of a recurrent appointment
+ * that was modified in place.
+ */
+void recur_apoint_update(struct recur_apoint *rapt)
+{
+	llist_item_t *i;
+
+	LLIST_TS_LOCK(&recur_alist_p);
+	i = LLIST_TS_FIND_FIRST(&recur_alist_p, rapt, NULL);
+	if (!i)
+		EXIT(_("appointment not found"));
+	LLIST_TS_REMOVE(&recur_alist_p, i);
+	LLIST_TS_ADD_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
+	LLIST_TS_UNLOCK(&recur_alist_p);
+
+	recur_cache_update_apoint(rapt, 1);
+}
+
+/*
+ * Update the position and the cached occurrences of a recurrent event that
+ * was modified in place.
+ */
+void recur_event_update(struct recur_event *rev)
+{
+	llist_item_t *i;
+
+	i = LLIST_FIND_FIRST(&recur_elist, rev, NULL);
+	if (!i)
+		EXIT(_("event not found"));
+	LLIST_REMOVE(&recur_elist, i);
+	LLIST_ADD_SORTED(&recur_elist, rev, recur_event_cmp);
+
+	recur_cache_update_event(rev, 1);
+}
+
 /* Add an exception to a recurrent event. */
 void recur_event_add_exc(struct recur_event *rev, long date)
 {
-	recur_add_exc(&rev->exc, date);
+	recur_exc_add(&rev->exc, date);
+	recur_cache_update_event(rev, 1);
 }
 
 /* Add an exception to a recurrent appointment. */
@@ -844,7 +1525,8 @@ void recur_apoint_add_exc(struct recur_apoint *rapt, long date)
 
 	if (notify_bar())
 		need_check_notify = notify_same_recur_item(rapt);
-	recur_add_exc(&rapt->exc, date);
+	recur_exc_add(&rapt->exc, date);
+	recur_cache_update_apoint(rapt, 1);
 	if (need_check_notify)
 		notify_check_next_app(0);
 }
@@ -855,12 +1537,13 @@ void recur_apoint_add_exc(struct recur_apoint *rapt, long date)
  */
 void recur_event_erase(struct recur_event *rev)
 {
-	llist_item_t *i = LLIST_FIND_FIRST(&recur_elist, rev, NULL);
+	llist_item_t *i = LLIST_FIND_SORTED(&recur_elist, rev, recur_event_cmp);
 
 	if (!i)
 		EXIT(_("event not found"));
 
 	LLIST_REMOVE(&recur_elist, i);
+	recur_cache_update_event(rev, 0);
 }
 
 /*
@@ -871,7 +1554,7 @@ void recur_apoint_erase(struct recur_apoint *rapt)
 {
 	LLIST_TS_LOCK(&recur_alist_p);
 
-	llist_item_t *i = LLIST_TS_FIND_FIRST(&recur_alist_p, rapt, NULL);
+	llist_item_t *i = LLIST_TS_FIND_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
 	int need_check_notify = 0;
 
 	if (!i)
@@ -884,37 +1567,7 @@ void recur_apoint_erase(struct recur_apoint *rapt)
 		notify_check_next_app(0);
 
 	LLIST_TS_UNLOCK(&recur_alist_p);
-}
-
-/*
- * Read days for which recurrent items must not be repeated
- * (such days are called exceptions).
- */
-void recur_exc_scan(llist_t * lexc, FILE * data_file)
-{
-	int c = 0;
-	struct tm day;
-
-	LLIST_INIT(lexc);
-	while ((c = getc(data_file)) == '!') {
-		ungetc(c, data_file);
-		if (fscanf(data_file, "!%d / %d / %d ",
-			   &day.tm_mon, &day.tm_mday, &day.tm_year) != 3) {
-			EXIT(_("syntax error in item date"));
-		}
-
-		EXIT_IF(!check_date(day.tm_year, day.tm_mon, day.tm_mday),
-			_("date error in item exception"));
-
-		day.tm_hour = 0;
-		day.tm_min = day.tm_sec = 0;
-		day.tm_isdst = -1;
-		day.tm_year -= 1900;
-		day.tm_mon--;
-		struct excp *exc = mem_malloc(sizeof(struct excp));
-		exc->st = mktime(&day);
-		LLIST_ADD(lexc, exc);
-	}
+	recur_cache_update_apoint(rapt, 0);
 }
 
 static int recur_apoint_starts_before(struct recur_apoint *rapt, long *time)
@@ -927,10 +1580,11 @@ static int recur_apoint_starts_before(struct recur_apoint *rapt, long *time)
  * stored in the notify_app structure (which is the next item to be notified).
  */
 struct notify_app *recur_apoint_check_next(struct notify_app *app,
-					   long start, long day)
+					   long start)
 {
 	llist_item_t *i;
-	time_t real_recur_start_time;
+	struct recur_occurrence_iter it;
+	time_t occurrence;
 
 	LLIST_TS_LOCK(&recur_alist_p);
 	/*
@@ -947,14 +1601,16 @@ struct notify_app *recur_apoint_check_next(struct notify_app *app,
 		 * Check whether the recurrent appointment contains an
 		 * occurrence which is the next item to be notified.
 		 */
-		if (recur_apoint_find_occurrence
-		    (rapt, day, &real_recur_start_time)
-		    && real_recur_start_time > start
-		    && real_recur_start_time < app->time) {
-			app->time = real_recur_start_time;
-			app->txt = mem_strdup(rapt->mesg);
-			app->state = rapt->state;
-			app->got_app = 1;
+		recur_apoint_iter_init(&it, rapt, start);
+		while (recur_occurrence_iter_next(&it, &occurrence) &&
+		       occurrence < app->time) {
+			if (occurrence > start) {
+				app->time = occurrence;
+				app->txt = mem_strdup(rapt->mesg);
+				app->state = rapt->state;
+				app->got_app = 1;
+				break;
+			}
 		}
 	}
 	LLIST_TS_UNLOCK(&recur_alist_p);
@@ -977,7 +1633,8 @@ void recur_apoint_switch_notify(struct recur_apoint *rapt)
 void recur_event_paste_item(struct recur_event *rev, long date)
 {
 	long time_shift;
-	llist_item_t *i;
+
+	exc_shift(&rev->exc, civil_day(date) - civil_day(rev->day));
 
 	time_shift = date - rev->day;
 	rev->day += time_shift;
@@ -985,18 +1642,15 @@ void recur_event_paste_item(struct recur_event *rev, long date)
 	if (rev->rpt->until != 0)
 		rev->rpt->until += time_shift;
 
-	LLIST_FOREACH(&rev->exc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		exc->st += time_shift;
-	}
-
 	LLIST_ADD_SORTED(&recur_elist, rev, recur_event_cmp);
+	recur_cache_update_event(rev, 1);
 }
 
 void recur_apoint_paste_item(struct recur_apoint *rapt, long date)
 {
 	long time_shift;
-	llist_item_t *i;
+
+	exc_shift(&rapt->exc, civil_day(date) - civil_day(rapt->start));
 
 	time_shift = (date + get_item_time(rapt->start)) - rapt->start;
 	rapt->start += time_shift;
@@ -1004,14 +1658,10 @@ void recur_apoint_paste_item(struct recur_apoint *rapt, long date)
 	if (rapt->rpt->until != 0)
 		rapt->rpt->until += time_shift;
 
-	LLIST_FOREACH(&rapt->exc, i) {
-		struct excp *exc = LLIST_GET_DATA(i);
-		exc->st += time_shift;
-	}
-
 	LLIST_TS_LOCK(&recur_alist_p);
 	LLIST_TS_ADD_SORTED(&recur_alist_p, rapt, recur_apoint_cmp);
 	LLIST_TS_UNLOCK(&recur_alist_p);
+	recur_cache_update_apoint(rapt, 1);
 
 	if (notify_bar())
 		notify_check_repeated(rapt);
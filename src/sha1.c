@@ -75,13 +75,17 @@ static void sha1_transform(uint32_t state[5], const uint8_t buffer[64])
 		uint32_t l[16];
 	} b64_t;
 
-	b64_t *block = (b64_t *) buffer;
+	b64_t workspace;
+	b64_t *block = &workspace;
 	uint32_t a = state[0];
 	uint32_t b = state[1];
 	uint32_t c = state[2];
 	uint32_t d = state[3];
 	uint32_t e = state[4];
 
+	/* Work on a copy so that read-only input (e.g. a mapping) is fine. */
+	memcpy(block, buffer, 64);
+
 	R0(a, b, c, d, e, 0);
 	R0(e, a, b, c, d, 1);
 	R0(d, e, a, b, c, 2);
@@ -232,23 +236,44 @@ void sha1_final(sha1_ctx_t * ctx, uint8_t digest[SHA1_DIGESTLEN])
 	memset(&finalcount, 0, 8);
 }
 
-void sha1_digest(const char *data, char *buffer)
+/*
+ * Hash data of any length. This is the same as sha1_update(), but the length
+ * is not limited to what an unsigned int can hold.
+ */
+void sha1_update_buffer(sha1_ctx_t * ctx, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	unsigned int n;
+
+	while (len > 0) {
+		n = len > BUFSIZ ? BUFSIZ : len;
+		sha1_update(ctx, p, n);
+		p += n;
+		len -= n;
+	}
+}
+
+/* Finish a hash and write its digest to a hexadecimal string. */
+void sha1_final_hex(sha1_ctx_t * ctx, char *buffer)
 {
-	char *buf = strdup(data);
-	sha1_ctx_t ctx;
 	uint8_t digest[SHA1_DIGESTLEN];
 	int i;
 
-	sha1_init(&ctx);
-	sha1_update(&ctx, (const uint8_t *)buf, strlen(buf));
-	sha1_final(&ctx, (uint8_t *) digest);
+	sha1_final(ctx, (uint8_t *) digest);
 
 	for (i = 0; i < SHA1_DIGESTLEN; i++) {
 		snprintf(buffer, 3, "%02x", digest[i]);
 		buffer += sizeof(char) * 2;
 	}
+}
+
+void sha1_digest(const char *data, char *buffer)
+{
+	sha1_ctx_t ctx;
 
-	free(buf);
+	sha1_init(&ctx);
+	sha1_update_buffer(&ctx, data, strlen(data));
+	sha1_final_hex(&ctx, buffer);
 }
 
 void sha1_stream(FILE * fp, char *buffer)
@@ -256,8 +281,6 @@ void sha1_stream(FILE * fp, char *buffer)
 	sha1_ctx_t ctx;
 	uint8_t data[BUFSIZ];
 	size_t bytes_read;
-	uint8_t digest[SHA1_DIGESTLEN];
-	int i;
 
 	sha1_init(&ctx);
 
@@ -266,10 +289,14 @@ void sha1_stream(FILE * fp, char *buffer)
 		sha1_update(&ctx, data, bytes_read);
 	}
 
-	sha1_final(&ctx, (uint8_t *) digest);
+	sha1_final_hex(&ctx, buffer);
+}
 
-	for (i = 0; i < SHA1_DIGESTLEN; i++) {
-		snprintf(buffer, 3, "%02x", digest[i]);
-		buffer += sizeof(char) * 2;
-	}
+void sha1_buffer(const void *data, size_t len, char *buffer)
+{
+	sha1_ctx_t ctx;
+
+	sha1_init(&ctx);
+	sha1_update_buffer(&ctx, data, len);
+	sha1_final_hex(&ctx, buffer);
 }
@@ -35,6 +35,7 @@
  */
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "calcurse.h"
 
@@ -100,6 +101,64 @@ int string_catf(struct string *sb, const char *format, ...)
 	return n;
 }
 
+/*
+ * The following functions append common items without going through
+ * vsnprintf(), which is comparatively slow when saving thousands of items.
+ */
+int string_catn(struct string *sb, const char *str, int n)
+{
+	string_grow(sb, sb->len + n + 1);
+	memcpy(sb->buf + sb->len, str, n);
+	sb->len += n;
+	sb->buf[sb->len] = '\0';
+
+	return n;
+}
+
+int string_cat(struct string *sb, const char *str)
+{
+	return string_catn(sb, str, strlen(str));
+}
+
+int string_catc(struct string *sb, char c)
+{
+	return string_catn(sb, &c, 1);
+}
+
+/* Append an integer, padded with zeros to at least width digits. */
+int string_catint(struct string *sb, int val, int width)
+{
+	char buf[3 * sizeof(int) + 2];
+	char *p = buf + sizeof(buf);
+	unsigned u = val < 0 ? -(unsigned)val : (unsigned)val;
+
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+		width--;
+	} while (u > 0);
+	while (width-- > 0 && p > buf + 1)
+		*--p = '0';
+	if (val < 0)
+		*--p = '-';
+
+	return string_catn(sb, p, buf + sizeof(buf) - p);
+}
+
+/* Append a date in the format of the data files, mm/dd/yyyy. */
+int string_catdate(struct string *sb, int year, int month, int day)
+{
+	int n;
+
+	n = string_catint(sb, month, 2);
+	n += string_catc(sb, '/');
+	n += string_catint(sb, day, 2);
+	n += string_catc(sb, '/');
+	n += string_catint(sb, year, 4);
+
+	return n;
+}
+
 int string_printf(struct string *sb, const char *format, ...)
 {
 	va_list	ap;
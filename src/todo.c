@@ -88,30 +88,44 @@ struct todo *todo_add(char *mesg, int id, int completed, char *note)
 {
 	struct todo *todo;
 
-	todo = mem_malloc(sizeof(struct todo));
-	todo->mesg = mem_strdup(mesg);
+	todo = mem_arena_malloc(sizeof(struct todo));
+	todo->mesg = mem_arena_strdup(mesg);
 	todo->id = id;
 	todo->completed = completed;
 	todo->note = (note != NULL
-		      && note[0] != '\0') ? mem_strdup(note) : NULL;
+		      && note[0] != '\0') ? mem_arena_strdup(note) : NULL;
 
 	LLIST_ADD_SORTED(&todolist, todo, todo_cmp);
 
 	return todo;
 }
 
+/* Append a todo item in the format of the data file. */
+void todo_catstr(struct string *s, struct todo *todo)
+{
+	string_catc(s, '[');
+	if (todo->completed)
+		string_catc(s, '-');
+	string_catint(s, todo->id, 0);
+	string_catc(s, ']');
+	if (todo->note) {
+		string_catc(s, '>');
+		string_cat(s, todo->note);
+		string_catc(s, ' ');
+	} else {
+		string_catc(s, ' ');
+	}
+	string_cat(s, todo->mesg);
+}
+
 char *todo_tostr(struct todo *todo)
 {
-	char *res;
-	const char *cstr = todo->completed ? "-" : "";
+	struct string s;
 
-	if (todo->note)
-		asprintf(&res, "[%s%d]>%s %s", cstr, todo->id, todo->note,
-			 todo->mesg);
-	else
-		asprintf(&res, "[%s%d] %s", cstr, todo->id, todo->mesg);
+	string_init(&s);
+	todo_catstr(&s, todo);
 
-	return res;
+	return string_buf(&s);
 }
 
 char *todo_hash(struct todo *todo)
@@ -142,7 +156,7 @@ void todo_delete_note(struct todo *todo)
 /* Delete an item from the todo linked list. */
 void todo_delete(struct todo *todo)
 {
-	llist_item_t *i = LLIST_FIND_FIRST(&todolist, todo, NULL);
+	llist_item_t *i = LLIST_FIND_SORTED(&todolist, todo, todo_cmp);
 
 	if (!i)
 		EXIT(_("no such todo"));
@@ -225,3 +239,27 @@ void todo_free_list(void)
 	LLIST_FREE_INNER(&todolist, todo_free);
 	LLIST_FREE(&todolist);
 }
+
+/*
+ * Remove and free the todo items for which fn_match returns a non-zero value
+ * when passed their representation in the data file.
+ */
+void todo_llist_drop(item_fn_match_t fn_match, void *arg)
+{
+	llist_item_t *i, *next;
+	struct todo *todo;
+	char *str;
+	int match;
+
+	for (i = LLIST_FIRST(&todolist); i; i = next) {
+		next = LLIST_NEXT(i);
+		todo = LLIST_GET_DATA(i);
+		str = todo_tostr(todo);
+		match = fn_match(str, arg);
+		mem_free(str);
+		if (!match)
+			continue;
+		LLIST_REMOVE(&todolist, i);
+		todo_free(todo);
+	}
+}
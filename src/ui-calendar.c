@@ -54,9 +54,23 @@ static void (*draw_calendar[CAL_VIEWS]) (struct scrollwin *, struct date *,
 					 unsigned) = {
 draw_monthly_view, draw_weekly_view};
 
-static int monthly_view_cache[MAXDAYSPERMONTH];
-static int monthly_view_cache_valid = 0;
-static int monthly_view_cache_month = 0;
+/*
+ * Occupancy of the days of the years visited so far, two bits per day. Each
+ * entry holds the value of day_check_if_item() for that day: no item, only
+ * recurrent items or regular items.
+ */
+struct day_cache {
+	unsigned year;
+	int valid;
+	unsigned char occ[(YEARINDAYS + 1 + 3) / 4];
+};
+
+static struct day_cache *day_cache;
+static unsigned day_cache_count = 0;
+static unsigned day_cache_size = 0;
+static pthread_mutex_t day_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int monthly_view_month = 0;
 
 /* Switch between calendar views (monthly view is selected by default). */
 void ui_calendar_view_next(void)
@@ -236,9 +250,140 @@ static long ymd_to_scalar(unsigned year, unsigned month, unsigned day)
 	return scalar;
 }
 
-void ui_calendar_monthly_view_cache_set_invalid(void)
+static unsigned day_cache_get(struct day_cache *c, unsigned yday)
+{
+	return (c->occ[yday / 4] >> (yday % 4 * 2)) & 3;
+}
+
+static void day_cache_set(struct day_cache *c, unsigned yday, unsigned v)
+{
+	c->occ[yday / 4] &= ~(3 << (yday % 4 * 2));
+	c->occ[yday / 4] |= v << (yday % 4 * 2);
+}
+
+static unsigned day_cache_ndays(unsigned year)
+{
+	return ISLEAP(year) ? YEARINDAYS + 1 : YEARINDAYS;
+}
+
+/*
+ * Return the occupancy of the days of the given year, computing it with a
+ * single pass over the item lists if needed. Must be called with
+ * day_cache_mutex held.
+ */
+static struct day_cache *day_cache_year(unsigned year)
+{
+	unsigned char occ[YEARINDAYS + 1];
+	struct date jan1 = { 1, 1, year };
+	struct day_cache *c;
+	unsigned i, ndays;
+
+	for (i = 0; i < day_cache_count; i++) {
+		if (day_cache[i].year == year)
+			break;
+	}
+
+	if (i == day_cache_count) {
+		if (!day_cache) {
+			day_cache_size = 4;
+			day_cache = mem_malloc(day_cache_size *
+					       sizeof(struct day_cache));
+		} else if (day_cache_count == day_cache_size) {
+			day_cache_size *= 2;
+			day_cache = mem_realloc(day_cache, day_cache_size,
+						sizeof(struct day_cache));
+		}
+		day_cache[day_cache_count].year = year;
+		day_cache[day_cache_count].valid = 0;
+		day_cache_count++;
+	}
+	c = &day_cache[i];
+
+	if (!c->valid) {
+		ndays = day_cache_ndays(year);
+		day_check_range(date2sec(jan1, 0, 0), ndays, occ);
+		memset(c->occ, 0, sizeof(c->occ));
+		for (i = 0; i < ndays; i++)
+			day_cache_set(c, i, occ[i]);
+		c->valid = 1;
+	}
+
+	return c;
+}
+
+/* Return the occupancy of a day, as day_check_if_item() does. */
+static unsigned day_cache_lookup(struct date day)
+{
+	unsigned v;
+	long yday;
+
+	yday = civil_days(day.yyyy, day.mm, day.dd) -
+	       civil_days(day.yyyy, 1, 1);
+
+	pthread_mutex_lock(&day_cache_mutex);
+	v = day_cache_get(day_cache_year(day.yyyy), yday);
+	pthread_mutex_unlock(&day_cache_mutex);
+
+	return v;
+}
+
+/* Mark the occupancy of all the years visited so far as outdated. */
+void ui_calendar_day_cache_set_invalid(void)
 {
-	monthly_view_cache_valid = 0;
+	unsigned i;
+
+	pthread_mutex_lock(&day_cache_mutex);
+	for (i = 0; i < day_cache_count; i++)
+		day_cache[i].valid = 0;
+	pthread_mutex_unlock(&day_cache_mutex);
+}
+
+/*
+ * Refresh the occupancy of the days overlapping [start, end), e.g. after a
+ * single item was added or removed, instead of computing the occupancy of
+ * whole years again.
+ */
+void ui_calendar_day_cache_update(long start, long end)
+{
+	struct day_cache *c;
+	struct date day;
+	long first, last, jan1, from, to, n;
+	unsigned i;
+	int y, m, d;
+
+	first = civil_day(start);
+	last = civil_day(end - 1);
+
+	pthread_mutex_lock(&day_cache_mutex);
+	for (i = 0; i < day_cache_count; i++) {
+		c = &day_cache[i];
+		if (!c->valid)
+			continue;
+
+		jan1 = civil_days(c->year, 1, 1);
+		from = first > jan1 ? first : jan1;
+		to = jan1 + day_cache_ndays(c->year) - 1;
+		if (last < to)
+			to = last;
+		for (n = from; n <= to; n++) {
+			civil_date(n, &y, &m, &d);
+			day.dd = d;
+			day.mm = m;
+			day.yyyy = y;
+			day_cache_set(c, n - jan1, day_check_if_item(day));
+		}
+	}
+	pthread_mutex_unlock(&day_cache_mutex);
+}
+
+void ui_calendar_day_cache_free(void)
+{
+	pthread_mutex_lock(&day_cache_mutex);
+	if (day_cache)
+		mem_free(day_cache);
+	day_cache = NULL;
+	day_cache_count = day_cache_size = 0;
+	pthread_mutex_unlock(&day_cache_mutex);
 }
 
 static int weeknum(const struct tm *t, int firstweekday)
@@ -348,8 +493,9 @@ static void
 draw_monthly_view(struct scrollwin *sw, struct date *current_day,
 		  unsigned sunday_first)
 {
-	struct date check_day;
+	struct day_cache *cache;
 	int c_day, c_day_1, day_1_sav, numdays, j;
+	long yday;
 	unsigned yr, mo;
 	int w, ofs_x, ofs_y;
 	int item_this_day = 0;
@@ -383,7 +529,7 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day,
 
 	/* Write the current month and year on top of the calendar */
 	WINS_CALENDAR_LOCK;
-	if (yr * YEARINMONTHS + mo != monthly_view_cache_month) {
+	if (yr * YEARINMONTHS + mo != monthly_view_month) {
 		/* erase the window if a new month is selected */
 		werase(sw_cal.inner);
 	}
@@ -405,26 +551,17 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day,
 
 	day_1_sav = (c_day_1 + 1) * 3 + c_day_1 - 7;
 
-	/* invalidate cache if a new month is selected */
-	if (yr * YEARINMONTHS + mo != monthly_view_cache_month) {
-		monthly_view_cache_month = yr * YEARINMONTHS + mo;
-		monthly_view_cache_valid = 0;
-	}
+	monthly_view_month = yr * YEARINMONTHS + mo;
+
+	pthread_mutex_lock(&day_cache_mutex);
+	cache = day_cache_year(yr);
+	yday = civil_days(yr, mo, 1) - civil_days(yr, 1, 1);
 
 	for (c_day = 1; c_day <= numdays; ++c_day, ++c_day_1, c_day_1 %= 7) {
 		unsigned attr;
 
-		check_day.dd = c_day;
-		check_day.mm = slctd_day.mm;
-		check_day.yyyy = slctd_day.yyyy;
-
 		/* check if the day contains an event or an appointment */
-		if (monthly_view_cache_valid) {
-			item_this_day = monthly_view_cache[c_day - 1];
-		} else {
-			item_this_day = monthly_view_cache[c_day - 1] =
-			    day_check_if_item(check_day);
-		}
+		item_this_day = day_cache_get(cache, yday + c_day - 1);
 
 		/* Go to next line, the week is over. */
 		if (!c_day_1 && 1 != c_day) {
@@ -455,8 +592,41 @@ draw_monthly_view(struct scrollwin *sw, struct date *current_day,
 			custom_remove_attr(sw->inner, attr);
 		WINS_CALENDAR_UNLOCK;
 	}
+	pthread_mutex_unlock(&day_cache_mutex);
+}
+
+/*
+ * Draw the slices indicating appointment times of the jth day of the weekly
+ * view. Busy slices are highlighted with the given attribute, if any.
+ */
+static void
+draw_weekly_slices(struct scrollwin *sw, int offy, int offx, int j,
+		   int *slices, int nslices, unsigned attr)
+{
+	int i;
 
-	monthly_view_cache_valid = 1;
+	for (i = 0; i < nslices; i++) {
+		if (j != WEEKINDAYS - 1 && i != nslices - 1) {
+			WINS_CALENDAR_LOCK;
+			mvwhline(sw->inner, offy + 2 + i, offx + 3 + 4 * j,
+				 ACS_S9, 2);
+			WINS_CALENDAR_UNLOCK;
+		}
+		if (slices[i]) {
+			WINS_CALENDAR_LOCK;
+			if (attr)
+				custom_apply_attr(sw->inner, attr);
+			wattron(sw->inner, A_REVERSE);
+			mvwaddstr(sw->inner, offy + 2 + i, offx + 1 + 4 * j,
+				  " ");
+			mvwaddstr(sw->inner, offy + 2 + i, offx + 2 + 4 * j,
+				  " ");
+			wattroff(sw->inner, A_REVERSE);
+			if (attr)
+				custom_remove_attr(sw->inner, attr);
+			WINS_CALENDAR_UNLOCK;
+		}
+	}
 }
 
 /* Draw the weekly view inside calendar panel. */
@@ -467,7 +637,10 @@ draw_weekly_view(struct scrollwin *sw, struct date *current_day,
 #define DAYSLICESNO  6
 	const int WCALWIDTH = 28;
 	struct tm t;
+	struct date date;
 	int OFFY, OFFX, j;
+	int slices[WEEKINDAYS * DAYSLICESNO];
+	unsigned valid[WEEKINDAYS];
 
 	OFFY = 0;
 	OFFX = (wins_sbar_width() - 2 - WCALWIDTH) / 2;
@@ -476,6 +649,14 @@ draw_weekly_view(struct scrollwin *sw, struct date *current_day,
 	t = get_first_weekday(0);
 	draw_week_number(sw, t);
 
+	/* Compute the slices indicating appointment times of the week. */
+	t = get_first_weekday(sunday_first);
+	date.dd = t.tm_mday;
+	date.mm = t.tm_mon + 1;
+	date.yyyy = t.tm_year + 1900;
+	memset(slices, 0, sizeof(slices));
+	day_chk_busy_slices(date, WEEKINDAYS, DAYSLICESNO, slices, valid);
+
 	/* Now draw calendar view. */
 	for (j = 0; j < WEEKINDAYS; j++) {
 		/* get next day */
@@ -484,9 +665,7 @@ draw_weekly_view(struct scrollwin *sw, struct date *current_day,
 		else
 			date_change(&t, 0, 1);
 
-		struct date date;
 		unsigned attr, item_this_day;
-		int i, slices[DAYSLICESNO];
 
 		/* print the day names, with regards to the first day of the week */
 		custom_apply_attr(sw->inner, ATTR_HIGHEST);
@@ -498,7 +677,7 @@ draw_weekly_view(struct scrollwin *sw, struct date *current_day,
 		date.dd = t.tm_mday;
 		date.mm = t.tm_mon + 1;
 		date.yyyy = t.tm_year + 1900;
-		item_this_day = day_check_if_item(date);
+		item_this_day = day_cache_lookup(date);
 
 		/* Print the day numbers with appropriate decoration. */
 		if (t.tm_mday == current_day->dd
@@ -525,40 +704,11 @@ draw_weekly_view(struct scrollwin *sw, struct date *current_day,
 		WINS_CALENDAR_UNLOCK;
 
 		/* Draw slices indicating appointment times. */
-		memset(slices, 0, DAYSLICESNO * sizeof *slices);
-		if (day_chk_busy_slices(date, DAYSLICESNO, slices)) {
-			for (i = 0; i < DAYSLICESNO; i++) {
-				if (j != WEEKINDAYS - 1
-				    && i != DAYSLICESNO - 1) {
-					WINS_CALENDAR_LOCK;
-					mvwhline(sw->inner, OFFY + 2 + i,
-						 OFFX + 3 + 4 * j, ACS_S9,
-						 2);
-					WINS_CALENDAR_UNLOCK;
-				}
-				if (slices[i]) {
-					int highlight;
-
-					highlight =
-					    (t.tm_mday ==
-					     slctd_day.dd) ? 1 : 0;
-					WINS_CALENDAR_LOCK;
-					if (highlight)
-						custom_apply_attr(sw->inner,
-								  attr);
-					wattron(sw->inner, A_REVERSE);
-					mvwaddstr(sw->inner, OFFY + 2 + i,
-						  OFFX + 1 + 4 * j, " ");
-					mvwaddstr(sw->inner, OFFY + 2 + i,
-						  OFFX + 2 + 4 * j, " ");
-					wattroff(sw->inner, A_REVERSE);
-					if (highlight)
-						custom_remove_attr(sw->inner,
-								   attr);
-					WINS_CALENDAR_UNLOCK;
-				}
-			}
-		}
+		if (valid[j])
+			draw_weekly_slices(sw, OFFY, OFFX, j,
+					   slices + j * DAYSLICESNO,
+					   DAYSLICESNO,
+					   t.tm_mday == slctd_day.dd ? attr : 0);
 	}
 
 	/* Draw marks to indicate midday on the sides of the calendar. */
@@ -58,6 +58,28 @@ void ui_day_set_selitem(struct day_item *day)
 	ui_day_set_selitem_by_aptev_ptr(day->item);
 }
 
+/*
+ * Refresh the monthly view for the days on which an item that was just added
+ * or removed occurs. Recurrent items may occur on any day of the month.
+ */
+static void ui_day_cache_update(int type, union aptev_ptr item)
+{
+	switch (type) {
+	case EVNT:
+		ui_calendar_day_cache_update(item.ev->day,
+						      item.ev->day + 1);
+		break;
+	case APPT:
+		ui_calendar_day_cache_update(item.apt->start,
+			item.apt->start + (item.apt->dur > 0 ?
+					   item.apt->dur : 1));
+		break;
+	default:
+		ui_calendar_day_cache_set_invalid();
+		break;
+	}
+}
+
 /*
  * Request the user to enter a new start time.
  * Input: start time and duration in seconds.
@@ -392,20 +414,21 @@ void ui_day_item_edit(void)
 			(_("Edit: "), choice_recur_evnt, 2)) {
 		case 1:
 			update_desc(&re->mesg);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 2:
 			update_rept(&re->rpt, re->day);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		default:
 			return;
 		}
+		recur_event_update(re);
 		break;
 	case EVNT:
 		e = p->item.ev;
 		update_desc(&e->mesg);
-		io_set_modified();
+		io_set_modified(IO_MODIFIED_APTS);
 		break;
 	case RECUR_APPT:
 		ra = p->item.rapt;
@@ -421,35 +444,37 @@ void ui_day_item_edit(void)
 		case 1:
 			need_check_notify = 1;
 			update_start_time(&ra->start, &ra->dur, ra->dur == 0);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 2:
 			update_duration(&ra->start, &ra->dur);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 3:
 			if (notify_bar())
 				need_check_notify =
 				    notify_same_recur_item(ra);
 			update_desc(&ra->mesg);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 4:
 			need_check_notify = 1;
 			update_rept(&ra->rpt, ra->start);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 5:
 			need_check_notify = 1;
 			update_start_time(&ra->start, &ra->dur, 1);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		default:
 			return;
 		}
+		recur_apoint_update(ra);
 		break;
 	case APPT:
 		a = p->item.apt;
+		long old_start = a->start;
 		const char *choice_appt[4] = {
 			_("Start time"),
 			_("End time"),
@@ -461,33 +486,34 @@ void ui_day_item_edit(void)
 		case 1:
 			need_check_notify = 1;
 			update_start_time(&a->start, &a->dur, a->dur == 0);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 2:
 			update_duration(&a->start, &a->dur);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 3:
 			if (notify_bar())
 				need_check_notify =
 				    notify_same_item(a->start);
 			update_desc(&a->mesg);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		case 4:
 			need_check_notify = 1;
 			update_start_time(&a->start, &a->dur, 1);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			break;
 		default:
 			return;
 		}
+		apoint_reindex(a, old_start);
 		break;
 	default:
 		break;
 	}
 
-	ui_calendar_monthly_view_cache_set_invalid();
+	ui_calendar_day_cache_set_invalid();
 
 	if (need_check_notify)
 		notify_check_next_app(1);
@@ -653,14 +679,13 @@ void ui_day_item_add(void)
 		} else {
 			item.ev = event_new(item_mesg, 0L, start, 1);
 		}
-		io_set_modified();
-		day_process_storage(ui_calendar_get_slctd_day(), 0);
+		io_set_modified(IO_MODIFIED_APTS);
+		day_insert_item(is_appointment ? APPT : EVNT, item);
 		ui_day_load_items();
 		ui_day_set_selitem_by_aptev_ptr(item);
+		ui_day_cache_update(is_appointment ? APPT : EVNT, item);
 	}
 
-	ui_calendar_monthly_view_cache_set_invalid();
-
 	wins_erase_status_bar();
 }
 
@@ -702,7 +727,7 @@ void ui_day_item_delete(unsigned reg)
 			break;
 		case 2:
 			day_item_erase_note(p);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
 			return;
 		default:	/* User escaped */
 			return;
@@ -716,7 +741,10 @@ void ui_day_item_delete(unsigned reg)
 			break;
 		case 2:
 			day_item_add_exc(p, date);
-			io_set_modified();
+			io_set_modified(IO_MODIFIED_APTS);
+			day_update_item(p->type, p->item);
+			ui_day_load_items();
+			ui_calendar_day_cache_set_invalid();
 			return;
 		default:
 			return;
@@ -727,9 +755,11 @@ void ui_day_item_delete(unsigned reg)
 	p = day_cut_item(date, listbox_get_sel(&lb_apt));
 	day_cut[reg].type = p->type;
 	day_cut[reg].item = p->item;
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_APTS);
 
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_remove_item(day_cut[reg].item);
+	ui_day_load_items();
+	ui_day_cache_update(day_cut[reg].type, day_cut[reg].item);
 }
 
 /*
@@ -768,6 +798,7 @@ void ui_day_item_repeat(void)
 	int item_nb;
 	struct day_item *p;
 	struct recur_apoint *ra;
+	union aptev_ptr item;
 	time_t until, date;
 	unsigned days;
 
@@ -862,8 +893,8 @@ void ui_day_item_repeat(void)
 	date = ui_calendar_get_slctd_day_sec();
 	if (p->type == EVNT) {
 		struct event *ev = p->item.ev;
-		recur_event_new(ev->mesg, ev->note, ev->day, ev->id, type,
-				freq, until, NULL);
+		item.rev = recur_event_new(ev->mesg, ev->note, ev->day,
+					   ev->id, type, freq, until, NULL);
 	} else if (p->type == APPT) {
 		struct apoint *apt = p->item.apt;
 		ra = recur_apoint_new(apt->mesg, apt->note, apt->start,
@@ -871,6 +902,7 @@ void ui_day_item_repeat(void)
 				      until, NULL);
 		if (notify_bar())
 			notify_check_repeated(ra);
+		item.rapt = ra;
 	} else {
 		EXIT(_("wrong item type"));
 		/* NOTREACHED */
@@ -880,9 +912,14 @@ void ui_day_item_repeat(void)
 	p = day_cut_item(date, item_nb);
 	day_cut[REG_BLACK_HOLE].type = p->type;
 	day_cut[REG_BLACK_HOLE].item = p->item;
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_APTS);
 
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_remove_item(day_cut[REG_BLACK_HOLE].item);
+	day_insert_item(day_cut[REG_BLACK_HOLE].type == EVNT ?
+			RECUR_EVNT : RECUR_APPT, item);
+	ui_day_load_items();
+	ui_day_set_selitem_by_aptev_ptr(item);
+	ui_calendar_day_cache_set_invalid();
 
 cleanup:
 	mem_free(msg_asktype);
@@ -914,6 +951,24 @@ void ui_day_item_cut_free(unsigned reg)
 	}
 }
 
+/*
+ * Replace the cut items by copies of their own, so that they remain valid
+ * when the data files are reloaded.
+ */
+void ui_day_item_cut_migrate(void)
+{
+	struct day_item day;
+	unsigned reg;
+
+	for (reg = 0; reg <= REG_BLACK_HOLE; reg++) {
+		if (!day_cut[reg].type)
+			continue;
+		day_item_fork(&day_cut[reg], &day);
+		ui_day_item_cut_free(reg);
+		day_cut[reg] = day;
+	}
+}
+
 /* Copy an item, so that it can be pasted somewhere else later. */
 void ui_day_item_copy(unsigned reg)
 {
@@ -935,9 +990,12 @@ void ui_day_item_paste(unsigned reg)
 
 	day_item_fork(&day_cut[reg], &day);
 	day_paste_item(&day, ui_calendar_get_slctd_day_sec());
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_APTS);
 
-	ui_calendar_monthly_view_cache_set_invalid();
+	day_insert_item(day.type, day.item);
+	ui_day_load_items();
+	ui_day_set_selitem_by_aptev_ptr(day.item);
+	ui_day_cache_update(day.type, day.item);
 }
 
 void ui_day_load_items(void)
@@ -1037,8 +1095,15 @@ void ui_day_flag(void)
 		return;
 
 	struct day_item *item = ui_day_selitem();
+	union aptev_ptr p = item->item;
+
 	day_item_switch_notify(item);
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_APTS);
+
+	/* The notification flag takes part in the order of appointments. */
+	day_update_item(item->type, p);
+	ui_day_load_items();
+	ui_day_set_selitem_by_aptev_ptr(p);
 }
 
 void ui_day_view_note(void)
@@ -1057,5 +1122,5 @@ void ui_day_edit_note(void)
 
 	struct day_item *item = ui_day_selitem();
 	day_edit_note(item, conf.editor);
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_APTS);
 }
@@ -70,7 +70,7 @@ void ui_todo_add(void)
 		}
 		struct todo *todo = todo_add(todo_input, ch - '0', 0, NULL);
 		ui_todo_load_items();
-		io_set_modified();
+		io_set_modified(IO_MODIFIED_TODO);
 		ui_todo_set_selitem(todo);
 	}
 }
@@ -105,11 +105,11 @@ void ui_todo_delete(void)
 	case 1:
 		todo_delete(item);
 		ui_todo_load_items();
-		io_set_modified();
+		io_set_modified(IO_MODIFIED_TODO);
 		break;
 	case 2:
 		todo_delete_note(item);
-		io_set_modified();
+		io_set_modified(IO_MODIFIED_TODO);
 		break;
 	default:
 		wins_erase_status_bar();
@@ -130,7 +130,7 @@ void ui_todo_edit(void)
 	updatestring(win[STA].p, &item->mesg, 0, 1);
 	todo_resort(item);
 	ui_todo_load_items();
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_TODO);
 	ui_todo_set_selitem(item);
 }
 
@@ -298,7 +298,7 @@ void ui_todo_chg_priority(int diff)
 
 	item_new = todo_add(item->mesg, id, item->completed, item->note);
 	todo_delete(item);
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_TODO);
 	ui_todo_set_selitem(item_new);
 }
 
@@ -321,7 +321,7 @@ void ui_todo_flag(void)
 
 	todo_flag(item);
 	ui_todo_load_items();
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_TODO);
 	ui_todo_set_selitem(item);
 }
 
@@ -343,7 +343,7 @@ void ui_todo_edit_note(void)
 		return;
 
 	todo_edit_note(item, conf.editor);
-	io_set_modified();
+	io_set_modified(IO_MODIFIED_TODO);
 }
 
 /* Switch to next todo view. */
@@ -78,6 +78,8 @@ void exit_calcurse(int status)
 		notify_stop_main_thread();
 		ui_calendar_stop_date_thread();
 		io_stop_psave_thread();
+		io_stop_watch_thread();
+		ui_calendar_day_cache_free();
 
 		clear();
 		wins_refresh();
@@ -90,6 +92,7 @@ void exit_calcurse(int status)
 
 	free_user_data();
 	keys_free();
+	civil_free();
 	mem_stats();
 
 	if (was_interactive) {
@@ -116,6 +119,7 @@ void free_user_data(void)
 		ui_day_item_cut_free(i);
 	todo_free_list();
 	notify_free_app();
+	mem_arena_drop();
 }
 
 /* Function to exit on internal error. */
@@ -360,15 +364,17 @@ int is_all_digit(const char *string)
 /* Given an item date expressed in seconds, return its start time in seconds. */
 long get_item_time(long date)
 {
-	return (long)(get_item_hour(date) * HOURINSEC +
-		      get_item_min(date) * MININSEC);
+	struct tm lt;
+
+	civil_localtime(date, &lt);
+	return (long)(lt.tm_hour * HOURINSEC + lt.tm_min * MININSEC);
 }
 
 int get_item_hour(long date)
 {
 	struct tm lt;
 
-	localtime_r((time_t *) & date, &lt);
+	civil_localtime(date, &lt);
 	return lt.tm_hour;
 }
 
@@ -376,7 +382,7 @@ int get_item_min(long date)
 {
 	struct tm lt;
 
-	localtime_r((time_t *) & date, &lt);
+	civil_localtime(date, &lt);
 	return lt.tm_min;
 }
 
@@ -400,8 +406,17 @@ struct tm date2tm(struct date day, unsigned hour, unsigned min)
 
 time_t date2sec(struct date day, unsigned hour, unsigned min)
 {
-	struct tm start = date2tm(day, hour, min);
-	time_t t = mktime(&start);
+	struct tm start;
+	time_t t;
+
+	memset(&start, 0, sizeof start);
+	start.tm_mon = day.mm - 1;
+	start.tm_mday = day.dd;
+	start.tm_year = day.yyyy - 1900;
+	start.tm_hour = hour;
+	start.tm_min = min;
+	start.tm_isdst = -1;
+	t = civil_mktime(&start);
 
 	EXIT_IF(t == -1, _("failure in mktime"));
 
@@ -410,52 +425,43 @@ time_t date2sec(struct date day, unsigned hour, unsigned min)
 
 time_t utcdate2sec(struct date day, unsigned hour, unsigned min)
 {
-	char *tz;
-	time_t t;
-
-	tz = getenv("TZ");
-	if (tz)
-		tz = mem_strdup(tz);
-	setenv("TZ", "", 1);
-	tzset();
-
-	t = date2sec(day, hour, min);
-
-	if (tz) {
-		setenv("TZ", tz, 1);
-		mem_free(tz);
-	} else {
-	    unsetenv("TZ");
-	}
-	tzset();
-
-	return t;
+	return civil_days(day.yyyy, day.mm, day.dd) * DAYINSEC +
+	       hour * HOURINSEC + min * MININSEC;
 }
 
 /* Compare two dates (without comparing times). */
 int date_cmp_day(time_t d1, time_t d2)
 {
-	struct tm lt1, lt2;
-
-	localtime_r((time_t *)&d1, &lt1);
-	localtime_r((time_t *)&d2, &lt2);
+	long day1 = civil_day(d1), day2 = civil_day(d2);
 
-	if (lt1.tm_year < lt2.tm_year)
+	if (day1 < day2)
 		return -1;
-	if (lt1.tm_year > lt2.tm_year)
-		return 1;
-	if (lt1.tm_mon < lt2.tm_mon)
-		return -1;
-	if (lt1.tm_mon > lt2.tm_mon)
-		return 1;
-	if (lt1.tm_mday < lt2.tm_mday)
-		return -1;
-	if (lt1.tm_mday > lt2.tm_mday)
+	if (day1 > day2)
 		return 1;
 
 	return 0;
 }
 
+/*
+ * Compute the first second of the day containing the given date and the first
+ * second of the following day. Both are computed using the local calendar, so
+ * that days with a DST transition get their actual length.
+ */
+void date_day_bounds(long date, long *start, long *end)
+{
+	struct tm lt;
+
+	civil_localtime(date, &lt);
+	lt.tm_hour = lt.tm_min = lt.tm_sec = 0;
+	lt.tm_isdst = -1;
+	*start = civil_mktime(&lt);
+
+	lt.tm_mday++;
+	lt.tm_hour = lt.tm_min = lt.tm_sec = 0;
+	lt.tm_isdst = -1;
+	*end = civil_mktime(&lt);
+}
+
 /* Return a string containing the date, given a date in seconds. */
 char *date_sec2date_str(long sec, const char *datefmt)
 {
@@ -519,12 +525,11 @@ long date_sec_change(long date, int delta_month, int delta_day)
 	struct tm lt;
 	time_t t;
 
-	t = date;
-	localtime_r(&t, &lt);
+	civil_localtime(date, &lt);
 	lt.tm_mon += delta_month;
 	lt.tm_mday += delta_day;
 	lt.tm_isdst = -1;
-	t = mktime(&lt);
+	t = civil_mktime(&lt);
 	EXIT_IF(t == -1, _("failure in mktime"));
 
 	return t;
@@ -537,14 +542,13 @@ long date_sec_change(long date, int delta_month, int delta_day)
 long update_time_in_date(long date, unsigned hr, unsigned mn)
 {
 	struct tm lt;
-	time_t t, new_date;
+	time_t new_date;
 
-	t = date;
-	localtime_r(&t, &lt);
+	civil_localtime(date, &lt);
 	lt.tm_hour = hr;
 	lt.tm_min = mn;
 	lt.tm_sec = 0;
-	new_date = mktime(&lt);
+	new_date = civil_mktime(&lt);
 	EXIT_IF(new_date == -1, _("error in mktime"));
 
 	return new_date;
@@ -1445,44 +1449,44 @@ static void print_notefile(FILE * out, const char *filename, int nbtab)
 }
 
 /* Print an escape sequence and return its length. */
-static int print_escape(const char *s)
+static int print_escape(FILE *out, const char *s)
 {
 	switch (*(s + 1)) {
 	case 'a':
-		putchar('\a');
+		fputc('\a', out);
 		return 1;
 	case 'b':
-		putchar('\b');
+		fputc('\b', out);
 		return 1;
 	case 'f':
-		putchar('\f');
+		fputc('\f', out);
 		return 1;
 	case 'n':
-		putchar('\n');
+		fputc('\n', out);
 		return 1;
 	case 'r':
-		putchar('\r');
+		fputc('\r', out);
 		return 1;
 	case 't':
-		putchar('\t');
+		fputc('\t', out);
 		return 1;
 	case 'v':
-		putchar('\v');
+		fputc('\v', out);
 		return 1;
 	case '0':
-		putchar('\0');
+		fputc('\0', out);
 		return 1;
 	case '\'':
-		putchar('\'');
+		fputc('\'', out);
 		return 1;
 	case '"':
-		putchar('"');
+		fputc('"', out);
 		return 1;
 	case '\?':
-		putchar('?');
+		fputc('?', out);
 		return 1;
 	case '\\':
-		putchar('\\');
+		fputc('\\', out);
 		return 1;
 	case '\0':
 		return 0;
@@ -1579,13 +1583,14 @@ static enum format_specifier parse_fs(const char **s, char *extformat)
 	}
 }
 
-/* Print a formatted date to stdout. */
-static void print_date(long date, long day, const char *extformat)
+/* Print a formatted date to a stream. */
+static void print_date(FILE *out, long date, long day,
+		       const char *extformat)
 {
 	char buf[BUFSIZ];
 
 	if (!strcmp(extformat, "epoch")) {
-		printf("%ld", date);
+		fprintf(out, "%ld", date);
 	} else {
 		time_t day_end = date_sec_change(day, 0, 1);
 		time_t t = date;
@@ -1602,12 +1607,13 @@ static void print_date(long date, long day, const char *extformat)
 			strftime(buf, BUFSIZ, extformat, &lt);
 		}
 
-		printf("%s", buf);
+		fprintf(out, "%s", buf);
 	}
 }
 
-/* Print a time difference to stdout. */
-static void print_datediff(long difference, const char *extformat)
+/* Print a time difference to a stream. */
+static void print_datediff(FILE *out, long difference,
+			   const char *extformat)
 {
 	const char *p;
 	const char *numfmt;
@@ -1615,7 +1621,7 @@ static void print_datediff(long difference, const char *extformat)
 	long value;
 
 	if (!strcmp(extformat, "epoch")) {
-		printf("%ld", difference);
+		fprintf(out, "%ld", difference);
 	} else {
 		if (extformat[0] == '\0' || !strcmp(extformat, "default")) {
 			/* Set a default format if none specified. */
@@ -1644,43 +1650,43 @@ static void print_datediff(long difference, const char *extformat)
 					return;
 				case 'd':
 					value = difference / DAYINSEC;
-					printf(numfmt, value);
+					fprintf(out, numfmt, value);
 					break;
 				case 'H':
 					value = difference / HOURINSEC;
 					if (!usetotal)
 						value %= DAYINHOURS;
-					printf(numfmt, value);
+					fprintf(out, numfmt, value);
 					break;
 				case 'M':
 					value = difference / MININSEC;
 					if (!usetotal)
 						value %= HOURINMIN;
-					printf(numfmt, value);
+					fprintf(out, numfmt, value);
 					break;
 				case 'S':
 					value = difference;
 					if (!usetotal)
 						value %= MININSEC;
-					printf(numfmt, value);
+					fprintf(out, numfmt, value);
 					break;
 				case '%':
-					putchar('%');
+					fputc('%', out);
 					break;
 				default:
-					putchar('?');
+					fputc('?', out);
 					break;
 				}
 			} else {
-				putchar(*p);
+				fputc(*p, out);
 			}
 			p++;
 		}
 	}
 }
 
-/* Print a formatted appointment to stdout. */
-static void print_apoint_helper(const char *format, long day,
+/* Print a formatted appointment to a stream. */
+static void print_apoint_helper(FILE *out, const char *format, long day,
 				struct apoint *apt, struct recur_apoint *rapt)
 {
 	const char *p;
@@ -1691,65 +1697,65 @@ static void print_apoint_helper(const char *format, long day,
 			p++;
 			switch (parse_fs(&p, extformat)) {
 			case FS_STARTDATE:
-				print_date(apt->start, day, extformat);
+				print_date(out, apt->start, day, extformat);
 				break;
 			case FS_DURATION:
 				/* Backwards compatibility: Use epoch by
 				 * default. */
 				if (*extformat == '\0')
 					strcpy(extformat, "epoch");
-				print_datediff(apt->dur, extformat);
+				print_datediff(out, apt->dur, extformat);
 				break;
 			case FS_ENDDATE:
-				print_date(apt->start + apt->dur, day,
+				print_date(out, apt->start + apt->dur, day,
 					   extformat);
 				break;
 			case FS_REMAINING:
-				print_datediff(difftime(apt->start, now()),
-				               extformat);
+				print_datediff(out, difftime(apt->start, now()),
+					       extformat);
 				break;
 			case FS_MESSAGE:
-				printf("%s", apt->mesg);
+				fprintf(out, "%s", apt->mesg);
 				break;
 			case FS_NOTE:
-				printf("%s", apt->note);
+				fprintf(out, "%s", apt->note);
 				break;
 			case FS_NOTEFILE:
-				print_notefile(stdout, apt->note, 1);
+				print_notefile(out, apt->note, 1);
 				break;
 			case FS_RAW:
 				if (rapt)
-					recur_apoint_write(rapt, stdout);
+					recur_apoint_write(rapt, out);
 				else
-					apoint_write(apt, stdout);
+					apoint_write(apt, out);
 				break;
 			case FS_HASH:
 				if (rapt)
-					printf("%s", recur_apoint_hash(rapt));
+					fprintf(out, "%s", recur_apoint_hash(rapt));
 				else
-					printf("%s", apoint_hash(apt));
+					fprintf(out, "%s", apoint_hash(apt));
 				break;
 			case FS_PSIGN:
-				putchar('%');
+				fputc('%', out);
 				break;
 			case FS_EOF:
 				return;
 				break;
 			default:
-				putchar('?');
+				fputc('?', out);
 				break;
 			}
 		} else if (*p == '\\') {
-			p += print_escape(p);
+			p += print_escape(out, p);
 		} else {
-			putchar(*p);
+			fputc(*p, out);
 		}
 	}
 }
 
-/* Print a formatted event to stdout. */
-static void print_event_helper(const char *format, long day, struct event *ev,
-			       struct recur_event *rev)
+/* Print a formatted event to a stream. */
+static void print_event_helper(FILE *out, const char *format, long day,
+			       struct event *ev, struct recur_event *rev)
 {
 	const char *p;
 	char extformat[FS_EXT_MAXLEN];
@@ -1759,60 +1765,60 @@ static void print_event_helper(const char *format, long day, struct event *ev,
 			p++;
 			switch (parse_fs(&p, extformat)) {
 			case FS_MESSAGE:
-				printf("%s", ev->mesg);
+				fprintf(out, "%s", ev->mesg);
 				break;
 			case FS_NOTE:
-				printf("%s", ev->note);
+				fprintf(out, "%s", ev->note);
 				break;
 			case FS_NOTEFILE:
-				print_notefile(stdout, ev->note, 1);
+				print_notefile(out, ev->note, 1);
 				break;
 			case FS_PSIGN:
-				putchar('%');
+				fputc('%', out);
 				break;
 			case FS_RAW:
 				if (rev)
-					recur_event_write(rev, stdout);
+					recur_event_write(rev, out);
 				else
-					event_write(ev, stdout);
+					event_write(ev, out);
 				break;
 			case FS_HASH:
 				if (rev)
-					printf("%s", recur_event_hash(rev));
+					fprintf(out, "%s", recur_event_hash(rev));
 				else
-					printf("%s", event_hash(ev));
+					fprintf(out, "%s", event_hash(ev));
 				break;
 			case FS_EOF:
 				return;
 				break;
 			default:
-				putchar('?');
+				fputc('?', out);
 				break;
 			}
 		} else if (*p == '\\') {
-			p += print_escape(p);
+			p += print_escape(out, p);
 		} else {
-			putchar(*p);
+			fputc(*p, out);
 		}
 	}
 }
 
-/* Print a formatted appointment to stdout. */
-void print_apoint(const char *format, long day, struct apoint *apt)
+/* Print a formatted appointment to a stream. */
+void print_apoint(FILE *out, const char *format, long day, struct apoint *apt)
 {
-	print_apoint_helper(format, day, apt, NULL);
+	print_apoint_helper(out, format, day, apt, NULL);
 }
 
-/* Print a formatted event to stdout. */
-void print_event(const char *format, long day, struct event *ev)
+/* Print a formatted event to a stream. */
+void print_event(FILE *out, const char *format, long day, struct event *ev)
 {
-	print_event_helper(format, day, ev, NULL);
+	print_event_helper(out, format, day, ev, NULL);
 }
 
-/* Print a formatted recurrent appointment to stdout. */
+/* Print a formatted recurrent appointment to a stream. */
 void
-print_recur_apoint(const char *format, long day, time_t occurrence,
-		   struct recur_apoint *rapt)
+print_recur_apoint(FILE *out, const char *format, long day,
+		   time_t occurrence, struct recur_apoint *rapt)
 {
 	struct apoint apt;
 
@@ -1821,11 +1827,11 @@ print_recur_apoint(const char *format, long day, time_t occurrence,
 	apt.mesg = rapt->mesg;
 	apt.note = rapt->note;
 
-	print_apoint_helper(format, day, &apt, rapt);
+	print_apoint_helper(out, format, day, &apt, rapt);
 }
 
-/* Print a formatted recurrent event to stdout. */
-void print_recur_event(const char *format, long day,
+/* Print a formatted recurrent event to a stream. */
+void print_recur_event(FILE *out, const char *format, long day,
 		       struct recur_event *rev)
 {
 	struct event ev;
@@ -1833,11 +1839,11 @@ void print_recur_event(const char *format, long day,
 	ev.mesg = rev->mesg;
 	ev.note = rev->note;
 
-	print_event_helper(format, day, &ev, rev);
+	print_event_helper(out, format, day, &ev, rev);
 }
 
-/* Print a formatted todo item to stdout. */
-void print_todo(const char *format, struct todo *todo)
+/* Print a formatted todo item to a stream. */
+void print_todo(FILE *out, const char *format, struct todo *todo)
 {
 	const char *p;
 	char extformat[FS_EXT_MAXLEN];
@@ -1847,37 +1853,37 @@ void print_todo(const char *format, struct todo *todo)
 			p++;
 			switch (parse_fs(&p, extformat)) {
 			case FS_PRIORITY:
-				printf("%d", abs(todo->id));
+				fprintf(out, "%d", abs(todo->id));
 				break;
 			case FS_MESSAGE:
-				printf("%s", todo->mesg);
+				fprintf(out, "%s", todo->mesg);
 				break;
 			case FS_NOTE:
-				printf("%s", todo->note);
+				fprintf(out, "%s", todo->note);
 				break;
 			case FS_NOTEFILE:
-				print_notefile(stdout, todo->note, 1);
+				print_notefile(out, todo->note, 1);
 				break;
 			case FS_RAW:
-				todo_write(todo, stdout);
+				todo_write(todo, out);
 				break;
 			case FS_HASH:
-				printf("%s", todo_hash(todo));
+				fprintf(out, "%s", todo_hash(todo));
 				break;
 			case FS_PSIGN:
-				putchar('%');
+				fputc('%', out);
 				break;
 			case FS_EOF:
 				return;
 				break;
 			default:
-				putchar('?');
+				fputc('?', out);
 				break;
 			}
 		} else if (*p == '\\') {
-			p += print_escape(p);
+			p += print_escape(out, p);
 		} else {
-			putchar(*p);
+			fputc(*p, out);
 		}
 	}
 }
@@ -109,7 +109,7 @@ struct dmon_conf dmon;
  * one of the threads is not running, the corresponding variable is assigned
  * the identifier of the main thread instead.
  */
-pthread_t notify_t_main, io_t_psave, ui_calendar_t_date;
+pthread_t notify_t_main, io_t_psave, io_t_watch, ui_calendar_t_date;
 
 /*
  * Variables init
@@ -123,7 +123,9 @@ void vars_init(void)
 	conf.confirm_delete = 1;
 	conf.auto_save = 1;
 	conf.auto_gc = 0;
+	conf.auto_reload = 0;
 	conf.periodic_save = 0;
+	conf.trust_file_stat = 0;
 	conf.default_panel = CAL;
 	conf.compact_panels = 0;
 	conf.system_dialogs = 1;
@@ -177,5 +179,6 @@ void vars_init(void)
 	ui_calendar_init_slctd_day();
 
 	/* Threads not yet running. */
-	notify_t_main = io_t_psave = ui_calendar_t_date = pthread_self();
+	notify_t_main = io_t_psave = io_t_watch = ui_calendar_t_date =
+	    pthread_self();
 }
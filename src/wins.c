@@ -595,6 +595,8 @@ void wins_prepare_external(void)
 		notify_stop_main_thread();
 	if (conf.periodic_save > 0)
 		io_stop_psave_thread();
+	if (conf.auto_reload)
+		io_stop_watch_thread();
 	def_prog_mode();
 	ui_mode = UI_CMDLINE;
 	clear();
@@ -618,6 +620,8 @@ void wins_unprepare_external(void)
 		notify_start_main_thread();
 	if (conf.periodic_save > 0)
 		io_start_psave_thread();
+	if (conf.auto_reload)
+		io_start_watch_thread();
 }
 
 /*
@@ -0,0 +1,26 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  mkdir -p .calcurse-gc/notes || exit 1
+  cp "$DATA_DIR/apts-gc-001" .calcurse-gc/apts || exit 1
+  cp "$DATA_DIR/todo" .calcurse-gc || exit 1
+  touch .calcurse-gc/notes/aaaa .calcurse-gc/notes/bbbb \
+    .calcurse-gc/notes/cccc .calcurse-gc/notes/dddd .calcurse-gc/notes/.keep
+  mkdir .calcurse-gc/notes/eeee || exit 1
+  "$CALCURSE" -D "$PWD/.calcurse-gc" --gc | \
+    sed 's/in [0-9.]* seconds/in N seconds/'
+  ls .calcurse-gc/notes
+  rm -rf .calcurse-gc || exit 1
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+Garbage collection report: 5 note files checked in N seconds
+2 in use / 2 removed / 1 not removed
+aaaa
+bbbb
+eeee
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,48 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+dir="$PWD/.calcurse-import"
+
+# Import while running the given command once the data files are loaded.
+import_while() {
+  rm -f "$dir/apts.snap"
+  {
+    n=0
+    while [ ! -f "$dir/apts.snap" ] && [ "$n" -lt 10 ]; do
+      sleep 1
+      n=$((n + 1))
+    done
+    "$@"
+    cat "$DATA_DIR/ical-001.ical"
+  } | "$CALCURSE" -D "$dir" -i - >/dev/null 2>&1 &&
+    echo 'imported' || echo 'aborted'
+}
+
+# Rewrite the appointment file in place, keeping its size and timestamps.
+rewrite_same_stat() {
+  cp -p "$dir/apts" "$dir/apts.orig"
+  sed 's/Kept/Lost/' "$dir/apts.orig" >"$dir/apts"
+  touch -r "$dir/apts.orig" "$dir/apts"
+  rm -f "$dir/apts.orig"
+}
+
+if [ "$1" = 'actual' ]; then
+  mkdir "$dir" || exit 1
+  cp "$DATA_DIR/todo" "$dir" || exit 1
+  cp "$DATA_DIR/apts-journal" "$dir/apts" || exit 1
+  import_while touch "$dir/apts"
+  import_while sh -c "echo '01/01/2020 [1] New event' >>'$dir/apts'"
+  import_while rewrite_same_stat
+  grep -c 'Lost' "$dir/apts"
+  rm -rf "$dir" || exit 1
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+imported
+aborted
+imported
+0
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,21 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-journal" \
+    -s01/01/2020 -r5
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+01/01/20:
+ * Kept event
+
+01/03/20:
+ * Edited event, after the edit
+
+01/05/20:
+ * Added event
+EOD
+else
+  ./run-test "$0"
+fi
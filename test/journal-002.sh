@@ -0,0 +1,31 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  mkdir .calcurse-journal || exit 1
+  cp "$DATA_DIR/apts-journal" .calcurse-journal/apts || exit 1
+  cp "$DATA_DIR/apts-journal.journal" .calcurse-journal/apts.journal || exit 1
+  cp "$DATA_DIR/todo" .calcurse-journal || exit 1
+  echo '01/05/2020 [1] Added event' >>.calcurse-journal/apts
+  echo '01/06/2020 [1] Event added by another program' \
+    >>.calcurse-journal/apts
+  "$CALCURSE" -D "$PWD/.calcurse-journal" -s01/01/2020 -r6
+  rm -rf .calcurse-journal || exit 1
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+01/01/20:
+ * Kept event
+
+01/03/20:
+ * Edited event, after the edit
+
+01/05/20:
+ * Added event
+
+01/06/20:
+ * Event added by another program
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -s01/01/2010 -r730 --jobs 4
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-recur" \
+    -s01/01/2000 -r366 --jobs 4
+elif [ "$1" = 'expected' ]; then
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -s01/01/2010 -r730
+  "$CALCURSE" --read-only -D "$DATA_DIR"/ -c "$DATA_DIR/apts-recur" \
+    -s01/01/2000 -r366
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,28 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  TZ="Europe/Paris" "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR/apts-recur" -s03/30/2000 -r2 --format-recur-event=''
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+03/30/00:
+ - ..:.. -> ..:..
+	Another recurrent appointment
+ - ..:.. -> 02:00
+	Recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+
+03/31/00:
+ - ..:.. -> 01:00
+	Another recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+ - 16:00 -> ..:..
+	Recurrent appointment
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,20 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  TZ="Europe/Dublin" "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR/apts-dst" -s03/25/2000 -r2
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+03/25/00:
+ - 01:07 -> 01:30
+	Daily at 01:07
+
+03/26/00:
+ - 00:07 -> 00:30
+	Daily at 01:07
+EOD
+else
+  ./run-test "$0"
+fi
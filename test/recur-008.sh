@@ -0,0 +1,24 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  TZ="Pacific/Apia" "$CALCURSE" --read-only -D "$DATA_DIR"/ \
+    -c "$DATA_DIR/apts-dst" -s12/29/2011 -r3
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+12/29/11:
+ - 01:07 -> 01:30
+	Daily at 01:07
+ - 10:00 -> 11:00
+	Daily at 10:00
+
+12/31/11:
+ - 01:07 -> 01:30
+	Daily at 01:07
+ - 10:00 -> 11:00
+	Daily at 10:00
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,61 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+if [ "$1" = 'actual' ]; then
+  mkdir .calcurse-snap || exit 1
+  cp "$DATA_DIR/apts-recur" .calcurse-snap/apts || exit 1
+  cp "$DATA_DIR/todo" .calcurse-snap || exit 1
+  "$CALCURSE" -D "$PWD/.calcurse-snap" -s02/26/2000 -r1
+  snap="$(ls -i .calcurse-snap/apts.snap)"
+  "$CALCURSE" -D "$PWD/.calcurse-snap" -s02/26/2000 -r1
+  [ "$(ls -i .calcurse-snap/apts.snap)" = "$snap" ] && echo 'snapshot reused'
+  echo '02/26/2000 [1] Added after the snapshot' >>.calcurse-snap/apts
+  "$CALCURSE" -D "$PWD/.calcurse-snap" -s02/26/2000 -r1
+  [ "$(ls -i .calcurse-snap/apts.snap)" = "$snap" ] || echo 'snapshot updated'
+  rm -rf .calcurse-snap || exit 1
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+02/26/00:
+ * Each Saturday since 2000-01-01
+ * Each day since 2000-01-01
+ * Every 28 days since 2000-01-01
+ * Every second day since 2000-01-01
+ * Same as "01/01/2000 [1] {1W}"
+ - 00:00 -> ..:..
+	Another recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+ - 16:00 -> ..:..
+	Recurrent appointment
+02/26/00:
+ * Each Saturday since 2000-01-01
+ * Each day since 2000-01-01
+ * Every 28 days since 2000-01-01
+ * Every second day since 2000-01-01
+ * Same as "01/01/2000 [1] {1W}"
+ - 00:00 -> ..:..
+	Another recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+ - 16:00 -> ..:..
+	Recurrent appointment
+snapshot reused
+02/26/00:
+ * Added after the snapshot
+ * Each Saturday since 2000-01-01
+ * Each day since 2000-01-01
+ * Every 28 days since 2000-01-01
+ * Every second day since 2000-01-01
+ * Same as "01/01/2000 [1] {1W}"
+ - 00:00 -> ..:..
+	Another recurrent appointment
+ - 00:00 -> ..:..
+	Third recurrent appointment
+ - 16:00 -> ..:..
+	Recurrent appointment
+snapshot updated
+EOD
+else
+  ./run-test "$0"
+fi
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+. "${TEST_INIT:-./test-init.sh}"
+
+zoneinfo="${TZDIR:-/usr/share/zoneinfo}"
+
+# Change the rules of the local time zone, as a tzdata update would.
+set_zone() {
+  cp "$zoneinfo/$1" .calcurse-snap/zoneinfo/Local || exit 1
+}
+
+query() {
+  TZDIR="$PWD/.calcurse-snap/zoneinfo" TZ=Local \
+    "$CALCURSE" -D "$PWD/.calcurse-snap" -Q --filter-type cal \
+    --from 01/15/1995 --days 1 --format-apt '%(start:epoch)\n'
+}
+
+if [ "$1" = 'actual' ]; then
+  mkdir -p .calcurse-snap/zoneinfo || exit 1
+  cp "$DATA_DIR/apts-snapshot-002" .calcurse-snap/apts || exit 1
+  cp "$DATA_DIR/todo" .calcurse-snap || exit 1
+  set_zone Europe/London
+  query
+  [ -f .calcurse-snap/apts.snap ] && echo 'snapshot written'
+  # Both zones agree in January and July of each decade, but not in 1995.
+  set_zone Europe/Lisbon
+  query
+  rm -rf .calcurse-snap || exit 1
+elif [ "$1" = 'expected' ]; then
+  cat <<EOD
+01/15/95:
+790171200
+snapshot written
+01/15/95:
+790167600
+EOD
+else
+  ./run-test "$0"
+fi